@@ -0,0 +1,150 @@
+//
+//  SGBoundingBoxBenchmark.c
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+// Times the bounding box reductions in SGBoundingBox against a loop that
+// grows a map rect one point at a time, and checks that both find the same
+// rect.
+
+#include <stdio.h>
+
+#include "SGBoundingBox.h"
+#include "SGBenchmark.h"
+
+#define kSGBoundingBoxBenchmark_Count       1000000
+#define kSGBoundingBoxBenchmark_Repeats     50
+
+static MKMapRect SGMapRectForMapPointsOneByOne(const MKMapPoint* points, NSUInteger count);
+static MKMapRect SGMapRectForCoordinatesOneByOne(const CLLocationCoordinate2D* coordinates, NSUInteger count);
+static BOOL SGMapRectEqualToRect(MKMapRect mapRect, MKMapRect otherMapRect);
+
+int main(void)
+{
+    NSUInteger count = kSGBoundingBoxBenchmark_Count;
+    CLLocationCoordinate2D* coordinates = malloc(count * sizeof(CLLocationCoordinate2D));
+    MKMapPoint* points = malloc(count * sizeof(MKMapPoint));
+    if(!coordinates || !points) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    
+    // A track wandering around a city.
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    CLLocationCoordinate2D coordinate = CLLocationCoordinate2DMake(37.7749, -122.4194);
+    for(NSUInteger i = 0; i < count; i++) {
+        coordinate.latitude += SGBenchmarkUniform(&state, -1e-4, 1e-4);
+        coordinate.longitude += SGBenchmarkUniform(&state, -1e-4, 1e-4);
+        coordinates[i] = coordinate;
+        points[i] = MKMapPointForCoordinate(coordinate);
+    }
+    
+    printf("%lu points, %d calls per run, %s build\n", (unsigned long)count,
+           kSGBoundingBoxBenchmark_Repeats, kSGBenchmark_Vector);
+    
+    double oneByOneTime = INFINITY;
+    double reduceTime = INFINITY;
+    MKMapRect expectedMapRect = MKMapRectNull;
+    MKMapRect mapRect = MKMapRectNull;
+    for(int run = 0; run < kSGBenchmark_Runs; run++) {
+        double start = SGBenchmarkNow();
+        for(int i = 0; i < kSGBoundingBoxBenchmark_Repeats; i++)
+            expectedMapRect = SGMapRectForMapPointsOneByOne(points, count);
+        
+        oneByOneTime = MIN(oneByOneTime, (SGBenchmarkNow() - start) / kSGBoundingBoxBenchmark_Repeats);
+        
+        start = SGBenchmarkNow();
+        for(int i = 0; i < kSGBoundingBoxBenchmark_Repeats; i++)
+            mapRect = SGMapRectForMapPoints(points, count);
+        
+        reduceTime = MIN(reduceTime, (SGBenchmarkNow() - start) / kSGBoundingBoxBenchmark_Repeats);
+    }
+    
+    BOOL mapPointsMatch = SGMapRectEqualToRect(mapRect, expectedMapRect);
+    printf("map points     one by one %6.3f ms  reduced %6.3f ms  %5.2fx  %s\n",
+           oneByOneTime * 1e3, reduceTime * 1e3, oneByOneTime / reduceTime, mapPointsMatch ? "ok" : "MISMATCH");
+    
+    oneByOneTime = INFINITY;
+    reduceTime = INFINITY;
+    for(int run = 0; run < kSGBenchmark_Runs; run++) {
+        double start = SGBenchmarkNow();
+        for(int i = 0; i < kSGBoundingBoxBenchmark_Repeats; i++)
+            expectedMapRect = SGMapRectForCoordinatesOneByOne(coordinates, count);
+        
+        oneByOneTime = MIN(oneByOneTime, (SGBenchmarkNow() - start) / kSGBoundingBoxBenchmark_Repeats);
+        
+        start = SGBenchmarkNow();
+        for(int i = 0; i < kSGBoundingBoxBenchmark_Repeats; i++)
+            mapRect = SGMapRectForCoordinates(coordinates, count);
+        
+        reduceTime = MIN(reduceTime, (SGBenchmarkNow() - start) / kSGBoundingBoxBenchmark_Repeats);
+    }
+    
+    BOOL coordinatesMatch = SGMapRectEqualToRect(mapRect, expectedMapRect);
+    printf("coordinates    one by one %6.3f ms  reduced %6.3f ms  %5.2fx  %s\n",
+           oneByOneTime * 1e3, reduceTime * 1e3, oneByOneTime / reduceTime, coordinatesMatch ? "ok" : "MISMATCH");
+    
+    free(coordinates);
+    free(points);
+    return mapPointsMatch && coordinatesMatch ? 0 : 1;
+}
+
+static MKMapRect SGMapRectForMapPointsOneByOne(const MKMapPoint* points, NSUInteger count)
+{
+    MKMapRect mapRect = MKMapRectNull;
+    for(NSUInteger i = 0; i < count; i++)
+        mapRect = MKMapRectUnion(mapRect, MKMapRectMake(points[i].x, points[i].y, 0.0, 0.0));
+    
+    return mapRect;
+}
+
+static MKMapRect SGMapRectForCoordinatesOneByOne(const CLLocationCoordinate2D* coordinates, NSUInteger count)
+{
+    // Every coordinate is projected, the way the map view used to do it.
+    MKMapRect mapRect = MKMapRectNull;
+    for(NSUInteger i = 0; i < count; i++) {
+        MKMapPoint point = MKMapPointForCoordinate(coordinates[i]);
+        mapRect = MKMapRectUnion(mapRect, MKMapRectMake(point.x, point.y, 0.0, 0.0));
+    }
+    
+    return mapRect;
+}
+
+static BOOL SGMapRectEqualToRect(MKMapRect mapRect, MKMapRect otherMapRect)
+{
+    // Widths come from subtracting different sums, so they can differ in
+    // the last bit.
+    return mapRect.origin.x == otherMapRect.origin.x && mapRect.origin.y == otherMapRect.origin.y &&
+        fabs(mapRect.size.width - otherMapRect.size.width) <= 1e-6 &&
+        fabs(mapRect.size.height - otherMapRect.size.height) <= 1e-6;
+}
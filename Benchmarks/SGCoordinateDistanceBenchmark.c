@@ -0,0 +1,226 @@
+//
+//  SGCoordinateDistanceBenchmark.c
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+// Times the batch distance functions in CLLocation+Batch against the
+// haversine formula computed with libm one coordinate at a time, and
+// measures how far their results are from it.
+
+#include <stdio.h>
+
+#include "CLLocation+Batch.h"
+#include "SGBenchmark.h"
+
+#define kSGCoordinateDistanceBenchmark_Count        10000000
+#define kSGCoordinateDistanceBenchmark_NearCount    1000000
+#define kSGCoordinateDistanceBenchmark_Radius       50000.0
+
+typedef struct {
+    
+    double distance;
+    double relativeDistance;
+    double bearing;
+    
+} SGDistanceError;
+
+static void SGGetDistancesWithLibm(CLLocationCoordinate2D origin, const double* latitudes, const double* longitudes,
+                                   NSUInteger count, CLLocationDistance* distances, double* bearings);
+static NSUInteger SGFilterRadiusWithLibm(CLLocationCoordinate2D origin, CLLocationDistance radius, const double* latitudes,
+                                         const double* longitudes, NSUInteger count, uint32_t* selection);
+static SGDistanceError SGMaxDistanceError(const double* distances, const double* bearings,
+                                          const double* expectedDistances, const double* expectedBearings, NSUInteger count);
+
+int main(void)
+{
+    NSUInteger count = kSGCoordinateDistanceBenchmark_Count;
+    NSUInteger nearCount = kSGCoordinateDistanceBenchmark_NearCount;
+    double* latitudes = malloc(count * sizeof(double));
+    double* longitudes = malloc(count * sizeof(double));
+    double* distances = malloc(count * sizeof(double));
+    double* bearings = malloc(count * sizeof(double));
+    double* expectedDistances = malloc(count * sizeof(double));
+    double* expectedBearings = malloc(count * sizeof(double));
+    uint32_t* selection = malloc(count * sizeof(uint32_t));
+    uint32_t* expectedSelection = malloc(count * sizeof(uint32_t));
+    if(!latitudes || !longitudes || !distances || !bearings ||
+       !expectedDistances || !expectedBearings || !selection || !expectedSelection) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    
+    // Coordinates spread uniformly over the sphere.
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    for(NSUInteger i = 0; i < count; i++) {
+        latitudes[i] = asin(SGBenchmarkUniform(&state, -1.0, 1.0)) * 180.0 / M_PI;
+        longitudes[i] = SGBenchmarkUniform(&state, -180.0, 180.0);
+    }
+    
+    CLLocationCoordinate2D origin = CLLocationCoordinate2DMake(37.7749, -122.4194);
+    printf("%lu coordinates, %s build\n", (unsigned long)count, kSGBenchmark_Vector);
+    
+    double libmTime = INFINITY;
+    double batchTime = INFINITY;
+    double approximateTime = INFINITY;
+    for(int run = 0; run < kSGBenchmark_Runs; run++) {
+        double start = SGBenchmarkNow();
+        SGGetDistancesWithLibm(origin, latitudes, longitudes, count, expectedDistances, expectedBearings);
+        libmTime = MIN(libmTime, SGBenchmarkNow() - start);
+        
+        start = SGBenchmarkNow();
+        SGCoordinateGetDistances(origin, latitudes, longitudes, count, distances, bearings);
+        batchTime = MIN(batchTime, SGBenchmarkNow() - start);
+        
+        start = SGBenchmarkNow();
+        SGCoordinateGetApproximateDistances(origin, latitudes, longitudes, count, distances, bearings);
+        approximateTime = MIN(approximateTime, SGBenchmarkNow() - start);
+    }
+    
+    SGCoordinateGetDistances(origin, latitudes, longitudes, count, distances, bearings);
+    SGDistanceError error = SGMaxDistanceError(distances, bearings, expectedDistances, expectedBearings, count);
+    printf("distances and bearings   libm %7.2f ms  batch %7.2f ms  %5.2fx  approximate %7.2f ms\n",
+           libmTime * 1e3, batchTime * 1e3, libmTime / batchTime, approximateTime * 1e3);
+    printf("batch error              distance %.3g m  relative %.3g  bearing %.3g rad\n",
+           error.distance, error.relativeDistance, error.bearing);
+    
+    double libmFilterTime = INFINITY;
+    double filterTime = INFINITY;
+    NSUInteger expectedCount = 0;
+    NSUInteger selectionCount = 0;
+    for(int run = 0; run < kSGBenchmark_Runs; run++) {
+        double start = SGBenchmarkNow();
+        expectedCount = SGFilterRadiusWithLibm(origin, 2000000.0, latitudes, longitudes, count, expectedSelection);
+        libmFilterTime = MIN(libmFilterTime, SGBenchmarkNow() - start);
+        
+        start = SGBenchmarkNow();
+        selectionCount = SGCoordinateFilterRadius(origin, 2000000.0, latitudes, longitudes, count, selection);
+        filterTime = MIN(filterTime, SGBenchmarkNow() - start);
+    }
+    
+    // Coordinates right on the radius can land on either side of it.
+    BOOL matches = selectionCount == expectedCount &&
+        !memcmp(selection, expectedSelection, selectionCount * sizeof(uint32_t));
+    printf("2000 km radius filter    libm %7.2f ms  batch %7.2f ms  %5.2fx  %lu selected  %s\n",
+           libmFilterTime * 1e3, filterTime * 1e3, libmFilterTime / filterTime,
+           (unsigned long)selectionCount, matches ? "ok" : "MISMATCH");
+    
+    // The approximation is only meant for coordinates close to the origin.
+    int failures = matches ? 0 : 1;
+    double originLatitudes[] = {0.0, 37.7749, 60.0, 79.9};
+    for(int o = 0; o < 4; o++) {
+        CLLocationCoordinate2D nearOrigin = CLLocationCoordinate2DMake(originLatitudes[o], -122.4194);
+        double latitudeDelta = kSGLocationBatch_ApproximateRadius / kSGLocationBatch_EarthRadius * 180.0 / M_PI;
+        double longitudeDelta = latitudeDelta / cos((originLatitudes[o] + latitudeDelta) * M_PI / 180.0);
+        NSUInteger nearIndex = 0;
+        while(nearIndex < nearCount) {
+            latitudes[nearIndex] = nearOrigin.latitude + SGBenchmarkUniform(&state, -latitudeDelta, latitudeDelta);
+            longitudes[nearIndex] = nearOrigin.longitude + SGBenchmarkUniform(&state, -longitudeDelta, longitudeDelta);
+            SGGetDistancesWithLibm(nearOrigin, latitudes + nearIndex, longitudes + nearIndex, 1,
+                                   expectedDistances + nearIndex, expectedBearings + nearIndex);
+            if(expectedDistances[nearIndex] >= 1.0 && expectedDistances[nearIndex] <= kSGLocationBatch_ApproximateRadius)
+                nearIndex++;
+        }
+        
+        SGCoordinateGetDistances(nearOrigin, latitudes, longitudes, nearCount, distances, bearings);
+        error = SGMaxDistanceError(distances, bearings, expectedDistances, expectedBearings, nearCount);
+        printf("within 10 km of %4.1f°    batch error        distance %.3g m  relative %.3g  bearing %.3g rad\n",
+               originLatitudes[o], error.distance, error.relativeDistance, error.bearing);
+        
+        SGCoordinateGetApproximateDistances(nearOrigin, latitudes, longitudes, nearCount, distances, bearings);
+        error = SGMaxDistanceError(distances, bearings, expectedDistances, expectedBearings, nearCount);
+        printf("                         approximate error  distance %.3g m  relative %.3g  bearing %.3g rad\n",
+               error.distance, error.relativeDistance, error.bearing);
+    }
+    
+    free(latitudes);
+    free(longitudes);
+    free(distances);
+    free(bearings);
+    free(expectedDistances);
+    free(expectedBearings);
+    free(selection);
+    free(expectedSelection);
+    return failures;
+}
+
+static void SGGetDistancesWithLibm(CLLocationCoordinate2D origin, const double* latitudes, const double* longitudes,
+                                   NSUInteger count, CLLocationDistance* distances, double* bearings)
+{
+    double radians = M_PI / 180.0;
+    double originLatitude = origin.latitude * radians;
+    double originLongitude = origin.longitude * radians;
+    for(NSUInteger i = 0; i < count; i++) {
+        double latitude = latitudes[i] * radians;
+        double longitudeDelta = longitudes[i] * radians - originLongitude;
+        double latitudeSine = sin((latitude - originLatitude) / 2.0);
+        double longitudeSine = sin(longitudeDelta / 2.0);
+        double a = latitudeSine * latitudeSine + cos(originLatitude) * cos(latitude) * longitudeSine * longitudeSine;
+        distances[i] = 2.0 * kSGLocationBatch_EarthRadius * atan2(sqrt(a), sqrt(1.0 - a));
+        bearings[i] = atan2(sin(longitudeDelta) * cos(latitude),
+                            cos(originLatitude) * sin(latitude) - sin(originLatitude) * cos(latitude) * cos(longitudeDelta));
+    }
+}
+
+static NSUInteger SGFilterRadiusWithLibm(CLLocationCoordinate2D origin, CLLocationDistance radius, const double* latitudes,
+                                         const double* longitudes, NSUInteger count, uint32_t* selection)
+{
+    NSUInteger selectionCount = 0;
+    for(NSUInteger i = 0; i < count; i++) {
+        double distance, bearing;
+        SGGetDistancesWithLibm(origin, latitudes + i, longitudes + i, 1, &distance, &bearing);
+        if(distance <= radius)
+            selection[selectionCount++] = (uint32_t)i;
+    }
+    
+    return selectionCount;
+}
+
+static SGDistanceError SGMaxDistanceError(const double* distances, const double* bearings,
+                                          const double* expectedDistances, const double* expectedBearings, NSUInteger count)
+{
+    // Bearings are only compared for coordinates more than a meter away,
+    // like the documentation of SGCoordinateGetDistances says.
+    SGDistanceError error = {0.0, 0.0, 0.0};
+    for(NSUInteger i = 0; i < count; i++) {
+        double distanceError = fabs(distances[i] - expectedDistances[i]);
+        error.distance = MAX(error.distance, distanceError);
+        if(expectedDistances[i] > 1.0) {
+            error.relativeDistance = MAX(error.relativeDistance, distanceError / expectedDistances[i]);
+            double bearingError = fabs(bearings[i] - expectedBearings[i]);
+            bearingError = MIN(bearingError, 2.0 * M_PI - bearingError);
+            error.bearing = MAX(error.bearing, bearingError);
+        }
+    }
+    
+    return error;
+}
@@ -0,0 +1,129 @@
+//
+//  SGEnvelopeFilterBenchmark.c
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+// Times SGEnvelopeFilterCoordinates against a loop that asks
+// SGEnvelopeContainsCoordinate about one coordinate at a time, and checks
+// that both select the same indexes.
+
+#include <stdio.h>
+
+#include "SGEnvelopeGeometry.h"
+#include "SGBenchmark.h"
+
+#define kSGEnvelopeFilterBenchmark_Count        10000000
+
+static NSUInteger SGFilterCoordinatesOneByOne(SGEnvelope envelope, const double* latitudes, const double* longitudes, NSUInteger count, uint32_t* selection);
+static int SGRunEnvelope(const char* name, SGEnvelope envelope, const double* latitudes, const double* longitudes, NSUInteger count, uint32_t* selection, uint32_t* expectedSelection);
+
+int main(void)
+{
+    NSUInteger count = kSGEnvelopeFilterBenchmark_Count;
+    double* latitudes = malloc(count * sizeof(double));
+    double* longitudes = malloc(count * sizeof(double));
+    uint32_t* selection = malloc(count * sizeof(uint32_t));
+    uint32_t* expectedSelection = malloc(count * sizeof(uint32_t));
+    if(!latitudes || !longitudes || !selection || !expectedSelection) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    for(NSUInteger i = 0; i < count; i++) {
+        latitudes[i] = SGBenchmarkUniform(&state, -90.0, 90.0);
+        longitudes[i] = SGBenchmarkUniform(&state, -180.0, 180.0);
+    }
+    
+    // A few points that sit on the edges of the envelopes below or are NaN.
+    latitudes[1] = 37.0;
+    longitudes[1] = -123.0;
+    latitudes[2] = 38.5;
+    longitudes[2] = -121.5;
+    latitudes[3] = NAN;
+    longitudes[4] = NAN;
+    longitudes[5] = 180.0;
+    longitudes[6] = -180.0;
+    
+    printf("%lu coordinates, %s build\n", (unsigned long)count, kSGBenchmark_Vector);
+    int failures = 0;
+    failures += SGRunEnvelope("bay area", SGEnvelopeMake(37.0, -123.0, 38.5, -121.5),
+                              latitudes, longitudes, count, selection, expectedSelection);
+    failures += SGRunEnvelope("quarter of the world", SGEnvelopeMake(0.0, -90.0, 90.0, 90.0),
+                              latitudes, longitudes, count, selection, expectedSelection);
+    failures += SGRunEnvelope("across the antimeridian", SGEnvelopeMake(-50.0, 160.0, 10.0, -150.0),
+                              latitudes, longitudes, count, selection, expectedSelection);
+    failures += SGRunEnvelope("up to the antimeridian", SGEnvelopeMake(-10.0, 170.0, 10.0, 180.0),
+                              latitudes, longitudes, count, selection, expectedSelection);
+    
+    free(latitudes);
+    free(longitudes);
+    free(selection);
+    free(expectedSelection);
+    return failures ? 1 : 0;
+}
+
+static int SGRunEnvelope(const char* name, SGEnvelope envelope, const double* latitudes, const double* longitudes, NSUInteger count, uint32_t* selection, uint32_t* expectedSelection)
+{
+    double oneByOneTime = INFINITY;
+    double filterTime = INFINITY;
+    NSUInteger expectedCount = 0;
+    NSUInteger selectionCount = 0;
+    for(int run = 0; run < kSGBenchmark_Runs; run++) {
+        double start = SGBenchmarkNow();
+        expectedCount = SGFilterCoordinatesOneByOne(envelope, latitudes, longitudes, count, expectedSelection);
+        oneByOneTime = MIN(oneByOneTime, SGBenchmarkNow() - start);
+        
+        start = SGBenchmarkNow();
+        selectionCount = SGEnvelopeFilterCoordinates(envelope, latitudes, longitudes, count, selection);
+        filterTime = MIN(filterTime, SGBenchmarkNow() - start);
+    }
+    
+    BOOL matches = selectionCount == expectedCount &&
+        !memcmp(selection, expectedSelection, selectionCount * sizeof(uint32_t));
+    printf("%-24s %9lu selected  one by one %7.2f ms  filter %7.2f ms  %5.2fx  %s\n",
+           name, (unsigned long)selectionCount, oneByOneTime * 1e3, filterTime * 1e3,
+           oneByOneTime / filterTime, matches ? "ok" : "MISMATCH");
+    
+    return matches ? 0 : 1;
+}
+
+static NSUInteger SGFilterCoordinatesOneByOne(SGEnvelope envelope, const double* latitudes, const double* longitudes, NSUInteger count, uint32_t* selection)
+{
+    NSUInteger selectionCount = 0;
+    for(NSUInteger i = 0; i < count; i++)
+        if(SGEnvelopeContainsCoordinate(envelope, CLLocationCoordinate2DMake(latitudes[i], longitudes[i])))
+            selection[selectionCount++] = (uint32_t)i;
+    
+    return selectionCount;
+}
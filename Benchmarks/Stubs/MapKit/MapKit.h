@@ -0,0 +1,102 @@
+//
+//  MapKit.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#ifndef SG_HOST_MAPKIT_H
+#define SG_HOST_MAPKIT_H
+
+#include <CoreLocation/CoreLocation.h>
+
+typedef struct {
+
+    double x;
+    double y;
+
+} MKMapPoint;
+
+typedef struct {
+
+    double width;
+    double height;
+
+} MKMapSize;
+
+typedef struct {
+
+    MKMapPoint origin;
+    MKMapSize size;
+
+} MKMapRect;
+
+static const MKMapRect MKMapRectNull = {{INFINITY, INFINITY}, {0.0, 0.0}};
+
+static inline MKMapRect MKMapRectMake(double x, double y, double width, double height)
+{
+    MKMapRect mapRect = {{x, y}, {width, height}};
+    return mapRect;
+}
+
+static inline BOOL MKMapRectIsNull(MKMapRect mapRect)
+{
+    return isinf(mapRect.origin.x) || isinf(mapRect.origin.y);
+}
+
+static inline MKMapRect MKMapRectUnion(MKMapRect one, MKMapRect two)
+{
+    if(MKMapRectIsNull(one))
+        return two;
+    
+    if(MKMapRectIsNull(two))
+        return one;
+    
+    double minX = MIN(one.origin.x, two.origin.x);
+    double minY = MIN(one.origin.y, two.origin.y);
+    double maxX = MAX(one.origin.x + one.size.width, two.origin.x + two.size.width);
+    double maxY = MAX(one.origin.y + one.size.height, two.origin.y + two.size.height);
+    return MKMapRectMake(minX, minY, maxX - minX, maxY - minY);
+}
+
+// The same spherical Mercator projection as MapKit, over a world that is
+// 2^28 map points wide.
+static inline MKMapPoint MKMapPointForCoordinate(CLLocationCoordinate2D coordinate)
+{
+    double worldSize = 268435456.0;
+    double latitude = coordinate.latitude * M_PI / 180.0;
+    MKMapPoint point;
+    point.x = (coordinate.longitude + 180.0) / 360.0 * worldSize;
+    point.y = (0.5 - log(tan(M_PI / 4.0 + latitude / 2.0)) / (2.0 * M_PI)) * worldSize;
+    return point;
+}
+
+#endif
@@ -0,0 +1,140 @@
+//
+//  CLLocation+Batch.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import <Foundation/Foundation.h>
+#import <CoreLocation/CoreLocation.h>
+
+/*!
+* @defined kSGLocationBatch_EarthRadius
+* @abstract The mean radius of the earth in meters.
+*/
+#define kSGLocationBatch_EarthRadius        6371009.0
+
+/*!
+* @defined kSGLocationBatch_ApproximateRadius
+* @abstract The distance in meters up to which
+* @link SGCoordinateGetApproximateDistances SGCoordinateGetApproximateDistances @/link
+* stays within its error bound.
+*/
+#define kSGLocationBatch_ApproximateRadius  10000.0
+
+/*
+* The functions below work on the latitudes and longitudes of many
+* coordinates at once, kept in two arrays. The loops have no branches, so the
+* compiler can run them on several coordinates at a time.
+*
+* Bearings are in radians, like the bearing of SGAnnotationView. They go
+* clockwise from north and are between -π and π.
+*/
+
+/*!
+* @function SGCoordinateGetDistances(CLLocationCoordinate2D, const double*, const double*, NSUInteger, CLLocationDistance*, double*)
+* @abstract Finds the great circle distances and initial bearings from one
+* coordinate to many.
+* @discussion The trigonometry is done with polynomials instead of calls to
+* libm. The distances are within 1e-5 meters of the haversine formula
+* computed with libm, around 1e-12 of the distance across the globe. The
+* bearings are within 1e-8 radians for coordinates more than a meter apart.
+* @param origin The coordinate to measure from.
+* @param latitudes The latitudes.
+* @param longitudes The longitudes.
+* @param count The amount of coordinates.
+* @param distances Receives the distances in meters. Can be NULL.
+* @param bearings Receives the bearings. Can be NULL.
+*/
+extern void SGCoordinateGetDistances(CLLocationCoordinate2D origin, const double* latitudes, const double* longitudes,
+                                     NSUInteger count, CLLocationDistance* distances, double* bearings);
+
+/*!
+* @function SGCoordinateGetApproximateDistances(CLLocationCoordinate2D, const double*, const double*, NSUInteger, CLLocationDistance*, double*)
+* @abstract Finds distances and bearings on a flat projection around the
+* origin.
+* @discussion Up to @link kSGLocationBatch_ApproximateRadius kSGLocationBatch_ApproximateRadius @/link
+* from an origin below 80 degrees of latitude, the distances are within
+* 0.001% of @link SGCoordinateGetDistances SGCoordinateGetDistances @/link
+* and the bearings within 0.005 radians. The error grows with the distance and
+* towards the poles.
+* @param origin The coordinate to measure from.
+* @param latitudes The latitudes.
+* @param longitudes The longitudes.
+* @param count The amount of coordinates.
+* @param distances Receives the distances in meters. Can be NULL.
+* @param bearings Receives the bearings. Can be NULL.
+*/
+extern void SGCoordinateGetApproximateDistances(CLLocationCoordinate2D origin, const double* latitudes, const double* longitudes,
+                                                NSUInteger count, CLLocationDistance* distances, double* bearings);
+
+/*!
+* @function SGCoordinateFilterRadius(CLLocationCoordinate2D, CLLocationDistance, const double*, const double*, NSUInteger, uint32_t*)
+* @abstract Selects the coordinates within a distance of the origin.
+* @discussion The haversine of each distance is compared with the haversine
+* of the radius, so no inverse trigonometry is needed.
+* @param origin The center of the circle.
+* @param radius The radius in meters.
+* @param latitudes The latitudes.
+* @param longitudes The longitudes.
+* @param count The amount of coordinates.
+* @param selection Receives the indexes of the selected coordinates in
+* ascending order. Has room for count indexes.
+* @result The amount of selected coordinates.
+*/
+extern NSUInteger SGCoordinateFilterRadius(CLLocationCoordinate2D origin, CLLocationDistance radius, const double* latitudes,
+                                           const double* longitudes, NSUInteger count, uint32_t* selection);
+
+#ifdef __OBJC__
+
+/*!
+* @category CLLocation (Batch)
+* @abstract Measures from a location to many coordinates at once.
+* @discussion Use these instead of calling distanceToLocation: and
+* getBearingFromCoordinate: on every annotation.
+*/
+@interface CLLocation (Batch)
+
+/*!
+* @method getDistances:bearings:toLatitudes:longitudes:count:
+* @abstract Finds the distances and bearings from the location.
+* @discussion See @link SGCoordinateGetDistances SGCoordinateGetDistances @/link.
+* @param distances Receives the distances in meters. Can be NULL.
+* @param bearings Receives the bearings in radians. Can be NULL.
+* @param latitudes The latitudes.
+* @param longitudes The longitudes.
+* @param count The amount of coordinates.
+*/
+- (void) getDistances:(CLLocationDistance*)distances bearings:(double*)bearings toLatitudes:(const double*)latitudes longitudes:(const double*)longitudes count:(NSUInteger)count;
+
+@end
+
+#endif
@@ -0,0 +1,208 @@
+//
+//  CLLocation+Batch.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import "CLLocation+Batch.h"
+
+#define kSGLocationBatch_BlockSize          256
+
+static inline void SGSinCos(double x, double* sine, double* cosine);
+static inline double SGAtan2(double y, double x);
+static inline double SGWrapRadians(double x);
+
+void SGCoordinateGetDistances(CLLocationCoordinate2D origin, const double* latitudes, const double* longitudes,
+                              NSUInteger count, CLLocationDistance* distances, double* bearings)
+{
+    double radians = M_PI / 180.0;
+    double originLatitude = origin.latitude * radians;
+    double originLongitude = origin.longitude * radians;
+    double originHalfSine = sin(originLatitude / 2.0);
+    double originHalfCosine = cos(originLatitude / 2.0);
+    double originSine = sin(originLatitude);
+    double originCosine = cos(originLatitude);
+    
+    // Every angle is halved until it is within π/4 of 0, where the
+    // polynomials are accurate, and the double angle formulas bring it back.
+    for(NSUInteger i = 0; i < count; i++) {
+        double halfSine, halfCosine;
+        SGSinCos(latitudes[i] * radians / 2.0, &halfSine, &halfCosine);
+        double latitudeSine = 2.0 * halfSine * halfCosine;
+        double latitudeCosine = (halfCosine - halfSine) * (halfCosine + halfSine);
+        double halfDeltaSine = halfSine * originHalfCosine - halfCosine * originHalfSine;
+        
+        double quarterSine, quarterCosine;
+        SGSinCos(SGWrapRadians(longitudes[i] * radians - originLongitude) / 4.0, &quarterSine, &quarterCosine);
+        double halfLongitudeSine = 2.0 * quarterSine * quarterCosine;
+        double halfLongitudeCosine = (quarterCosine - quarterSine) * (quarterCosine + quarterSine);
+        
+        if(distances) {
+            double a = halfDeltaSine * halfDeltaSine + originCosine * latitudeCosine * halfLongitudeSine * halfLongitudeSine;
+            a = MIN(MAX(a, 0.0), 1.0);
+            distances[i] = 2.0 * kSGLocationBatch_EarthRadius * SGAtan2(sqrt(a), sqrt(1.0 - a));
+        }
+        
+        if(bearings) {
+            double longitudeSine = 2.0 * halfLongitudeSine * halfLongitudeCosine;
+            double longitudeCosine = (halfLongitudeCosine - halfLongitudeSine) * (halfLongitudeCosine + halfLongitudeSine);
+            bearings[i] = SGAtan2(longitudeSine * latitudeCosine,
+                                  originCosine * latitudeSine - originSine * latitudeCosine * longitudeCosine);
+        }
+    }
+}
+
+void SGCoordinateGetApproximateDistances(CLLocationCoordinate2D origin, const double* latitudes, const double* longitudes,
+                                         NSUInteger count, CLLocationDistance* distances, double* bearings)
+{
+    double radians = M_PI / 180.0;
+    double originLatitude = origin.latitude * radians;
+    double originLongitude = origin.longitude * radians;
+    double originSine = sin(originLatitude);
+    double originCosine = cos(originLatitude);
+    
+    // The longitudes are scaled by the cosine of the latitude halfway to
+    // each coordinate, which is close to a line from the origin's.
+    for(NSUInteger i = 0; i < count; i++) {
+        double latitudeDelta = latitudes[i] * radians - originLatitude;
+        double x = SGWrapRadians(longitudes[i] * radians - originLongitude) * (originCosine - originSine * latitudeDelta / 2.0);
+        double y = latitudeDelta;
+        
+        if(distances)
+            distances[i] = kSGLocationBatch_EarthRadius * sqrt(x * x + y * y);
+        
+        if(bearings)
+            bearings[i] = SGAtan2(x, y);
+    }
+}
+
+NSUInteger SGCoordinateFilterRadius(CLLocationCoordinate2D origin, CLLocationDistance radius, const double* latitudes,
+                                    const double* longitudes, NSUInteger count, uint32_t* selection)
+{
+    double radians = M_PI / 180.0;
+    double originLatitude = origin.latitude * radians;
+    double originLongitude = origin.longitude * radians;
+    double originHalfSine = sin(originLatitude / 2.0);
+    double originHalfCosine = cos(originLatitude / 2.0);
+    double originCosine = cos(originLatitude);
+    
+    double halfRadiusSine = sin(MIN(radius / kSGLocationBatch_EarthRadius, M_PI) / 2.0);
+    double maxHaversine = radius >= M_PI * kSGLocationBatch_EarthRadius ? INFINITY : halfRadiusSine * halfRadiusSine;
+    
+    // The haversines of a block are found first, in a loop that can be
+    // vectorized, and then compacted into the selection.
+    double haversines[kSGLocationBatch_BlockSize];
+    NSUInteger selectionCount = 0;
+    for(NSUInteger start = 0; start < count; start += kSGLocationBatch_BlockSize) {
+        NSUInteger blockCount = MIN(count - start, kSGLocationBatch_BlockSize);
+        const double* blockLatitudes = latitudes + start;
+        const double* blockLongitudes = longitudes + start;
+        for(NSUInteger i = 0; i < blockCount; i++) {
+            double halfSine, halfCosine;
+            SGSinCos(blockLatitudes[i] * radians / 2.0, &halfSine, &halfCosine);
+            double latitudeCosine = (halfCosine - halfSine) * (halfCosine + halfSine);
+            double halfDeltaSine = halfSine * originHalfCosine - halfCosine * originHalfSine;
+            
+            double quarterSine, quarterCosine;
+            SGSinCos(SGWrapRadians(blockLongitudes[i] * radians - originLongitude) / 4.0, &quarterSine, &quarterCosine);
+            double halfLongitudeSine = 2.0 * quarterSine * quarterCosine;
+            
+            haversines[i] = halfDeltaSine * halfDeltaSine + originCosine * latitudeCosine * halfLongitudeSine * halfLongitudeSine;
+        }
+        
+        for(NSUInteger i = 0; i < blockCount; i++) {
+            selection[selectionCount] = (uint32_t)(start + i);
+            selectionCount += haversines[i] <= maxHaversine;
+        }
+    }
+    
+    return selectionCount;
+}
+
+#ifdef __OBJC__
+
+@implementation CLLocation (Batch)
+
+- (void) getDistances:(CLLocationDistance*)distances bearings:(double*)bearings toLatitudes:(const double*)latitudes longitudes:(const double*)longitudes count:(NSUInteger)count
+{
+    SGCoordinateGetDistances(self.coordinate, latitudes, longitudes, count, distances, bearings);
+}
+
+@end
+
+#endif
+
+static inline void SGSinCos(double x, double* sine, double* cosine)
+{
+    // The Cephes polynomials for |x| <= π/4.
+    double z = x * x;
+    *sine = x + x * z * (((((1.58962301576546568060e-10 * z - 2.50507477628578072866e-8) * z +
+                           2.75573136213857245213e-6) * z - 1.98412698295895385996e-4) * z +
+                         8.33333333332211858878e-3) * z - 1.66666666666666307295e-1);
+    *cosine = 1.0 - 0.5 * z + z * z * (((((-1.13585365213876817300e-11 * z + 2.08757008419747316778e-9) * z -
+                                          2.75573141792967388112e-7) * z + 2.48015872888517045348e-5) * z -
+                                        1.38888888888730564116e-3) * z + 4.16666666666665929218e-2);
+}
+
+static inline double SGAtan2(double y, double x)
+{
+    // The ratio of the smaller to the larger side is between 0 and 1. Above
+    // 0.66 it is moved down by π/4, and the Cephes rational function covers
+    // the rest. Both sides of every choice are computed so the choices are
+    // selects instead of branches.
+    double absoluteY = fabs(y);
+    double absoluteX = fabs(x);
+    double larger = MAX(absoluteX, absoluteY);
+    double smaller = MIN(absoluteX, absoluteY);
+    double t = smaller / MAX(larger, DBL_MIN);
+    
+    double shiftedT = (t - 1.0) / (t + 1.0);
+    double offset = t > 0.66 ? M_PI_4 : 0.0;
+    t = t > 0.66 ? shiftedT : t;
+    
+    double z = t * t;
+    double p = (((-8.750608600031904122785e-1 * z - 1.615753718733365076637e1) * z -
+                 7.500855792314704667340e1) * z - 1.228866684490136173410e2) * z - 6.485021904942025371773e1;
+    double q = ((((z + 2.485846490142306297962e1) * z + 1.650270098316988542046e2) * z +
+                 4.328810604912902668951e2) * z + 4.853903996359136964868e2) * z + 1.945506571482613964425e2;
+    double angle = offset + t + t * z * p / q;
+    
+    angle = absoluteY > absoluteX ? M_PI_2 - angle : angle;
+    angle = x < 0.0 ? M_PI - angle : angle;
+    return y < 0.0 ? -angle : angle;
+}
+
+static inline double SGWrapRadians(double x)
+{
+    x = x > M_PI ? x - 2.0 * M_PI : x;
+    return x < -M_PI ? x + 2.0 * M_PI : x;
+}
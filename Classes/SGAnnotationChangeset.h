@@ -0,0 +1,155 @@
+//
+//  SGAnnotationChangeset.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import <Foundation/Foundation.h>
+
+/*!
+* @class SGAnnotationChangeset
+* @abstract The difference between the records a layer shows and the records
+* it should show.
+* @discussion Records are matched by their recordId, so building the
+* changeset is linear in the number of records. A record that is present on
+* both sides keeps the annotation that is already on the map. If the new
+* version differs, @link applyUpdates applyUpdates @/link copies it into that
+* annotation, moving it in place when the coordinate changed, instead of
+* removing it and adding it again.
+*
+* The annotations on the map are changed on the main thread while the next
+* changeset may be built on another one, so they are never read while
+* building. Records are compared against @link versions versions @/link
+* instead, immutable copies of what was last shown for every recordId, which
+* each changeset hands on to the next.
+*
+* A changeset can be built on any thread. The updates must be applied on the
+* main thread.
+*/
+@interface SGAnnotationChangeset : NSObject {
+
+    @private
+    NSMutableArray* insertedAnnotations;
+    NSMutableArray* removedAnnotations;
+    NSMutableArray* updatedAnnotations;
+    NSMutableArray* updatedSources;
+    NSMutableDictionary* annotations;
+    NSMutableDictionary* versions;
+}
+
+/*!
+* @property
+* @abstract The annotations that have to be added to the map.
+*/
+@property (nonatomic, readonly) NSArray* insertedAnnotations;
+
+/*!
+* @property
+* @abstract The annotations that have to be removed from the map.
+*/
+@property (nonatomic, readonly) NSArray* removedAnnotations;
+
+/*!
+* @property
+* @abstract The annotations on the map whose record changed.
+*/
+@property (nonatomic, readonly) NSArray* updatedAnnotations;
+
+/*!
+* @property
+* @abstract The annotations that are shown once the changeset is applied,
+* keyed by @link annotationKey: annotationKey: @/link.
+*/
+@property (nonatomic, readonly) NSDictionary* annotations;
+
+/*!
+* @property
+* @abstract The versions of the records that are shown once the changeset is
+* applied, keyed by recordId.
+*/
+@property (nonatomic, readonly) NSDictionary* versions;
+
+/*!
+* @method initWithAnnotations:versions:recordAnnotations:
+* @abstract Compares the annotations that are shown with the new records.
+* @param annotations The annotations that are shown, keyed by
+* @link annotationKey: annotationKey: @/link. Can be nil.
+* @param versions The @link versions versions @/link of the previous
+* changeset. Can be nil.
+* @param recordAnnotations The records that should be shown.
+*/
+- (id) initWithAnnotations:(NSDictionary*)annotations versions:(NSDictionary*)versions recordAnnotations:(NSArray*)recordAnnotations;
+
+/*!
+* @method initWithAnnotations:versions:insertedRecordAnnotations:removedRecordAnnotations:
+* @abstract Builds a changeset from records that are known to come and go,
+* without comparing every record that is shown.
+* @param annotations The annotations that are shown, keyed by
+* @link annotationKey: annotationKey: @/link. Can be nil.
+* @param versions The @link versions versions @/link of the previous
+* changeset. Can be nil.
+* @param insertedRecordAnnotations The records to add. Records that are shown
+* already are left alone.
+* @param removedRecordAnnotations The records to remove.
+*/
+- (id) initWithAnnotations:(NSDictionary*)annotations
+                  versions:(NSDictionary*)versions
+ insertedRecordAnnotations:(NSArray*)insertedRecordAnnotations
+  removedRecordAnnotations:(NSArray*)removedRecordAnnotations;
+
+/*!
+* @method annotationKey:
+* @result The recordId of the annotation or, for an annotation without one
+* such as a cluster, the annotation itself.
+*/
++ (id) annotationKey:(id<SGRecordAnnotation>)recordAnnotation;
+
+/*!
+* @method hasChanges
+* @result YES if anything has to be inserted, removed or updated.
+*/
+- (BOOL) hasChanges;
+
+/*!
+* @method applyUpdates
+* @abstract Copies the new version of every updated record into the annotation
+* that is on the map.
+*/
+- (void) applyUpdates;
+
+/*!
+* @method applyUpdatesInRange:
+* @abstract Applies part of the @link updatedAnnotations updatedAnnotations @/link.
+*/
+- (void) applyUpdatesInRange:(NSRange)range;
+
+@end
@@ -0,0 +1,242 @@
+//
+//  SGAnnotationChangeset.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import "SGAnnotationChangeset.h"
+
+@interface SGAnnotationChangeset (Private)
+
+- (NSDictionary*) versionForRecordAnnotation:(id<SGRecordAnnotation>)recordAnnotation;
+- (BOOL) canUpdateRecordAnnotation:(id<SGRecordAnnotation>)recordAnnotation;
+- (void) updateRecordAnnotation:(id<SGRecordAnnotation>)recordAnnotation withRecordAnnotation:(id<SGRecordAnnotation>)source;
+
+@end
+
+@implementation SGAnnotationChangeset
+@synthesize insertedAnnotations, removedAnnotations, updatedAnnotations, annotations, versions;
+
+- (id) initWithAnnotations:(NSDictionary*)currentAnnotations versions:(NSDictionary*)currentVersions recordAnnotations:(NSArray*)recordAnnotations
+{
+    if(self = [super init]) {
+        insertedAnnotations = [[NSMutableArray alloc] init];
+        removedAnnotations = [[NSMutableArray alloc] init];
+        updatedAnnotations = [[NSMutableArray alloc] init];
+        updatedSources = [[NSMutableArray alloc] init];
+        annotations = [[NSMutableDictionary alloc] initWithCapacity:[recordAnnotations count]];
+        versions = [[NSMutableDictionary alloc] initWithCapacity:[recordAnnotations count]];
+        
+        // The new records are not on the map yet, so they can be read here.
+        // What is on the map is only known through its version.
+        for(id<SGRecordAnnotation> recordAnnotation in recordAnnotations) {
+            id key = [SGAnnotationChangeset annotationKey:recordAnnotation];
+            if([annotations objectForKey:key])
+                continue;
+            
+            id<SGRecordAnnotation> currentAnnotation = [currentAnnotations objectForKey:key];
+            NSDictionary* currentVersion = [currentVersions objectForKey:key];
+            NSDictionary* version = nil;
+            if(currentAnnotation != recordAnnotation && [key isKindOfClass:[NSString class]])
+                version = [self versionForRecordAnnotation:recordAnnotation];
+            
+            if(!currentAnnotation)
+                [insertedAnnotations addObject:recordAnnotation];
+            else if(currentAnnotation == recordAnnotation) {
+                version = currentVersion;
+                // An annotation that carries its own update, like a cluster
+                // whose members changed.
+                if([recordAnnotation respondsToSelector:@selector(hasPendingUpdate)] && [(id)recordAnnotation hasPendingUpdate]) {
+                    [updatedAnnotations addObject:recordAnnotation];
+                    [updatedSources addObject:recordAnnotation];
+                }
+            } else if(!currentVersion || ![currentVersion isEqualToDictionary:version]) {
+                if([self canUpdateRecordAnnotation:currentAnnotation]) {
+                    [updatedAnnotations addObject:currentAnnotation];
+                    [updatedSources addObject:recordAnnotation];
+                    recordAnnotation = currentAnnotation;
+                } else {
+                    [removedAnnotations addObject:currentAnnotation];
+                    [insertedAnnotations addObject:recordAnnotation];
+                }
+            } else
+                recordAnnotation = currentAnnotation;
+            
+            [annotations setObject:recordAnnotation forKey:key];
+            if(version)
+                [versions setObject:version forKey:key];
+        }
+        
+        for(id key in currentAnnotations)
+            if(![annotations objectForKey:key])
+                [removedAnnotations addObject:[currentAnnotations objectForKey:key]];
+    }
+    
+    return self;
+}
+
+- (id) initWithAnnotations:(NSDictionary*)currentAnnotations
+                  versions:(NSDictionary*)currentVersions
+ insertedRecordAnnotations:(NSArray*)insertedRecordAnnotations
+  removedRecordAnnotations:(NSArray*)removedRecordAnnotations
+{
+    if(self = [super init]) {
+        insertedAnnotations = [[NSMutableArray alloc] init];
+        removedAnnotations = [[NSMutableArray alloc] init];
+        updatedAnnotations = [[NSMutableArray alloc] init];
+        updatedSources = [[NSMutableArray alloc] init];
+        annotations = currentAnnotations ? [currentAnnotations mutableCopy] : [[NSMutableDictionary alloc] init];
+        versions = currentVersions ? [currentVersions mutableCopy] : [[NSMutableDictionary alloc] init];
+        
+        for(id<SGRecordAnnotation> recordAnnotation in removedRecordAnnotations) {
+            id key = [SGAnnotationChangeset annotationKey:recordAnnotation];
+            id<SGRecordAnnotation> currentAnnotation = [annotations objectForKey:key];
+            if(currentAnnotation) {
+                [removedAnnotations addObject:currentAnnotation];
+                [annotations removeObjectForKey:key];
+                [versions removeObjectForKey:key];
+            }
+        }
+        
+        for(id<SGRecordAnnotation> recordAnnotation in insertedRecordAnnotations) {
+            id key = [SGAnnotationChangeset annotationKey:recordAnnotation];
+            if([annotations objectForKey:key])
+                continue;
+            
+            [insertedAnnotations addObject:recordAnnotation];
+            [annotations setObject:recordAnnotation forKey:key];
+            if([key isKindOfClass:[NSString class]])
+                [versions setObject:[self versionForRecordAnnotation:recordAnnotation] forKey:key];
+        }
+    }
+    
+    return self;
+}
+
++ (id) annotationKey:(id<SGRecordAnnotation>)recordAnnotation
+{
+    NSString* recordId = [recordAnnotation respondsToSelector:@selector(recordId)] ? [recordAnnotation recordId] : nil;
+    return recordId ? (id)recordId : (id)[NSValue valueWithNonretainedObject:recordAnnotation];
+}
+
+- (BOOL) hasChanges
+{
+    return [insertedAnnotations count] || [removedAnnotations count] || [updatedAnnotations count];
+}
+
+- (void) applyUpdates
+{
+    [self applyUpdatesInRange:NSMakeRange(0, [updatedAnnotations count])];
+}
+
+- (void) applyUpdatesInRange:(NSRange)range
+{
+    for(NSUInteger i = range.location; i < NSMaxRange(range); i++)
+        [self updateRecordAnnotation:[updatedAnnotations objectAtIndex:i]
+                withRecordAnnotation:[updatedSources objectAtIndex:i]];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Utility methods 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (NSDictionary*) versionForRecordAnnotation:(id<SGRecordAnnotation>)recordAnnotation
+{
+    NSMutableDictionary* version = [NSMutableDictionary dictionaryWithCapacity:4];
+    
+    CLLocationCoordinate2D coordinate = recordAnnotation.coordinate;
+    [version setObject:[NSNumber numberWithDouble:coordinate.latitude] forKey:@"latitude"];
+    [version setObject:[NSNumber numberWithDouble:coordinate.longitude] forKey:@"longitude"];
+    
+    if([recordAnnotation respondsToSelector:@selector(expires)])
+        [version setObject:[NSNumber numberWithDouble:[recordAnnotation expires]] forKey:@"expires"];
+    
+    if([recordAnnotation respondsToSelector:@selector(properties)] && [recordAnnotation properties]) {
+        NSDictionary* properties = [[NSDictionary alloc] initWithDictionary:[recordAnnotation properties]];
+        [version setObject:properties forKey:@"properties"];
+        [properties release];
+    }
+    
+    return version;
+}
+
+- (BOOL) canUpdateRecordAnnotation:(id<SGRecordAnnotation>)recordAnnotation
+{
+    return [recordAnnotation isKindOfClass:[SGRecord class]] ||
+        [recordAnnotation respondsToSelector:@selector(updateRecordWithGeoJSONObject:)];
+}
+
+- (void) updateRecordAnnotation:(id<SGRecordAnnotation>)recordAnnotation withRecordAnnotation:(id<SGRecordAnnotation>)source
+{
+    if(recordAnnotation == source) {
+        [(id)recordAnnotation applyPendingUpdate];
+        return;
+    }
+    
+    // MapKit moves the annotation view when it observes the coordinate change.
+    NSObject* annotation = (NSObject*)recordAnnotation;
+    [annotation willChangeValueForKey:@"coordinate"];
+    
+    if([recordAnnotation isKindOfClass:[SGRecord class]]) {
+        SGRecord* record = (SGRecord*)recordAnnotation;
+        CLLocationCoordinate2D coordinate = source.coordinate;
+        record.latitude = coordinate.latitude;
+        record.longitude = coordinate.longitude;
+        
+        if([source respondsToSelector:@selector(expires)])
+            record.expires = [source expires];
+        
+        if([source respondsToSelector:@selector(created)])
+            record.created = [source created];
+        
+        if([source respondsToSelector:@selector(properties)])
+            record.properties = [NSMutableDictionary dictionaryWithDictionary:[source properties]];
+    } else
+        [recordAnnotation updateRecordWithGeoJSONObject:[SGGeoJSONEncoder geoJSONObjectForRecordAnnotation:source]];
+    
+    [annotation didChangeValueForKey:@"coordinate"];
+}
+
+- (void) dealloc
+{
+    [insertedAnnotations release];
+    [removedAnnotations release];
+    [updatedAnnotations release];
+    [updatedSources release];
+    [annotations release];
+    [versions release];
+    
+    [super dealloc];
+}
+
+@end
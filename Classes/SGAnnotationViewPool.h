@@ -0,0 +1,142 @@
+//
+//  SGAnnotationViewPool.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import <Foundation/Foundation.h>
+#import <MapKit/MapKit.h>
+#import <QuartzCore/QuartzCore.h>
+
+typedef MKAnnotationView* (^SGAnnotationViewBuilder)(NSString* reuseIdentifier);
+
+/*!
+* @class SGAnnotationViewPool
+* @abstract Builds annotation views ahead of time so a large page of records
+* does not create all of its views in one frame.
+* @discussion A pool holds spare views for one reuse identifier. After
+* @link warmUp warmUp @/link it builds
+* @link viewsPerFrame viewsPerFrame @/link views per frame until it holds
+* @link targetCount targetCount @/link. Warming runs in the default run loop
+* mode, so it pauses while the user drags the map.
+*
+* @link dequeueAnnotationViewForAnnotation:fromMapView: dequeueAnnotationViewForAnnotation:fromMapView: @/link
+* tries the reuse queue of the map first, then the pool, and only builds a
+* view when both are empty. The hit and miss counters can be used to tune
+* the pool.
+*/
+@interface SGAnnotationViewPool : NSObject {
+
+    NSUInteger targetCount;
+    NSUInteger viewsPerFrame;
+    
+    @private
+    NSString* reuseIdentifier;
+    SGAnnotationViewBuilder builder;
+    NSMutableArray* annotationViews;
+    CADisplayLink* displayLink;
+    
+    NSUInteger hitCount;
+    NSUInteger missCount;
+}
+
+/*!
+* @property
+* @abstract The reuse identifier of the views.
+*/
+@property (nonatomic, readonly) NSString* reuseIdentifier;
+
+/*!
+* @property
+* @abstract The amount of spare views the pool builds up to. The default is 0.
+*/
+@property (nonatomic, assign) NSUInteger targetCount;
+
+/*!
+* @property
+* @abstract The amount of views built in every frame while warming up. The
+* default is 4.
+*/
+@property (nonatomic, assign) NSUInteger viewsPerFrame;
+
+/*!
+* @property
+* @abstract The amount of spare views.
+*/
+@property (nonatomic, readonly) NSUInteger count;
+
+/*!
+* @property
+* @abstract The views that came from the reuse queue of the map or from the pool.
+*/
+@property (nonatomic, readonly) NSUInteger hitCount;
+
+/*!
+* @property
+* @abstract The views that had to be built while they were requested.
+*/
+@property (nonatomic, readonly) NSUInteger missCount;
+
+/*!
+* @method initWithReuseIdentifier:builder:
+* @param reuseIdentifier The reuse identifier of the views.
+* @param builder Builds a new view with the reuse identifier. Called on the
+* main thread.
+*/
+- (id) initWithReuseIdentifier:(NSString*)reuseIdentifier builder:(SGAnnotationViewBuilder)builder;
+
+/*!
+* @method dequeueAnnotationViewForAnnotation:fromMapView:
+* @result A view for the annotation.
+*/
+- (MKAnnotationView*) dequeueAnnotationViewForAnnotation:(id<MKAnnotation>)annotation fromMapView:(MKMapView*)mapView;
+
+/*!
+* @method warmUp
+* @abstract Starts building views until the pool holds
+* @link targetCount targetCount @/link.
+*/
+- (void) warmUp;
+
+/*!
+* @method drain
+* @abstract Stops warming up and releases the spare views.
+*/
+- (void) drain;
+
+/*!
+* @method resetStatistics
+* @abstract Sets the hit and miss counters back to 0.
+*/
+- (void) resetStatistics;
+
+@end
@@ -0,0 +1,151 @@
+//
+//  SGAnnotationViewPool.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import "SGAnnotationViewPool.h"
+
+@interface SGAnnotationViewPool (Private)
+
+- (void) buildAnnotationViews;
+- (void) stopWarmingUp;
+
+@end
+
+@implementation SGAnnotationViewPool
+@synthesize reuseIdentifier, targetCount, viewsPerFrame, hitCount, missCount;
+
+- (id) initWithReuseIdentifier:(NSString*)identifier builder:(SGAnnotationViewBuilder)newBuilder
+{
+    if(self = [super init]) {
+        reuseIdentifier = [identifier copy];
+        builder = Block_copy(newBuilder);
+        annotationViews = [[NSMutableArray alloc] init];
+        displayLink = nil;
+        
+        targetCount = 0;
+        viewsPerFrame = 4;
+        hitCount = 0;
+        missCount = 0;
+    }
+    
+    return self;
+}
+
+- (NSUInteger) count
+{
+    return [annotationViews count];
+}
+
+- (MKAnnotationView*) dequeueAnnotationViewForAnnotation:(id<MKAnnotation>)annotation fromMapView:(MKMapView*)mapView
+{
+    MKAnnotationView* annotationView = [mapView dequeueReusableAnnotationViewWithIdentifier:reuseIdentifier];
+    if(!annotationView && [annotationViews count]) {
+        annotationView = [[[annotationViews lastObject] retain] autorelease];
+        [annotationViews removeLastObject];
+    }
+    
+    if(annotationView)
+        hitCount++;
+    else {
+        annotationView = builder(reuseIdentifier);
+        missCount++;
+    }
+    
+    annotationView.annotation = annotation;
+    return annotationView;
+}
+
+- (void) warmUp
+{
+    if(!displayLink && [annotationViews count] < targetCount) {
+        displayLink = [[CADisplayLink displayLinkWithTarget:self selector:@selector(buildAnnotationViews)] retain];
+        [displayLink addToRunLoop:[NSRunLoop mainRunLoop] forMode:NSDefaultRunLoopMode];
+    }
+}
+
+- (void) drain
+{
+    [self stopWarmingUp];
+    [annotationViews removeAllObjects];
+}
+
+- (void) resetStatistics
+{
+    hitCount = 0;
+    missCount = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Warming up 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (void) buildAnnotationViews
+{
+    for(NSUInteger i = 0; i < MAX(viewsPerFrame, 1) && [annotationViews count] < targetCount; i++) {
+        MKAnnotationView* annotationView = builder(reuseIdentifier);
+        if(!annotationView) {
+            [self stopWarmingUp];
+            return;
+        }
+        
+        [annotationViews addObject:annotationView];
+    }
+    
+    if([annotationViews count] >= targetCount)
+        [self stopWarmingUp];
+}
+
+- (void) stopWarmingUp
+{
+    // The display link retains the pool, so it is only around while the pool
+    // is warming up.
+    [displayLink invalidate];
+    [displayLink release];
+    displayLink = nil;
+}
+
+- (void) dealloc
+{
+    [displayLink invalidate];
+    [displayLink release];
+    
+    [reuseIdentifier release];
+    Block_release(builder);
+    [annotationViews release];
+    
+    [super dealloc];
+}
+
+@end
@@ -0,0 +1,79 @@
+//
+//  SGBoundingBox.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+
+#import <Foundation/Foundation.h>
+#import <MapKit/MapKit.h>
+
+/*
+* The functions below find bounding boxes with a min/max pass that handles
+* several points at a time with AVX, SSE2 or NEON, whichever the build
+* targets. The x and y, or latitude and longitude, of a point sit next to
+* each other in memory, so both are reduced by the same instructions.
+*/
+
+/*!
+* @function SGMapRectForMapPoints(const MKMapPoint*, NSUInteger)
+* @abstract Finds the smallest map rect that contains some points.
+* @param points The points.
+* @param count The amount of points.
+* @result The map rect, or MKMapRectNull if there are no points.
+*/
+extern MKMapRect SGMapRectForMapPoints(const MKMapPoint* points, NSUInteger count);
+
+/*!
+* @function SGMapRectExtendWithMapPoints(MKMapRect, const MKMapPoint*, NSUInteger)
+* @abstract Grows a map rect to contain some more points.
+* @discussion Only the new points are read, so a line that is appended to
+* keeps its bounds by passing the points that were added.
+* @param mapRect The map rect to grow. Can be MKMapRectNull.
+* @param points The new points.
+* @param count The amount of new points.
+* @result The grown map rect.
+*/
+extern MKMapRect SGMapRectExtendWithMapPoints(MKMapRect mapRect, const MKMapPoint* points, NSUInteger count);
+
+/*!
+* @function SGMapRectForCoordinates(const CLLocationCoordinate2D*, NSUInteger)
+* @abstract Finds the smallest map rect that contains some coordinates.
+* @discussion The same as SGGetAxisAlignedBoundingBox. The coordinates are
+* reduced before they are projected, which is exact since the projection
+* keeps the order of latitudes and longitudes, so only the two corners go
+* through MKMapPointForCoordinate.
+* @param coordinates The coordinates.
+* @param count The amount of coordinates.
+* @result The map rect, or MKMapRectNull if there are no coordinates.
+*/
+extern MKMapRect SGMapRectForCoordinates(const CLLocationCoordinate2D* coordinates, NSUInteger count);
@@ -0,0 +1,143 @@
+//
+//  SGBoundingBox.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+
+#import "SGBoundingBox.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif (defined(__ARM_NEON__) || defined(__ARM_NEON)) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+static void SGGetPairBounds(const double* pairs, NSUInteger count, double* minimum, double* maximum);
+
+MKMapRect SGMapRectForMapPoints(const MKMapPoint* points, NSUInteger count)
+{
+    if(!count)
+        return MKMapRectNull;
+    
+    double minimum[2], maximum[2];
+    SGGetPairBounds((const double*)points, count, minimum, maximum);
+    return MKMapRectMake(minimum[0], minimum[1], maximum[0] - minimum[0], maximum[1] - minimum[1]);
+}
+
+MKMapRect SGMapRectExtendWithMapPoints(MKMapRect mapRect, const MKMapPoint* points, NSUInteger count)
+{
+    MKMapRect pointsMapRect = SGMapRectForMapPoints(points, count);
+    if(MKMapRectIsNull(mapRect))
+        return pointsMapRect;
+    
+    return MKMapRectIsNull(pointsMapRect) ? mapRect : MKMapRectUnion(mapRect, pointsMapRect);
+}
+
+MKMapRect SGMapRectForCoordinates(const CLLocationCoordinate2D* coordinates, NSUInteger count)
+{
+    if(!count)
+        return MKMapRectNull;
+    
+    // North is up on the map, so the northwest corner is the origin.
+    double minimum[2], maximum[2];
+    SGGetPairBounds((const double*)coordinates, count, minimum, maximum);
+    MKMapPoint origin = MKMapPointForCoordinate(CLLocationCoordinate2DMake(maximum[0], minimum[1]));
+    MKMapPoint corner = MKMapPointForCoordinate(CLLocationCoordinate2DMake(minimum[0], maximum[1]));
+    return MKMapRectMake(origin.x, origin.y, corner.x - origin.x, corner.y - origin.y);
+}
+
+static void SGGetPairBounds(const double* pairs, NSUInteger count, double* minimum, double* maximum)
+{
+    // Several accumulators keep the reductions from waiting on each other.
+    NSUInteger i = 0;
+    
+#if defined(__AVX__)
+    __m256d minimum4 = _mm256_set_pd(pairs[1], pairs[0], pairs[1], pairs[0]);
+    __m256d maximum4 = minimum4;
+    __m256d otherMinimum4 = minimum4;
+    __m256d otherMaximum4 = minimum4;
+    for(; i + 4 <= count; i += 4) {
+        __m256d values = _mm256_loadu_pd(pairs + 2 * i);
+        __m256d otherValues = _mm256_loadu_pd(pairs + 2 * i + 4);
+        minimum4 = _mm256_min_pd(minimum4, values);
+        maximum4 = _mm256_max_pd(maximum4, values);
+        otherMinimum4 = _mm256_min_pd(otherMinimum4, otherValues);
+        otherMaximum4 = _mm256_max_pd(otherMaximum4, otherValues);
+    }
+    
+    minimum4 = _mm256_min_pd(minimum4, otherMinimum4);
+    maximum4 = _mm256_max_pd(maximum4, otherMaximum4);
+    _mm_storeu_pd(minimum, _mm_min_pd(_mm256_castpd256_pd128(minimum4), _mm256_extractf128_pd(minimum4, 1)));
+    _mm_storeu_pd(maximum, _mm_max_pd(_mm256_castpd256_pd128(maximum4), _mm256_extractf128_pd(maximum4, 1)));
+#elif defined(__SSE2__)
+    __m128d minimum2[4], maximum2[4];
+    for(int j = 0; j < 4; j++)
+        minimum2[j] = maximum2[j] = _mm_loadu_pd(pairs);
+    
+    for(; i + 4 <= count; i += 4)
+        for(int j = 0; j < 4; j++) {
+            __m128d values = _mm_loadu_pd(pairs + 2 * (i + j));
+            minimum2[j] = _mm_min_pd(minimum2[j], values);
+            maximum2[j] = _mm_max_pd(maximum2[j], values);
+        }
+    
+    _mm_storeu_pd(minimum, _mm_min_pd(_mm_min_pd(minimum2[0], minimum2[1]), _mm_min_pd(minimum2[2], minimum2[3])));
+    _mm_storeu_pd(maximum, _mm_max_pd(_mm_max_pd(maximum2[0], maximum2[1]), _mm_max_pd(maximum2[2], maximum2[3])));
+#elif (defined(__ARM_NEON__) || defined(__ARM_NEON)) && defined(__aarch64__)
+    float64x2_t minimum2[4], maximum2[4];
+    for(int j = 0; j < 4; j++)
+        minimum2[j] = maximum2[j] = vld1q_f64(pairs);
+    
+    for(; i + 4 <= count; i += 4)
+        for(int j = 0; j < 4; j++) {
+            float64x2_t values = vld1q_f64(pairs + 2 * (i + j));
+            minimum2[j] = vminq_f64(minimum2[j], values);
+            maximum2[j] = vmaxq_f64(maximum2[j], values);
+        }
+    
+    vst1q_f64(minimum, vminq_f64(vminq_f64(minimum2[0], minimum2[1]), vminq_f64(minimum2[2], minimum2[3])));
+    vst1q_f64(maximum, vmaxq_f64(vmaxq_f64(maximum2[0], maximum2[1]), vmaxq_f64(maximum2[2], maximum2[3])));
+#else
+    minimum[0] = maximum[0] = pairs[0];
+    minimum[1] = maximum[1] = pairs[1];
+#endif
+    
+    for(; i < count; i++) {
+        minimum[0] = MIN(minimum[0], pairs[2 * i]);
+        minimum[1] = MIN(minimum[1], pairs[2 * i + 1]);
+        maximum[0] = MAX(maximum[0], pairs[2 * i]);
+        maximum[1] = MAX(maximum[1], pairs[2 * i + 1]);
+    }
+}
@@ -0,0 +1,91 @@
+//
+//  SGClusterAnnotation.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import <Foundation/Foundation.h>
+#import <MapKit/MapKit.h>
+
+/*!
+* @class SGClusterAnnotation
+* @abstract An annotation that stands for several records.
+* @discussion Clusters are built by an
+* @link //simplegeo/ooc/cl/SGClusterTree SGClusterTree @/link. The coordinate
+* is the centroid of the records. A cluster that stays visible while its
+* records change keeps the same object and moves in place.
+*/
+@interface SGClusterAnnotation : NSObject <MKAnnotation> {
+
+    @private
+    CLLocationCoordinate2D coordinate;
+    NSArray* recordAnnotations;
+    
+    NSArray* pendingRecordAnnotations;
+    CLLocationCoordinate2D pendingCoordinate;
+}
+
+/*!
+* @property
+* @abstract The records that are in the cluster.
+*/
+@property (nonatomic, readonly) NSArray* recordAnnotations;
+
+/*!
+* @method count
+* @result The amount of records in the cluster.
+*/
+- (NSUInteger) count;
+
+/*!
+* @method updateRecordAnnotations:coordinate:
+* @abstract Replaces the records of the cluster.
+* @discussion Observers of the coordinate are notified if it moves.
+*/
+- (void) updateRecordAnnotations:(NSArray*)recordAnnotations coordinate:(CLLocationCoordinate2D)coordinate;
+
+/*!
+* @method setPendingRecordAnnotations:coordinate:
+* @abstract Stages new records for a cluster that may be on the map. Can be
+* called from any thread.
+*/
+- (void) setPendingRecordAnnotations:(NSArray*)recordAnnotations coordinate:(CLLocationCoordinate2D)coordinate;
+
+- (BOOL) hasPendingUpdate;
+
+/*!
+* @method applyPendingUpdate
+* @abstract Applies the staged records. Must be called on the main thread.
+*/
+- (void) applyPendingUpdate;
+
+@end
@@ -0,0 +1,107 @@
+//
+//  SGClusterAnnotation.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import "SGClusterAnnotation.h"
+
+@implementation SGClusterAnnotation
+@synthesize coordinate, recordAnnotations;
+
+- (NSUInteger) count
+{
+    return [recordAnnotations count];
+}
+
+- (NSString*) title
+{
+    return [NSString stringWithFormat:@"%lu records", (unsigned long)[recordAnnotations count]];
+}
+
+- (NSString*) subtitle
+{
+    return nil;
+}
+
+- (void) updateRecordAnnotations:(NSArray*)newRecordAnnotations coordinate:(CLLocationCoordinate2D)newCoordinate
+{
+    [newRecordAnnotations retain];
+    [recordAnnotations release];
+    recordAnnotations = newRecordAnnotations;
+    
+    if(newCoordinate.latitude != coordinate.latitude || newCoordinate.longitude != coordinate.longitude) {
+        [self willChangeValueForKey:@"coordinate"];
+        coordinate = newCoordinate;
+        [self didChangeValueForKey:@"coordinate"];
+    }
+}
+
+- (void) setPendingRecordAnnotations:(NSArray*)newRecordAnnotations coordinate:(CLLocationCoordinate2D)newCoordinate
+{
+    @synchronized(self) {
+        [newRecordAnnotations retain];
+        [pendingRecordAnnotations release];
+        pendingRecordAnnotations = newRecordAnnotations;
+        pendingCoordinate = newCoordinate;
+    }
+}
+
+- (BOOL) hasPendingUpdate
+{
+    @synchronized(self) {
+        return pendingRecordAnnotations != nil;
+    }
+}
+
+- (void) applyPendingUpdate
+{
+    NSArray* newRecordAnnotations = nil;
+    CLLocationCoordinate2D newCoordinate;
+    @synchronized(self) {
+        newRecordAnnotations = [pendingRecordAnnotations autorelease];
+        newCoordinate = pendingCoordinate;
+        pendingRecordAnnotations = nil;
+    }
+    
+    if(newRecordAnnotations)
+        [self updateRecordAnnotations:newRecordAnnotations coordinate:newCoordinate];
+}
+
+- (void) dealloc
+{
+    [pendingRecordAnnotations release];
+    [recordAnnotations release];
+    [super dealloc];
+}
+
+@end
@@ -0,0 +1,134 @@
+//
+//  SGClusterTree.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import <Foundation/Foundation.h>
+#import <MapKit/MapKit.h>
+
+#define kSGClusterTree_LevelCount           21
+
+typedef struct {
+
+    uint64_t code;
+    MKMapPoint point;
+    NSUInteger index;
+
+} SGClusterPoint;
+
+typedef struct {
+
+    uint64_t cell;
+    NSUInteger start;
+    NSUInteger count;
+    MKMapPoint centroid;
+
+} SGClusterNode;
+
+typedef struct {
+
+    SGClusterNode* nodes;
+    NSUInteger count;
+
+} SGClusterLevel;
+
+/*!
+* @class SGClusterTree
+* @abstract Groups records into clusters for every zoom level.
+* @discussion The tree is a hierarchical grid over the world in map points.
+* Level z splits the world into 2^z by 2^z cells, down to level 20. The
+* records are sorted once by the Morton code of their finest cell, so every
+* cell at every level is a contiguous run of records. A level is built with
+* one linear pass the first time it is used and kept afterwards.
+*
+* Asking for the clusters in a map rect only looks at the cells that are
+* visible, never at the whole layer. Cluster annotations are reused from one
+* call to the next, and from the tree that is passed in
+* @link initWithRecordAnnotations:previousTree: initWithRecordAnnotations:previousTree: @/link,
+* so a cluster that stays on screen keeps its annotation. The new members of
+* such a cluster are staged with
+* @link //simplegeo/ooc/instm/SGClusterAnnotation/setPendingRecordAnnotations:coordinate: setPendingRecordAnnotations:coordinate: @/link
+* so the tree can be used off the main thread.
+*/
+@interface SGClusterTree : NSObject {
+
+    @private
+    NSArray* recordAnnotations;
+    SGClusterPoint* points;
+    NSUInteger pointCount;
+    SGClusterLevel levels[kSGClusterTree_LevelCount];
+    
+    NSMutableDictionary* clusterAnnotations;
+    NSMutableSet* builtClusters;
+}
+
+/*!
+* @method initWithRecordAnnotations:previousTree:
+* @abstract Builds a tree for the records.
+* @param recordAnnotations The records.
+* @param previousTree The tree these records replace. Its cluster annotations
+* are handed over. Can be nil.
+*/
+- (id) initWithRecordAnnotations:(NSArray*)recordAnnotations previousTree:(SGClusterTree*)previousTree;
+
+/*!
+* @method initWithPreviousTree:insertedRecordAnnotations:removedRecordAnnotations:
+* @abstract Builds a tree from another one by adding and removing records.
+* @discussion Only the inserted records are projected and sorted; they are
+* merged with the sorted records that stay in one linear pass. The levels
+* are built again when they are first used, which is linear in the records
+* as well. The cluster annotations of the previous tree are handed over.
+* @param previousTree The tree to start from.
+* @param insertedRecordAnnotations The records to add.
+* @param removedRecordAnnotations The records to take out. They are matched
+* by identity with the records of the previous tree.
+*/
+- (id) initWithPreviousTree:(SGClusterTree*)previousTree
+  insertedRecordAnnotations:(NSArray*)insertedRecordAnnotations
+   removedRecordAnnotations:(NSArray*)removedRecordAnnotations;
+
+/*!
+* @method annotationsInMapRect:cellSize:maxCount:
+* @abstract Returns the clusters that are visible in a map rect.
+* @discussion The level is the finest one whose cells are at least cellSize
+* map points wide. If that shows more than maxCount annotations, coarser
+* levels are tried. A cell that holds a single record returns the record
+* itself.
+* @param mapRect The visible map rect.
+* @param cellSize The smallest cell width in map points.
+* @param maxCount The most annotations to return.
+* @result Records and @link //simplegeo/ooc/cl/SGClusterAnnotation SGClusterAnnotations @/link.
+*/
+- (NSArray*) annotationsInMapRect:(MKMapRect)mapRect cellSize:(double)cellSize maxCount:(NSUInteger)maxCount;
+
+@end
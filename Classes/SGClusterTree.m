@@ -0,0 +1,341 @@
+//
+//  SGClusterTree.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import "SGClusterTree.h"
+#import "SGClusterAnnotation.h"
+#import "SGGeohashCode.h"
+
+#define kSGClusterTree_FinestLevel          (kSGClusterTree_LevelCount - 1)
+
+static void SGClusterPointSet(SGClusterPoint* point, id<MKAnnotation> annotation, NSUInteger index);
+static int SGCompareClusterPoints(const void* one, const void* two);
+
+@interface SGClusterTree (Private)
+
+- (SGClusterLevel*) level:(int)level;
+- (SGClusterNode*) nodeForCell:(uint64_t)cell level:(int)level;
+- (void) appendNodesInMapRect:(MKMapRect)mapRect level:(int)level toBuffer:(SGClusterNode**)buffer count:(NSUInteger*)count max:(NSUInteger)max;
+- (id<MKAnnotation>) annotationForNode:(SGClusterNode*)node level:(int)level previous:(NSDictionary*)previousClusterAnnotations;
+
+@end
+
+@implementation SGClusterTree
+
+- (id) initWithRecordAnnotations:(NSArray*)annotations previousTree:(SGClusterTree*)previousTree
+{
+    if(self = [super init]) {
+        recordAnnotations = [annotations retain];
+        pointCount = [recordAnnotations count];
+        points = malloc(sizeof(SGClusterPoint) * MAX(pointCount, 1));
+        memset(levels, 0, sizeof(levels));
+        
+        if(previousTree)
+            clusterAnnotations = [previousTree->clusterAnnotations retain];
+        else
+            clusterAnnotations = [[NSMutableDictionary alloc] init];
+        
+        builtClusters = [[NSMutableSet alloc] init];
+        
+        NSUInteger index = 0;
+        for(id<MKAnnotation> annotation in recordAnnotations) {
+            SGClusterPointSet(&points[index], annotation, index);
+            index++;
+        }
+        
+        qsort(points, pointCount, sizeof(SGClusterPoint), SGCompareClusterPoints);
+    }
+    
+    return self;
+}
+
+- (id) initWithPreviousTree:(SGClusterTree*)previousTree
+  insertedRecordAnnotations:(NSArray*)insertedRecordAnnotations
+   removedRecordAnnotations:(NSArray*)removedRecordAnnotations
+{
+    if(self = [super init]) {
+        // Removed records are matched by identity, without hashing or
+        // retaining them.
+        CFMutableSetRef removed = CFSetCreateMutable(NULL, [removedRecordAnnotations count], NULL);
+        for(id recordAnnotation in removedRecordAnnotations)
+            CFSetAddValue(removed, recordAnnotation);
+        
+        // The records that stay keep their order, so their points only have
+        // to be renumbered.
+        NSArray* previousRecordAnnotations = previousTree->recordAnnotations;
+        NSUInteger previousCount = previousTree->pointCount;
+        NSUInteger insertedCount = [insertedRecordAnnotations count];
+        NSMutableArray* annotations = [[NSMutableArray alloc] initWithCapacity:previousCount + insertedCount];
+        NSUInteger* newIndexes = malloc(sizeof(NSUInteger) * MAX(previousCount, 1));
+        for(NSUInteger i = 0; i < previousCount; i++) {
+            id recordAnnotation = [previousRecordAnnotations objectAtIndex:i];
+            if(CFSetContainsValue(removed, recordAnnotation))
+                newIndexes[i] = NSNotFound;
+            else {
+                newIndexes[i] = [annotations count];
+                [annotations addObject:recordAnnotation];
+            }
+        }
+        
+        CFRelease(removed);
+        
+        // Only the inserted records are projected and sorted. Both runs are
+        // then merged by their codes.
+        NSUInteger keptCount = [annotations count];
+        SGClusterPoint* insertedPoints = malloc(sizeof(SGClusterPoint) * MAX(insertedCount, 1));
+        for(NSUInteger i = 0; i < insertedCount; i++) {
+            id<MKAnnotation> annotation = [insertedRecordAnnotations objectAtIndex:i];
+            SGClusterPointSet(&insertedPoints[i], annotation, keptCount + i);
+            [annotations addObject:annotation];
+        }
+        
+        qsort(insertedPoints, insertedCount, sizeof(SGClusterPoint), SGCompareClusterPoints);
+        
+        recordAnnotations = annotations;
+        pointCount = keptCount + insertedCount;
+        points = malloc(sizeof(SGClusterPoint) * MAX(pointCount, 1));
+        memset(levels, 0, sizeof(levels));
+        
+        NSUInteger previousIndex = 0, insertedIndex = 0, count = 0;
+        while(count < pointCount) {
+            while(previousIndex < previousCount && newIndexes[previousTree->points[previousIndex].index] == NSNotFound)
+                previousIndex++;
+            
+            if(previousIndex < previousCount &&
+               (insertedIndex == insertedCount || previousTree->points[previousIndex].code <= insertedPoints[insertedIndex].code)) {
+                points[count] = previousTree->points[previousIndex++];
+                points[count].index = newIndexes[points[count].index];
+            } else
+                points[count] = insertedPoints[insertedIndex++];
+            
+            count++;
+        }
+        
+        free(insertedPoints);
+        free(newIndexes);
+        
+        clusterAnnotations = [previousTree->clusterAnnotations retain];
+        builtClusters = [[NSMutableSet alloc] init];
+    }
+    
+    return self;
+}
+
+- (NSArray*) annotationsInMapRect:(MKMapRect)mapRect cellSize:(double)cellSize maxCount:(NSUInteger)maxCount
+{
+    if(!pointCount || !maxCount)
+        return [NSArray array];
+    
+    int level = kSGClusterTree_FinestLevel;
+    while(level > 0 && MKMapSizeWorld.width / (double)(1 << level) < cellSize)
+        level--;
+    
+    // Coarser levels never show more clusters for the same rect, so step up
+    // until the result fits.
+    SGClusterNode** buffer = malloc(sizeof(SGClusterNode*) * maxCount);
+    NSUInteger count = 0;
+    for(; level >= 0; level--) {
+        count = 0;
+        [self appendNodesInMapRect:mapRect level:level toBuffer:buffer count:&count max:maxCount + 1];
+        if(count <= maxCount)
+            break;
+    }
+    
+    // Clusters that went out of view are dropped so the cache only holds
+    // what is on screen.
+    NSMutableDictionary* previousClusterAnnotations = clusterAnnotations;
+    clusterAnnotations = [[NSMutableDictionary alloc] initWithCapacity:count];
+    
+    NSMutableArray* annotations = [NSMutableArray arrayWithCapacity:count];
+    for(NSUInteger i = 0; i < count; i++)
+        [annotations addObject:[self annotationForNode:buffer[i] level:level previous:previousClusterAnnotations]];
+    
+    [previousClusterAnnotations release];
+    free(buffer);
+    
+    return annotations;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Levels 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (SGClusterLevel*) level:(int)level
+{
+    SGClusterLevel* clusterLevel = &levels[level];
+    if(clusterLevel->nodes)
+        return clusterLevel;
+    
+    int shift = 2 * (kSGClusterTree_FinestLevel - level);
+    clusterLevel->nodes = malloc(sizeof(SGClusterNode) * pointCount);
+    clusterLevel->count = 0;
+    
+    SGClusterNode* node = NULL;
+    for(NSUInteger i = 0; i < pointCount; i++) {
+        uint64_t cell = points[i].code >> shift;
+        if(!node || node->cell != cell) {
+            if(node) {
+                node->centroid.x /= (double)node->count;
+                node->centroid.y /= (double)node->count;
+            }
+            
+            node = &clusterLevel->nodes[clusterLevel->count++];
+            node->cell = cell;
+            node->start = i;
+            node->count = 0;
+            node->centroid = MKMapPointMake(0.0, 0.0);
+        }
+        
+        node->count++;
+        node->centroid.x += points[i].point.x;
+        node->centroid.y += points[i].point.y;
+    }
+    
+    if(node) {
+        node->centroid.x /= (double)node->count;
+        node->centroid.y /= (double)node->count;
+    }
+    
+    clusterLevel->nodes = realloc(clusterLevel->nodes, sizeof(SGClusterNode) * MAX(clusterLevel->count, 1));
+    return clusterLevel;
+}
+
+- (SGClusterNode*) nodeForCell:(uint64_t)cell level:(int)level
+{
+    SGClusterLevel* clusterLevel = [self level:level];
+    NSUInteger low = 0, high = clusterLevel->count;
+    while(low < high) {
+        NSUInteger middle = (low + high) / 2;
+        if(clusterLevel->nodes[middle].cell < cell)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    
+    return low < clusterLevel->count && clusterLevel->nodes[low].cell == cell ? &clusterLevel->nodes[low] : NULL;
+}
+
+- (void) appendNodesInMapRect:(MKMapRect)mapRect level:(int)level toBuffer:(SGClusterNode**)buffer count:(NSUInteger*)count max:(NSUInteger)max
+{
+    long cells = 1L << level;
+    double cellWidth = MKMapSizeWorld.width / (double)cells;
+    
+    // A rect that crosses the antimeridian extends past the world width; its
+    // columns wrap around.
+    long firstColumn = (long)floor(MKMapRectGetMinX(mapRect) / cellWidth);
+    long columns = MIN((long)floor(MKMapRectGetMaxX(mapRect) / cellWidth) - firstColumn + 1, cells);
+    long firstRow = MAX((long)floor(MKMapRectGetMinY(mapRect) / cellWidth), 0L);
+    long lastRow = MIN((long)floor(MKMapRectGetMaxY(mapRect) / cellWidth), cells - 1);
+    
+    for(long row = firstRow; row <= lastRow; row++)
+        for(long column = firstColumn; column < firstColumn + columns; column++) {
+            long wrappedColumn = ((column % cells) + cells) % cells;
+            SGClusterNode* node = [self nodeForCell:SGGeohashSpreadBits((uint32_t)wrappedColumn) | (SGGeohashSpreadBits((uint32_t)row) << 1)
+                                              level:level];
+            if(node) {
+                if(*count < max - 1)
+                    buffer[*count] = node;
+                
+                (*count)++;
+                if(*count >= max)
+                    return;
+            }
+        }
+}
+
+- (id<MKAnnotation>) annotationForNode:(SGClusterNode*)node level:(int)level previous:(NSDictionary*)previousClusterAnnotations
+{
+    if(node->count == 1)
+        return [recordAnnotations objectAtIndex:points[node->start].index];
+    
+    NSNumber* key = [NSNumber numberWithUnsignedLongLong:((uint64_t)level << 48) | node->cell];
+    SGClusterAnnotation* clusterAnnotation = [previousClusterAnnotations objectForKey:key];
+    BOOL reused = clusterAnnotation != nil;
+    if(!reused)
+        clusterAnnotation = [[[SGClusterAnnotation alloc] init] autorelease];
+    
+    [clusterAnnotations setObject:clusterAnnotation forKey:key];
+    
+    // The members only have to be collected once per tree. A cluster that was
+    // handed out before may be on the map, so its update is only staged.
+    if(![builtClusters containsObject:key]) {
+        NSMutableArray* members = [NSMutableArray arrayWithCapacity:node->count];
+        for(NSUInteger i = node->start; i < node->start + node->count; i++)
+            [members addObject:[recordAnnotations objectAtIndex:points[i].index]];
+        
+        if(reused)
+            [clusterAnnotation setPendingRecordAnnotations:members coordinate:MKCoordinateForMapPoint(node->centroid)];
+        else
+            [clusterAnnotation updateRecordAnnotations:members coordinate:MKCoordinateForMapPoint(node->centroid)];
+        
+        [builtClusters addObject:key];
+    }
+    
+    return clusterAnnotation;
+}
+
+- (void) dealloc
+{
+    for(int i = 0; i < kSGClusterTree_LevelCount; i++)
+        free(levels[i].nodes);
+    
+    free(points);
+    [recordAnnotations release];
+    [clusterAnnotations release];
+    [builtClusters release];
+    
+    [super dealloc];
+}
+
+@end
+
+static void SGClusterPointSet(SGClusterPoint* point, id<MKAnnotation> annotation, NSUInteger index)
+{
+    double cellWidth = MKMapSizeWorld.width / (double)(1 << kSGClusterTree_FinestLevel);
+    uint32_t maxCell = (1 << kSGClusterTree_FinestLevel) - 1;
+    point->point = MKMapPointForCoordinate(annotation.coordinate);
+    point->index = index;
+    
+    uint32_t x = (uint32_t)MIN(MAX(point->point.x / cellWidth, 0.0), (double)maxCell);
+    uint32_t y = (uint32_t)MIN(MAX(point->point.y / cellWidth, 0.0), (double)maxCell);
+    point->code = SGGeohashSpreadBits(x) | (SGGeohashSpreadBits(y) << 1);
+}
+
+static int SGCompareClusterPoints(const void* one, const void* two)
+{
+    uint64_t codeOne = ((const SGClusterPoint*)one)->code;
+    uint64_t codeTwo = ((const SGClusterPoint*)two)->code;
+    return codeOne < codeTwo ? -1 : (codeOne > codeTwo ? 1 : 0);
+}
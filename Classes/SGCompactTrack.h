@@ -0,0 +1,154 @@
+//
+//  SGCompactTrack.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+
+#import <Foundation/Foundation.h>
+#import <MapKit/MapKit.h>
+
+#define kSGCompactTrack_ChunkSize           256
+#define kSGCompactTrack_PointScale          4.0
+#define kSGCompactTrack_TimeScale           1000.0
+
+typedef struct {
+
+    NSUInteger offset;
+    int64_t x;
+    int64_t y;
+    int64_t time;
+    int64_t minX;
+    int64_t minY;
+    int64_t maxX;
+    int64_t maxY;
+
+} SGCompactTrackChunk;
+
+/*!
+* @class SGCompactTrack
+* @abstract Keeps the map points and times of a track in a few bytes each.
+* @discussion Map points are rounded to a
+* @link kSGCompactTrack_PointScale kSGCompactTrack_PointScale @/link th of a
+* map point, about 4 cm at the equator, and times to a millisecond. Every
+* point after the first of a chunk of
+* @link kSGCompactTrack_ChunkSize kSGCompactTrack_ChunkSize @/link is stored
+* as the difference to the point before it, zigzag and varint encoded, so
+* the points of a track a few meters apart take 5 to 8 bytes instead of 24.
+*
+* A chunk keeps its first point and its bounds, so decoding can start at any
+* chunk and whole chunks can be skipped. Decoding is a pass of integer
+* additions straight into the caller's buffer.
+*
+* A track is not thread safe. Points can only be appended.
+*/
+@interface SGCompactTrack : NSObject {
+
+    @private
+    SGCompactTrackChunk* chunks;
+    NSUInteger chunkCount;
+    NSUInteger chunkSpace;
+    
+    uint8_t* bytes;
+    NSUInteger byteCount;
+    NSUInteger byteSpace;
+    
+    NSUInteger count;
+    int64_t lastX;
+    int64_t lastY;
+    int64_t lastTime;
+}
+
+/*!
+* @property
+* @abstract The amount of points.
+*/
+@property (nonatomic, readonly) NSUInteger count;
+
+/*!
+* @property
+* @abstract The size of the encoded points, in bytes.
+*/
+@property (nonatomic, readonly) NSUInteger byteCount;
+
+/*!
+* @method addMapPoints:times:count:
+* @abstract Appends points.
+* @param times The times of the points. If NULL, every point gets the time of
+* the last point of the track.
+*/
+- (void) addMapPoints:(const MKMapPoint*)mapPoints times:(const NSTimeInterval*)times count:(NSUInteger)count;
+
+/*!
+* @method getMapPoints:times:range:
+* @abstract Decodes a range of points.
+* @param mapPoints Receives the points. Can be NULL.
+* @param times Receives the times. Can be NULL.
+* @param range The points to decode.
+*/
+- (void) getMapPoints:(MKMapPoint*)mapPoints times:(NSTimeInterval*)times range:(NSRange)range;
+
+/*!
+* @method getMapPoints:atIndexes:count:
+* @abstract Decodes the points at some indexes.
+* @discussion Only the chunks with an index in them are decoded.
+* @param mapPoints Receives the points.
+* @param indexes The indexes of the points in ascending order.
+* @param count The amount of indexes.
+*/
+- (void) getMapPoints:(MKMapPoint*)mapPoints atIndexes:(const uint32_t*)indexes count:(NSUInteger)count;
+
+/*!
+* @method mapRectForRange:
+* @abstract Finds the bounds of a range of points.
+* @discussion Chunks that are inside the range are not decoded.
+* @result The bounds, or MKMapRectNull if the range is empty.
+*/
+- (MKMapRect) mapRectForRange:(NSRange)range;
+
+/*!
+* @method firstIndexBeforeTime:inclusive:
+* @abstract Finds where a time would go in a track whose times decrease.
+* @param time The time.
+* @param inclusive Stop at a point with the same time.
+* @result The index of the first point older than the time, or at the same
+* time if inclusive is YES. The amount of points if there is none.
+*/
+- (NSUInteger) firstIndexBeforeTime:(NSTimeInterval)time inclusive:(BOOL)inclusive;
+
+/*!
+* @method removeAllPoints
+* @abstract Empties the track.
+*/
+- (void) removeAllPoints;
+
+@end
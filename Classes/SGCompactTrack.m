@@ -0,0 +1,321 @@
+//
+//  SGCompactTrack.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+
+#import "SGCompactTrack.h"
+#import "SGBoundingBox.h"
+
+typedef struct {
+
+    int64_t x;
+    int64_t y;
+    int64_t time;
+
+} SGCompactTrackPoint;
+
+@interface SGCompactTrack (Private)
+
+- (void) reserveBytes:(NSUInteger)extraByteCount;
+
+@end
+
+static inline NSUInteger SGEncodeDelta(uint8_t* p, int64_t delta);
+static inline const uint8_t* SGDecodeDelta(const uint8_t* p, int64_t* delta);
+static inline const uint8_t* SGDecodePoint(const uint8_t* p, SGCompactTrackPoint* point);
+static inline SGCompactTrackPoint SGChunkStart(const SGCompactTrackChunk* chunk);
+static inline MKMapPoint SGMapPointForTrackPoint(SGCompactTrackPoint point);
+
+@implementation SGCompactTrack
+@synthesize count, byteCount;
+
+- (id) init
+{
+    if(self = [super init]) {
+        chunks = NULL;
+        chunkCount = 0;
+        chunkSpace = 0;
+        
+        bytes = NULL;
+        byteCount = 0;
+        byteSpace = 0;
+        
+        count = 0;
+        lastX = 0;
+        lastY = 0;
+        lastTime = 0;
+    }
+    
+    return self;
+}
+
+- (void) addMapPoints:(const MKMapPoint*)mapPoints times:(const NSTimeInterval*)times count:(NSUInteger)newCount
+{
+    // A delta takes at most 10 bytes.
+    [self reserveBytes:newCount * 30];
+    
+    for(NSUInteger i = 0; i < newCount; i++) {
+        int64_t x = llround(mapPoints[i].x * kSGCompactTrack_PointScale);
+        int64_t y = llround(mapPoints[i].y * kSGCompactTrack_PointScale);
+        int64_t time = times ? llround(times[i] * kSGCompactTrack_TimeScale) : lastTime;
+        
+        if(!(count % kSGCompactTrack_ChunkSize)) {
+            if(chunkCount == chunkSpace) {
+                chunkSpace = MAX(chunkSpace * 2, 4);
+                chunks = realloc(chunks, sizeof(SGCompactTrackChunk) * chunkSpace);
+            }
+            
+            SGCompactTrackChunk* chunk = &chunks[chunkCount++];
+            chunk->offset = byteCount;
+            chunk->x = chunk->minX = chunk->maxX = x;
+            chunk->y = chunk->minY = chunk->maxY = y;
+            chunk->time = time;
+        } else {
+            SGCompactTrackChunk* chunk = &chunks[chunkCount - 1];
+            byteCount += SGEncodeDelta(bytes + byteCount, x - lastX);
+            byteCount += SGEncodeDelta(bytes + byteCount, y - lastY);
+            byteCount += SGEncodeDelta(bytes + byteCount, time - lastTime);
+            chunk->minX = MIN(chunk->minX, x);
+            chunk->minY = MIN(chunk->minY, y);
+            chunk->maxX = MAX(chunk->maxX, x);
+            chunk->maxY = MAX(chunk->maxY, y);
+        }
+        
+        lastX = x;
+        lastY = y;
+        lastTime = time;
+        count++;
+    }
+}
+
+- (void) getMapPoints:(MKMapPoint*)mapPoints times:(NSTimeInterval*)times range:(NSRange)range
+{
+    NSUInteger end = MIN(NSMaxRange(range), count);
+    NSUInteger i = range.location;
+    while(i < end) {
+        // Every chunk is decoded from its first point up to the range.
+        NSUInteger chunkIndex = i / kSGCompactTrack_ChunkSize;
+        NSUInteger chunkEnd = MIN((chunkIndex + 1) * kSGCompactTrack_ChunkSize, end);
+        SGCompactTrackPoint point = SGChunkStart(&chunks[chunkIndex]);
+        const uint8_t* p = bytes + chunks[chunkIndex].offset;
+        for(NSUInteger j = chunkIndex * kSGCompactTrack_ChunkSize; j < chunkEnd; j++) {
+            if(j > chunkIndex * kSGCompactTrack_ChunkSize)
+                p = SGDecodePoint(p, &point);
+            
+            if(j >= i) {
+                if(mapPoints)
+                    mapPoints[j - range.location] = SGMapPointForTrackPoint(point);
+                
+                if(times)
+                    times[j - range.location] = point.time / kSGCompactTrack_TimeScale;
+            }
+        }
+        
+        i = chunkEnd;
+    }
+}
+
+- (void) getMapPoints:(MKMapPoint*)mapPoints atIndexes:(const uint32_t*)indexes count:(NSUInteger)indexCount
+{
+    NSUInteger i = 0;
+    while(i < indexCount) {
+        NSUInteger chunkIndex = indexes[i] / kSGCompactTrack_ChunkSize;
+        NSUInteger j = chunkIndex * kSGCompactTrack_ChunkSize;
+        SGCompactTrackPoint point = SGChunkStart(&chunks[chunkIndex]);
+        const uint8_t* p = bytes + chunks[chunkIndex].offset;
+        for(; i < indexCount && indexes[i] / kSGCompactTrack_ChunkSize == chunkIndex; i++) {
+            for(; j < indexes[i]; j++)
+                p = SGDecodePoint(p, &point);
+            
+            mapPoints[i] = SGMapPointForTrackPoint(point);
+        }
+    }
+}
+
+- (MKMapRect) mapRectForRange:(NSRange)range
+{
+    NSUInteger end = MIN(NSMaxRange(range), count);
+    if(range.location >= end)
+        return MKMapRectNull;
+    
+    // The chunks between the ends are read from their bounds. The parts of
+    // the chunks at the ends are decoded and reduced together.
+    int64_t minX = INT64_MAX;
+    int64_t minY = INT64_MAX;
+    int64_t maxX = INT64_MIN;
+    int64_t maxY = INT64_MIN;
+    MKMapPoint edgePoints[2 * kSGCompactTrack_ChunkSize];
+    NSUInteger edgeCount = 0;
+    NSUInteger i = range.location;
+    while(i < end) {
+        NSUInteger chunkIndex = i / kSGCompactTrack_ChunkSize;
+        NSUInteger chunkStart = chunkIndex * kSGCompactTrack_ChunkSize;
+        NSUInteger chunkEnd = MIN(chunkStart + kSGCompactTrack_ChunkSize, count);
+        const SGCompactTrackChunk* chunk = &chunks[chunkIndex];
+        if(i == chunkStart && end >= chunkEnd) {
+            minX = MIN(minX, chunk->minX);
+            minY = MIN(minY, chunk->minY);
+            maxX = MAX(maxX, chunk->maxX);
+            maxY = MAX(maxY, chunk->maxY);
+            i = chunkEnd;
+            continue;
+        }
+        
+        chunkEnd = MIN(chunkEnd, end);
+        [self getMapPoints:edgePoints + edgeCount times:NULL range:NSMakeRange(i, chunkEnd - i)];
+        edgeCount += chunkEnd - i;
+        i = chunkEnd;
+    }
+    
+    MKMapRect mapRect = MKMapRectNull;
+    if(minX <= maxX)
+        mapRect = MKMapRectMake(minX / kSGCompactTrack_PointScale, minY / kSGCompactTrack_PointScale,
+                                (maxX - minX) / kSGCompactTrack_PointScale, (maxY - minY) / kSGCompactTrack_PointScale);
+    
+    return SGMapRectExtendWithMapPoints(mapRect, edgePoints, edgeCount);
+}
+
+- (NSUInteger) firstIndexBeforeTime:(NSTimeInterval)time inclusive:(BOOL)inclusive
+{
+    // The chunk the index is in is found from the first times of the chunks
+    // and only that one is decoded.
+    NSUInteger low = 0;
+    NSUInteger high = chunkCount;
+    while(low < high) {
+        NSUInteger middle = low + (high - low) / 2;
+        double chunkTime = chunks[middle].time / kSGCompactTrack_TimeScale;
+        if(inclusive ? chunkTime <= time : chunkTime < time)
+            high = middle;
+        else
+            low = middle + 1;
+    }
+    
+    if(!low)
+        return 0;
+    
+    NSUInteger chunkStart = (low - 1) * kSGCompactTrack_ChunkSize;
+    NSUInteger chunkEnd = MIN(chunkStart + kSGCompactTrack_ChunkSize, count);
+    SGCompactTrackPoint point = SGChunkStart(&chunks[low - 1]);
+    const uint8_t* p = bytes + chunks[low - 1].offset;
+    for(NSUInteger j = chunkStart + 1; j < chunkEnd; j++) {
+        p = SGDecodePoint(p, &point);
+        double pointTime = point.time / kSGCompactTrack_TimeScale;
+        if(inclusive ? pointTime <= time : pointTime < time)
+            return j;
+    }
+    
+    return chunkEnd;
+}
+
+- (void) removeAllPoints
+{
+    chunkCount = 0;
+    byteCount = 0;
+    count = 0;
+    lastX = 0;
+    lastY = 0;
+    lastTime = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Utility methods 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (void) reserveBytes:(NSUInteger)extraByteCount
+{
+    if(byteCount + extraByteCount > byteSpace) {
+        byteSpace = MAX(byteSpace * 2, byteCount + extraByteCount);
+        bytes = realloc(bytes, byteSpace);
+    }
+}
+
+- (void) dealloc
+{
+    free(chunks);
+    free(bytes);
+    
+    [super dealloc];
+}
+
+@end
+
+static inline NSUInteger SGEncodeDelta(uint8_t* p, int64_t delta)
+{
+    // Zigzag puts small negative deltas next to small positive ones, so both
+    // take few bytes.
+    uint64_t value = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+    NSUInteger length = 0;
+    while(value >= 0x80) {
+        p[length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    
+    p[length++] = (uint8_t)value;
+    return length;
+}
+
+static inline const uint8_t* SGDecodeDelta(const uint8_t* p, int64_t* delta)
+{
+    uint64_t value = *p & 0x7f;
+    for(int shift = 7; *p++ & 0x80; shift += 7)
+        value |= (uint64_t)(*p & 0x7f) << shift;
+    
+    *delta = (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+    return p;
+}
+
+static inline const uint8_t* SGDecodePoint(const uint8_t* p, SGCompactTrackPoint* point)
+{
+    int64_t delta;
+    p = SGDecodeDelta(p, &delta);
+    point->x += delta;
+    p = SGDecodeDelta(p, &delta);
+    point->y += delta;
+    p = SGDecodeDelta(p, &delta);
+    point->time += delta;
+    
+    return p;
+}
+
+static inline SGCompactTrackPoint SGChunkStart(const SGCompactTrackChunk* chunk)
+{
+    SGCompactTrackPoint point = {chunk->x, chunk->y, chunk->time};
+    return point;
+}
+
+static inline MKMapPoint SGMapPointForTrackPoint(SGCompactTrackPoint point)
+{
+    return MKMapPointMake(point.x / kSGCompactTrack_PointScale, point.y / kSGCompactTrack_PointScale);
+}
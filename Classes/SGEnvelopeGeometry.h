@@ -0,0 +1,119 @@
+//
+//  SGEnvelopeGeometry.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import <Foundation/Foundation.h>
+#import <CoreLocation/CoreLocation.h>
+
+/*
+* Longitudes are between -180 and 180. An envelope whose west is greater
+* than its east crosses the antimeridian. An envelope from -180 to 180 covers
+* every longitude.
+*/
+
+/*!
+* @function SGEnvelopeCrossesAntimeridian(SGEnvelope)
+* @result YES if the west of the envelope is greater than its east.
+*/
+extern BOOL SGEnvelopeCrossesAntimeridian(SGEnvelope envelope);
+
+/*!
+* @function SGEnvelopeSplitAtAntimeridian(SGEnvelope, SGEnvelope*)
+* @abstract Splits an envelope into parts that do not cross the antimeridian.
+* @param pieces Has room for 2 envelopes.
+* @result The amount of pieces, 1 or 2.
+*/
+extern NSUInteger SGEnvelopeSplitAtAntimeridian(SGEnvelope envelope, SGEnvelope* pieces);
+
+/*!
+* @function SGEnvelopeContainsCoordinate(SGEnvelope, CLLocationCoordinate2D)
+* @result YES if the coordinate is inside or on the edge of the envelope.
+*/
+extern BOOL SGEnvelopeContainsCoordinate(SGEnvelope envelope, CLLocationCoordinate2D coordinate);
+
+/*!
+* @function SGEnvelopeContainsEnvelope(SGEnvelope, SGEnvelope)
+* @result YES if the other envelope is inside the envelope.
+*/
+extern BOOL SGEnvelopeContainsEnvelope(SGEnvelope envelope, SGEnvelope otherEnvelope);
+
+/*!
+* @function SGEnvelopeIntersectsEnvelope(SGEnvelope, SGEnvelope)
+* @result YES if the envelopes share any point, including their edges.
+*/
+extern BOOL SGEnvelopeIntersectsEnvelope(SGEnvelope envelope, SGEnvelope otherEnvelope);
+
+/*!
+* @function SGEnvelopeIntersection(SGEnvelope, SGEnvelope, SGEnvelope*)
+* @abstract Finds the area two envelopes share.
+* @discussion Two envelopes can share two separate areas, for example when one
+* crosses the antimeridian and the other one is almost as wide as the world.
+* @param pieces Has room for 2 envelopes.
+* @result The amount of pieces, from 0 to 2.
+*/
+extern NSUInteger SGEnvelopeIntersection(SGEnvelope envelope, SGEnvelope otherEnvelope, SGEnvelope* pieces);
+
+/*!
+* @function SGEnvelopeUnion(SGEnvelope, SGEnvelope)
+* @result The smallest envelope that contains both envelopes. It crosses the
+* antimeridian if that is shorter.
+*/
+extern SGEnvelope SGEnvelopeUnion(SGEnvelope envelope, SGEnvelope otherEnvelope);
+
+/*!
+* @function SGEnvelopeExpandToCoordinate(SGEnvelope, CLLocationCoordinate2D)
+* @result The smallest envelope that contains the envelope and the coordinate.
+*/
+extern SGEnvelope SGEnvelopeExpandToCoordinate(SGEnvelope envelope, CLLocationCoordinate2D coordinate);
+
+/*!
+* @function SGEnvelopeExpandByDegrees(SGEnvelope, CLLocationDegrees, CLLocationDegrees)
+* @abstract Grows an envelope on every side. Latitudes stop at the poles.
+*/
+extern SGEnvelope SGEnvelopeExpandByDegrees(SGEnvelope envelope, CLLocationDegrees latitudeDelta, CLLocationDegrees longitudeDelta);
+
+/*!
+* @function SGEnvelopeFilterCoordinates(SGEnvelope, const double*, const double*, NSUInteger, uint32_t*)
+* @abstract Selects the coordinates inside an envelope.
+* @discussion The coordinates are compared several at a time with AVX, SSE2
+* or NEON, whichever the build targets, and one at a time otherwise.
+* Coordinates that are NaN are never selected.
+* @param latitudes The latitudes.
+* @param longitudes The longitudes.
+* @param count The amount of coordinates.
+* @param selection Receives the indexes of the selected coordinates in
+* ascending order. Has room for count indexes.
+* @result The amount of selected coordinates.
+*/
+extern NSUInteger SGEnvelopeFilterCoordinates(SGEnvelope envelope, const double* latitudes, const double* longitudes, NSUInteger count, uint32_t* selection);
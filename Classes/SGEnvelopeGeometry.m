@@ -0,0 +1,347 @@
+//
+//  SGEnvelopeGeometry.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import "SGEnvelopeGeometry.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif (defined(__ARM_NEON__) || defined(__ARM_NEON)) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+static double SGUnwrappedEast(SGEnvelope envelope);
+static BOOL SGPieceContainsLongitudes(SGEnvelope piece, double west, double east);
+static SGEnvelope SGEnvelopeMakeUnwrapped(double south, double west, double north, double east);
+
+BOOL SGEnvelopeCrossesAntimeridian(SGEnvelope envelope)
+{
+    return envelope.west > envelope.east;
+}
+
+NSUInteger SGEnvelopeSplitAtAntimeridian(SGEnvelope envelope, SGEnvelope* pieces)
+{
+    if(!SGEnvelopeCrossesAntimeridian(envelope)) {
+        pieces[0] = envelope;
+        return 1;
+    }
+    
+    pieces[0] = SGEnvelopeMake(envelope.south, envelope.west, envelope.north, 180.0);
+    pieces[1] = SGEnvelopeMake(envelope.south, -180.0, envelope.north, envelope.east);
+    return 2;
+}
+
+BOOL SGEnvelopeContainsCoordinate(SGEnvelope envelope, CLLocationCoordinate2D coordinate)
+{
+    if(!(coordinate.latitude >= envelope.south && coordinate.latitude <= envelope.north))
+        return NO;
+    
+    SGEnvelope pieces[2];
+    NSUInteger count = SGEnvelopeSplitAtAntimeridian(envelope, pieces);
+    for(NSUInteger i = 0; i < count; i++)
+        if(SGPieceContainsLongitudes(pieces[i], coordinate.longitude, coordinate.longitude))
+            return YES;
+    
+    return NO;
+}
+
+BOOL SGEnvelopeContainsEnvelope(SGEnvelope envelope, SGEnvelope otherEnvelope)
+{
+    if(otherEnvelope.south < envelope.south || otherEnvelope.north > envelope.north)
+        return NO;
+    
+    // The pieces are compared without moving them by a turn, which could
+    // round the edges.
+    SGEnvelope pieces[2], otherPieces[2];
+    NSUInteger count = SGEnvelopeSplitAtAntimeridian(envelope, pieces);
+    NSUInteger otherCount = SGEnvelopeSplitAtAntimeridian(otherEnvelope, otherPieces);
+    for(NSUInteger i = 0; i < otherCount; i++) {
+        BOOL contains = NO;
+        for(NSUInteger j = 0; j < count && !contains; j++)
+            contains = SGPieceContainsLongitudes(pieces[j], otherPieces[i].west, otherPieces[i].east);
+        
+        if(!contains)
+            return NO;
+    }
+    
+    return YES;
+}
+
+BOOL SGEnvelopeIntersectsEnvelope(SGEnvelope envelope, SGEnvelope otherEnvelope)
+{
+    SGEnvelope pieces[2];
+    return SGEnvelopeIntersection(envelope, otherEnvelope, pieces) > 0;
+}
+
+NSUInteger SGEnvelopeIntersection(SGEnvelope envelope, SGEnvelope otherEnvelope, SGEnvelope* pieces)
+{
+    double south = MAX(envelope.south, otherEnvelope.south);
+    double north = MIN(envelope.north, otherEnvelope.north);
+    if(south > north)
+        return 0;
+    
+    // The other envelope is moved by a turn in both directions and each copy
+    // is overlapped with the envelope. The edges are taken from the envelopes
+    // as they are, so the pieces are exact.
+    double east = SGUnwrappedEast(envelope);
+    double otherEast = SGUnwrappedEast(otherEnvelope);
+    SGEnvelope overlaps[3];
+    NSUInteger overlapCount = 0;
+    for(int i = -1; i <= 1; i++) {
+        BOOL westFromOther = otherEnvelope.west + 360.0 * i > envelope.west;
+        BOOL eastFromOther = otherEast + 360.0 * i < east;
+        double west = westFromOther ? otherEnvelope.west + 360.0 * i : envelope.west;
+        double overlapEast = eastFromOther ? otherEast + 360.0 * i : east;
+        if(west > overlapEast)
+            continue;
+        
+        // A copy that only touches the envelope shares one meridian.
+        if(west == overlapEast)
+            overlaps[overlapCount++] = SGEnvelopeMakeUnwrapped(south, west, north, west);
+        else
+            overlaps[overlapCount++] = SGEnvelopeMake(south, westFromOther ? otherEnvelope.west : envelope.west,
+                                                      north, eastFromOther ? otherEnvelope.east : envelope.east);
+    }
+    
+    // A meridian that is part of another piece, or the same as an earlier
+    // one, is dropped. Two pieces that meet at the antimeridian are one
+    // envelope across it.
+    NSUInteger pieceCount = 0;
+    for(NSUInteger i = 0; i < overlapCount; i++) {
+        BOOL contained = NO;
+        for(NSUInteger j = 0; j < overlapCount && overlaps[i].west == overlaps[i].east && !contained; j++)
+            contained = (j < i || overlaps[j].west != overlaps[j].east) && j != i && SGEnvelopeContainsEnvelope(overlaps[j], overlaps[i]);
+        
+        if(!contained)
+            overlaps[pieceCount++] = overlaps[i];
+    }
+    
+    if(pieceCount == 2 && !SGEnvelopeCrossesAntimeridian(overlaps[0]) && !SGEnvelopeCrossesAntimeridian(overlaps[1])) {
+        SGEnvelope western = overlaps[0].east == 180.0 ? overlaps[0] : overlaps[1];
+        SGEnvelope eastern = overlaps[0].east == 180.0 ? overlaps[1] : overlaps[0];
+        if(western.east == 180.0 && eastern.west == -180.0 && western.west > eastern.east) {
+            overlaps[0] = SGEnvelopeMake(south, western.west, north, eastern.east);
+            pieceCount = 1;
+        }
+    }
+    
+    for(NSUInteger i = 0; i < pieceCount; i++)
+        pieces[i] = overlaps[i];
+    
+    return pieceCount;
+}
+
+SGEnvelope SGEnvelopeUnion(SGEnvelope envelope, SGEnvelope otherEnvelope)
+{
+    double south = MIN(envelope.south, otherEnvelope.south);
+    double north = MAX(envelope.north, otherEnvelope.north);
+    double east = SGUnwrappedEast(envelope);
+    double otherEast = SGUnwrappedEast(otherEnvelope);
+    
+    // The other envelope can be moved by a turn to find the shortest
+    // interval that holds both. The edges of the result are taken from the
+    // envelopes as they are, so the result contains both exactly.
+    double bestWidth = 720.0;
+    SGEnvelope result = SGEnvelopeMake(south, -180.0, north, 180.0);
+    for(int i = -1; i <= 1; i++) {
+        BOOL westFromOther = otherEnvelope.west + 360.0 * i < envelope.west;
+        BOOL eastFromOther = otherEast + 360.0 * i > east;
+        double width = (eastFromOther ? otherEast + 360.0 * i : east) - (westFromOther ? otherEnvelope.west + 360.0 * i : envelope.west);
+        if(width < bestWidth) {
+            bestWidth = width;
+            result.west = westFromOther ? otherEnvelope.west : envelope.west;
+            result.east = eastFromOther ? otherEnvelope.east : envelope.east;
+        }
+    }
+    
+    if(bestWidth >= 360.0)
+        return SGEnvelopeMake(south, -180.0, north, 180.0);
+    
+    return result;
+}
+
+SGEnvelope SGEnvelopeExpandToCoordinate(SGEnvelope envelope, CLLocationCoordinate2D coordinate)
+{
+    SGEnvelope point = SGEnvelopeMake(coordinate.latitude, coordinate.longitude,
+                                      coordinate.latitude, coordinate.longitude);
+    return SGEnvelopeUnion(envelope, point);
+}
+
+SGEnvelope SGEnvelopeExpandByDegrees(SGEnvelope envelope, CLLocationDegrees latitudeDelta, CLLocationDegrees longitudeDelta)
+{
+    double south = MAX(envelope.south - latitudeDelta, -90.0);
+    double north = MIN(envelope.north + latitudeDelta, 90.0);
+    return SGEnvelopeMakeUnwrapped(south, envelope.west - longitudeDelta, north, SGUnwrappedEast(envelope) + longitudeDelta);
+}
+
+NSUInteger SGEnvelopeFilterCoordinates(SGEnvelope envelope, const double* latitudes, const double* longitudes, NSUInteger count, uint32_t* selection)
+{
+    // An envelope across the antimeridian is tested as two longitude ranges.
+    // The second range is empty otherwise, so every coordinate goes through
+    // the same comparisons.
+    double south = envelope.south;
+    double north = envelope.north;
+    double west = envelope.west;
+    double east = envelope.east;
+    double otherWest = INFINITY;
+    double otherEast = -INFINITY;
+    if(SGEnvelopeCrossesAntimeridian(envelope)) {
+        east = 180.0;
+        otherWest = -180.0;
+        otherEast = envelope.east;
+    } else if(east == 180.0)
+        otherWest = otherEast = -180.0;
+    else if(west == -180.0)
+        otherWest = otherEast = 180.0;
+    
+    // The index is stored for every coordinate and the count only moves
+    // past the selected ones, so there is no branch to mispredict.
+    NSUInteger selectionCount = 0;
+    NSUInteger i = 0;
+    
+#if defined(__AVX__)
+    __m256d south4 = _mm256_set1_pd(south);
+    __m256d north4 = _mm256_set1_pd(north);
+    __m256d west4 = _mm256_set1_pd(west);
+    __m256d east4 = _mm256_set1_pd(east);
+    __m256d otherWest4 = _mm256_set1_pd(otherWest);
+    __m256d otherEast4 = _mm256_set1_pd(otherEast);
+    for(; i + 4 <= count; i += 4) {
+        __m256d latitude = _mm256_loadu_pd(latitudes + i);
+        __m256d longitude = _mm256_loadu_pd(longitudes + i);
+        __m256d inside = _mm256_and_pd(_mm256_cmp_pd(latitude, south4, _CMP_GE_OQ),
+                                       _mm256_cmp_pd(latitude, north4, _CMP_LE_OQ));
+        __m256d range = _mm256_and_pd(_mm256_cmp_pd(longitude, west4, _CMP_GE_OQ),
+                                      _mm256_cmp_pd(longitude, east4, _CMP_LE_OQ));
+        __m256d otherRange = _mm256_and_pd(_mm256_cmp_pd(longitude, otherWest4, _CMP_GE_OQ),
+                                           _mm256_cmp_pd(longitude, otherEast4, _CMP_LE_OQ));
+        int mask = _mm256_movemask_pd(_mm256_and_pd(inside, _mm256_or_pd(range, otherRange)));
+        selection[selectionCount] = (uint32_t)i;
+        selectionCount += mask & 1;
+        selection[selectionCount] = (uint32_t)(i + 1);
+        selectionCount += (mask >> 1) & 1;
+        selection[selectionCount] = (uint32_t)(i + 2);
+        selectionCount += (mask >> 2) & 1;
+        selection[selectionCount] = (uint32_t)(i + 3);
+        selectionCount += mask >> 3;
+    }
+#elif defined(__SSE2__)
+    __m128d south2 = _mm_set1_pd(south);
+    __m128d north2 = _mm_set1_pd(north);
+    __m128d west2 = _mm_set1_pd(west);
+    __m128d east2 = _mm_set1_pd(east);
+    __m128d otherWest2 = _mm_set1_pd(otherWest);
+    __m128d otherEast2 = _mm_set1_pd(otherEast);
+    for(; i + 2 <= count; i += 2) {
+        __m128d latitude = _mm_loadu_pd(latitudes + i);
+        __m128d longitude = _mm_loadu_pd(longitudes + i);
+        __m128d inside = _mm_and_pd(_mm_cmpge_pd(latitude, south2), _mm_cmple_pd(latitude, north2));
+        __m128d range = _mm_and_pd(_mm_cmpge_pd(longitude, west2), _mm_cmple_pd(longitude, east2));
+        __m128d otherRange = _mm_and_pd(_mm_cmpge_pd(longitude, otherWest2), _mm_cmple_pd(longitude, otherEast2));
+        int mask = _mm_movemask_pd(_mm_and_pd(inside, _mm_or_pd(range, otherRange)));
+        selection[selectionCount] = (uint32_t)i;
+        selectionCount += mask & 1;
+        selection[selectionCount] = (uint32_t)(i + 1);
+        selectionCount += mask >> 1;
+    }
+#elif (defined(__ARM_NEON__) || defined(__ARM_NEON)) && defined(__aarch64__)
+    float64x2_t south2 = vdupq_n_f64(south);
+    float64x2_t north2 = vdupq_n_f64(north);
+    float64x2_t west2 = vdupq_n_f64(west);
+    float64x2_t east2 = vdupq_n_f64(east);
+    float64x2_t otherWest2 = vdupq_n_f64(otherWest);
+    float64x2_t otherEast2 = vdupq_n_f64(otherEast);
+    for(; i + 2 <= count; i += 2) {
+        float64x2_t latitude = vld1q_f64(latitudes + i);
+        float64x2_t longitude = vld1q_f64(longitudes + i);
+        uint64x2_t inside = vandq_u64(vcgeq_f64(latitude, south2), vcleq_f64(latitude, north2));
+        uint64x2_t range = vandq_u64(vcgeq_f64(longitude, west2), vcleq_f64(longitude, east2));
+        uint64x2_t otherRange = vandq_u64(vcgeq_f64(longitude, otherWest2), vcleq_f64(longitude, otherEast2));
+        uint64x2_t mask = vandq_u64(inside, vorrq_u64(range, otherRange));
+        selection[selectionCount] = (uint32_t)i;
+        selectionCount += vgetq_lane_u64(mask, 0) & 1;
+        selection[selectionCount] = (uint32_t)(i + 1);
+        selectionCount += vgetq_lane_u64(mask, 1) & 1;
+    }
+#endif
+    
+    for(; i < count; i++) {
+        double latitude = latitudes[i];
+        double longitude = longitudes[i];
+        int selected = (latitude >= south) & (latitude <= north) &
+            (((longitude >= west) & (longitude <= east)) | ((longitude >= otherWest) & (longitude <= otherEast)));
+        selection[selectionCount] = (uint32_t)i;
+        selectionCount += selected;
+    }
+    
+    return selectionCount;
+}
+
+static double SGUnwrappedEast(SGEnvelope envelope)
+{
+    return SGEnvelopeCrossesAntimeridian(envelope) ? envelope.east + 360.0 : envelope.east;
+}
+
+static BOOL SGPieceContainsLongitudes(SGEnvelope piece, double west, double east)
+{
+    if(west >= piece.west && east <= piece.east)
+        return YES;
+    
+    // -180 and 180 are the same meridian.
+    return west == east && fabs(west) == 180.0 && -west >= piece.west && -west <= piece.east;
+}
+
+static SGEnvelope SGEnvelopeMakeUnwrapped(double south, double west, double north, double east)
+{
+    // Takes one interval of longitudes that may go past -180 or 180 and wraps
+    // it back into the envelope convention.
+    if(east - west >= 360.0)
+        return SGEnvelopeMake(south, -180.0, north, 180.0);
+    
+    while(west < -180.0)
+        west += 360.0;
+    
+    while(west > 180.0)
+        west -= 360.0;
+    
+    while(east > 180.0)
+        east -= 360.0;
+    
+    while(east < -180.0)
+        east += 360.0;
+    
+    return SGEnvelopeMake(south, west, north, east);
+}
@@ -0,0 +1,110 @@
+//
+//  SGEnvelopeTree.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import <Foundation/Foundation.h>
+#import <CoreLocation/CoreLocation.h>
+
+#define kSGEnvelopeTree_NodeCapacity        8
+
+typedef struct {
+
+    SGEnvelope envelope;
+    NSUInteger index;
+
+} SGEnvelopeTreeEntry;
+
+typedef struct {
+
+    SGEnvelope envelope;
+    NSUInteger firstChild;
+    NSUInteger childCount;
+
+} SGEnvelopeTreeNode;
+
+/*!
+* @class SGEnvelopeTree
+* @abstract An R-tree of envelopes.
+* @discussion The tree is packed once with Sort-Tile-Recursive: the envelopes
+* are sorted into vertical slices by their centers, and every slice into
+* nodes of @link kSGEnvelopeTree_NodeCapacity kSGEnvelopeTree_NodeCapacity @/link
+* entries by latitude. The levels above are packed the same way. The tree
+* cannot change after it is built; build a new one instead.
+*
+* An envelope across the antimeridian is kept as its two pieces, so a query
+* never has to wrap.
+*/
+@interface SGEnvelopeTree : NSObject {
+
+    @private
+    SGEnvelopeTreeEntry* entries;
+    NSUInteger entryCount;
+    SGEnvelopeTreeNode* nodes;
+    NSUInteger nodeCount;
+    NSUInteger leafCount;
+    NSUInteger count;
+}
+
+/*!
+* @property
+* @abstract The amount of envelopes the tree was built with.
+*/
+@property (nonatomic, readonly) NSUInteger count;
+
+/*!
+* @method initWithEnvelopes:count:
+* @abstract Builds the tree.
+* @param envelopes The envelopes. Their indexes in this array are the ones
+* that queries return.
+* @param count The amount of envelopes.
+*/
+- (id) initWithEnvelopes:(const SGEnvelope*)envelopes count:(NSUInteger)count;
+
+/*!
+* @method indexesIntersectingEnvelope:
+* @abstract Finds the envelopes that share any point with an envelope.
+* @param envelope The envelope to look in.
+* @result The indexes of the envelopes.
+*/
+- (NSIndexSet*) indexesIntersectingEnvelope:(SGEnvelope)envelope;
+
+/*!
+* @method indexesContainingCoordinate:
+* @abstract Finds the envelopes that contain a coordinate.
+* @param coordinate The coordinate.
+* @result The indexes of the envelopes.
+*/
+- (NSIndexSet*) indexesContainingCoordinate:(CLLocationCoordinate2D)coordinate;
+
+@end
@@ -0,0 +1,208 @@
+//
+//  SGEnvelopeTree.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import "SGEnvelopeTree.h"
+#import "SGEnvelopeGeometry.h"
+
+#define kSGEnvelopeTree_StackSize           (kSGEnvelopeTree_NodeCapacity * 32)
+
+@interface SGEnvelopeTree (Private)
+
+- (void) addIndexesIntersectingPiece:(SGEnvelope)piece toIndexSet:(NSMutableIndexSet*)indexSet;
+
+@end
+
+static NSUInteger SGPackLevel(void* items, size_t itemSize, NSUInteger itemCount, NSUInteger firstItem, SGEnvelopeTreeNode* parents);
+static BOOL SGPiecesIntersect(SGEnvelope piece, SGEnvelope otherPiece);
+static int SGCompareLongitudes(const void* item, const void* otherItem);
+static int SGCompareLatitudes(const void* item, const void* otherItem);
+
+@implementation SGEnvelopeTree
+@synthesize count;
+
+- (id) initWithEnvelopes:(const SGEnvelope*)envelopes count:(NSUInteger)envelopeCount
+{
+    if(self = [super init]) {
+        count = envelopeCount;
+        entries = malloc(sizeof(SGEnvelopeTreeEntry) * MAX(envelopeCount * 2, 1));
+        entryCount = 0;
+        for(NSUInteger i = 0; i < envelopeCount; i++) {
+            SGEnvelope pieces[2];
+            NSUInteger pieceCount = SGEnvelopeSplitAtAntimeridian(envelopes[i], pieces);
+            for(NSUInteger j = 0; j < pieceCount; j++) {
+                entries[entryCount].envelope = pieces[j];
+                entries[entryCount].index = i;
+                entryCount++;
+            }
+        }
+        
+        // Every level has at most an eighth of the one below, rounded up.
+        NSUInteger maxNodeCount = 1;
+        for(NSUInteger levelCount = entryCount; levelCount > 1; levelCount = (levelCount + kSGEnvelopeTree_NodeCapacity - 1) / kSGEnvelopeTree_NodeCapacity)
+            maxNodeCount += (levelCount + kSGEnvelopeTree_NodeCapacity - 1) / kSGEnvelopeTree_NodeCapacity;
+        
+        nodes = malloc(sizeof(SGEnvelopeTreeNode) * maxNodeCount);
+        leafCount = SGPackLevel(entries, sizeof(SGEnvelopeTreeEntry), entryCount, 0, nodes);
+        nodeCount = leafCount;
+        
+        NSUInteger levelStart = 0;
+        NSUInteger levelCount = leafCount;
+        while(levelCount > 1) {
+            NSUInteger parentCount = SGPackLevel(nodes + levelStart, sizeof(SGEnvelopeTreeNode), levelCount, levelStart, nodes + nodeCount);
+            levelStart = nodeCount;
+            levelCount = parentCount;
+            nodeCount += parentCount;
+        }
+    }
+    
+    return self;
+}
+
+- (NSIndexSet*) indexesIntersectingEnvelope:(SGEnvelope)envelope
+{
+    NSMutableIndexSet* indexSet = [NSMutableIndexSet indexSet];
+    SGEnvelope pieces[2];
+    NSUInteger pieceCount = SGEnvelopeSplitAtAntimeridian(envelope, pieces);
+    for(NSUInteger i = 0; i < pieceCount; i++)
+        [self addIndexesIntersectingPiece:pieces[i] toIndexSet:indexSet];
+    
+    return indexSet;
+}
+
+- (NSIndexSet*) indexesContainingCoordinate:(CLLocationCoordinate2D)coordinate
+{
+    NSMutableIndexSet* indexSet = [NSMutableIndexSet indexSet];
+    [self addIndexesIntersectingPiece:SGEnvelopeMake(coordinate.latitude, coordinate.longitude, coordinate.latitude, coordinate.longitude)
+                           toIndexSet:indexSet];
+    
+    // -180 and 180 are the same meridian.
+    if(fabs(coordinate.longitude) == 180.0)
+        [self addIndexesIntersectingPiece:SGEnvelopeMake(coordinate.latitude, -coordinate.longitude, coordinate.latitude, -coordinate.longitude)
+                               toIndexSet:indexSet];
+    
+    return indexSet;
+}
+
+- (void) addIndexesIntersectingPiece:(SGEnvelope)piece toIndexSet:(NSMutableIndexSet*)indexSet
+{
+    if(!nodeCount)
+        return;
+    
+    NSUInteger stack[kSGEnvelopeTree_StackSize];
+    NSUInteger stackCount = 0;
+    stack[stackCount++] = nodeCount - 1;
+    while(stackCount) {
+        SGEnvelopeTreeNode* node = &nodes[stack[--stackCount]];
+        if(!SGPiecesIntersect(node->envelope, piece))
+            continue;
+        
+        NSUInteger end = node->firstChild + node->childCount;
+        if((NSUInteger)(node - nodes) < leafCount) {
+            for(NSUInteger i = node->firstChild; i < end; i++)
+                if(SGPiecesIntersect(entries[i].envelope, piece))
+                    [indexSet addIndex:entries[i].index];
+        } else
+            for(NSUInteger i = node->firstChild; i < end; i++)
+                stack[stackCount++] = i;
+    }
+}
+
+- (void) dealloc
+{
+    free(entries);
+    free(nodes);
+    
+    [super dealloc];
+}
+
+@end
+
+static NSUInteger SGPackLevel(void* items, size_t itemSize, NSUInteger itemCount, NSUInteger firstItem, SGEnvelopeTreeNode* parents)
+{
+    // The items are cut into vertical slices of whole nodes, and each slice
+    // is sorted by latitude and cut into nodes.
+    NSUInteger parentCount = (itemCount + kSGEnvelopeTree_NodeCapacity - 1) / kSGEnvelopeTree_NodeCapacity;
+    if(!parentCount)
+        return 0;
+    
+    NSUInteger sliceCount = (NSUInteger)ceil(sqrt((double)parentCount));
+    NSUInteger sliceSize = (parentCount + sliceCount - 1) / sliceCount * kSGEnvelopeTree_NodeCapacity;
+    qsort(items, itemCount, itemSize, SGCompareLongitudes);
+    for(NSUInteger start = 0; start < itemCount; start += sliceSize)
+        qsort((char*)items + start * itemSize, MIN(sliceSize, itemCount - start), itemSize, SGCompareLatitudes);
+    
+    for(NSUInteger i = 0; i < parentCount; i++) {
+        SGEnvelopeTreeNode* parent = &parents[i];
+        parent->firstChild = firstItem + i * kSGEnvelopeTree_NodeCapacity;
+        parent->childCount = MIN(kSGEnvelopeTree_NodeCapacity, itemCount - i * kSGEnvelopeTree_NodeCapacity);
+        
+        // Entries and nodes both start with their envelope.
+        const char* child = (const char*)items + i * kSGEnvelopeTree_NodeCapacity * itemSize;
+        parent->envelope = *(const SGEnvelope*)child;
+        for(NSUInteger j = 1; j < parent->childCount; j++) {
+            SGEnvelope envelope = *(const SGEnvelope*)(child + j * itemSize);
+            parent->envelope.south = MIN(parent->envelope.south, envelope.south);
+            parent->envelope.west = MIN(parent->envelope.west, envelope.west);
+            parent->envelope.north = MAX(parent->envelope.north, envelope.north);
+            parent->envelope.east = MAX(parent->envelope.east, envelope.east);
+        }
+    }
+    
+    return parentCount;
+}
+
+static BOOL SGPiecesIntersect(SGEnvelope piece, SGEnvelope otherPiece)
+{
+    return piece.west <= otherPiece.east && piece.east >= otherPiece.west &&
+        piece.south <= otherPiece.north && piece.north >= otherPiece.south;
+}
+
+static int SGCompareLongitudes(const void* item, const void* otherItem)
+{
+    const SGEnvelope* envelope = item;
+    const SGEnvelope* otherEnvelope = otherItem;
+    double center = envelope->west + envelope->east;
+    double otherCenter = otherEnvelope->west + otherEnvelope->east;
+    return center < otherCenter ? -1 : (center > otherCenter ? 1 : 0);
+}
+
+static int SGCompareLatitudes(const void* item, const void* otherItem)
+{
+    const SGEnvelope* envelope = item;
+    const SGEnvelope* otherEnvelope = otherItem;
+    double center = envelope->south + envelope->north;
+    double otherCenter = otherEnvelope->south + otherEnvelope->north;
+    return center < otherCenter ? -1 : (center > otherCenter ? 1 : 0);
+}
@@ -0,0 +1,169 @@
+//
+//  SGFeatureStore.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+
+#import <Foundation/Foundation.h>
+
+#import "SGEnvelopeTree.h"
+
+#define kSGFeatureStore_MaxRemainderCount       4
+
+/*!
+* @class SGFeatureStore
+* @abstract Answers overlap requests from features that were loaded before.
+* @discussion The features of every
+* @link overlapsType:inPolygon:withLimit: overlapsType:inPolygon:withLimit: @/link
+* response are kept by their id and indexed by an
+* @link //simplegeo/ooc/cl/SGEnvelopeTree SGEnvelopeTree @/link of their
+* bounds. The store also remembers which envelopes have been covered, the
+* ones whose response had fewer features than the limit and so could not
+* have left any out.
+*
+* A request is only sent for the part of an envelope that has not been
+* covered, as up to
+* @link kSGFeatureStore_MaxRemainderCount kSGFeatureStore_MaxRemainderCount @/link
+* envelopes. When nothing is left the request is answered locally. Either
+* way the response holds the kept features that overlap the whole envelope.
+*
+* Responses are sent to the delegate as if they came from
+* @link //simplegeo/ooc/cl/SGLocationService SGLocationService @/link, on
+* the main thread. The response ids are the store's own since one request
+* can take several to SimpleGeo.
+*/
+@interface SGFeatureStore : NSObject <SGLocationServiceDelegate> {
+
+    id<SGLocationServiceDelegate> delegate;
+    NSUInteger maxFeatureCount;
+    NSUInteger maxCoveredCount;
+    NSUInteger hitCount;
+    NSUInteger missCount;
+    
+    @private
+    NSMutableDictionary* features;
+    NSMutableArray* recentFeatureIds;
+    NSMutableArray* coveredEnvelopes;
+    SGEnvelopeTree* tree;
+    NSArray* treeFeatures;
+    
+    NSMutableDictionary* pendingRequests;
+    NSUInteger localRequestCount;
+}
+
+@property (nonatomic, assign) id<SGLocationServiceDelegate> delegate;
+
+/*!
+* @property
+* @abstract The most features to keep. The ones that were loaded first are
+* dropped first, along with the covered envelopes they overlap. The default
+* is 2000.
+*/
+@property (nonatomic, assign) NSUInteger maxFeatureCount;
+
+/*!
+* @property
+* @abstract The most covered envelopes to remember. The default is 64.
+*/
+@property (nonatomic, assign) NSUInteger maxCoveredCount;
+
+/*!
+* @property
+* @abstract The amount of requests that were answered locally.
+*/
+@property (nonatomic, readonly) NSUInteger hitCount;
+
+/*!
+* @property
+* @abstract The amount of requests that sent at least one request to
+* SimpleGeo.
+*/
+@property (nonatomic, readonly) NSUInteger missCount;
+
+/*!
+* @method overlapsType:inPolygon:withLimit:
+* @abstract Finds the features that overlap an envelope.
+* @discussion See @link //simplegeo/ooc/instm/SGLocationService/overlapsType:inPolygon:withLimit: overlapsType:inPolygon:withLimit: @/link.
+* @param type The type of the features, or nil for every type.
+* @param envelope The envelope.
+* @param limit The most features to return.
+* @result A response id.
+*/
+- (NSString*) overlapsType:(NSString*)type inPolygon:(SGEnvelope)envelope withLimit:(int)limit;
+
+/*!
+* @method addFeatures:
+* @abstract Keeps features that were loaded some other way.
+* @discussion The features do not cover any envelope since there may be
+* others next to them.
+* @param features Features in the form @link //simplegeo/ooc/instm/SGLocationService/contains: contains: @/link
+* returns. Features without an id or bounds are ignored.
+*/
+- (void) addFeatures:(NSArray*)features;
+
+/*!
+* @method featureWithId:
+* @result The feature if it is kept.
+*/
+- (NSDictionary*) featureWithId:(NSString*)featureId;
+
+/*!
+* @method featuresOfType:inEnvelope:
+* @abstract Finds the kept features whose bounds overlap an envelope.
+* @param type The type of the features, or nil for every type.
+* @param envelope The envelope.
+* @result The features.
+*/
+- (NSArray*) featuresOfType:(NSString*)type inEnvelope:(SGEnvelope)envelope;
+
+/*!
+* @method getRemainder:ofEnvelope:type:
+* @abstract Finds the part of an envelope that has not been covered.
+* @discussion When the part is too ragged to fit, the envelope itself
+* is returned, split at the antimeridian.
+* @param remainder Receives the envelopes that are left. Has room for
+* @link kSGFeatureStore_MaxRemainderCount kSGFeatureStore_MaxRemainderCount @/link
+* envelopes.
+* @param envelope The envelope.
+* @param type The type of the features, or nil for every type.
+* @result The amount of envelopes that are left, 0 if the whole envelope is covered.
+*/
+- (NSUInteger) getRemainder:(SGEnvelope*)remainder ofEnvelope:(SGEnvelope)envelope type:(NSString*)type;
+
+/*!
+* @method removeAllFeatures
+* @abstract Drops every feature and covered envelope.
+*/
+- (void) removeAllFeatures;
+
+@end
@@ -0,0 +1,427 @@
+//
+//  SGFeatureStore.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+
+#import "SGFeatureStore.h"
+#import "SGEnvelopeGeometry.h"
+
+#define kSGFeatureStore_FragmentCapacity        64
+
+@interface SGFeatureStore (Private)
+
+- (void) addCoveredEnvelope:(SGEnvelope)envelope type:(NSString*)type;
+- (void) removeOldFeatures;
+- (void) buildTree;
+- (void) respondToRequest:(NSDictionary*)request;
+
+@end
+
+static BOOL SGGetFeatureEnvelope(NSDictionary* feature, SGEnvelope* envelope);
+static NSUInteger SGSubtractPiece(SGEnvelope piece, SGEnvelope hole, SGEnvelope* parts);
+
+@implementation SGFeatureStore
+@synthesize delegate, maxFeatureCount, maxCoveredCount, hitCount, missCount;
+
+- (id) init
+{
+    if(self = [super init]) {
+        delegate = nil;
+        maxFeatureCount = 2000;
+        maxCoveredCount = 64;
+        hitCount = 0;
+        missCount = 0;
+        
+        features = [[NSMutableDictionary alloc] init];
+        recentFeatureIds = [[NSMutableArray alloc] init];
+        coveredEnvelopes = [[NSMutableArray alloc] init];
+        tree = nil;
+        treeFeatures = nil;
+        
+        pendingRequests = [[NSMutableDictionary alloc] init];
+        localRequestCount = 0;
+        
+        [[SGLocationService sharedLocationService] addDelegate:self];
+    }
+    
+    return self;
+}
+
+- (void) setMaxFeatureCount:(NSUInteger)count
+{
+    maxFeatureCount = count;
+    [self removeOldFeatures];
+}
+
+- (void) setMaxCoveredCount:(NSUInteger)count
+{
+    maxCoveredCount = count;
+    if([coveredEnvelopes count] > maxCoveredCount)
+        [coveredEnvelopes removeObjectsInRange:NSMakeRange(0, [coveredEnvelopes count] - maxCoveredCount)];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Overlaps 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (NSString*) overlapsType:(NSString*)type inPolygon:(SGEnvelope)envelope withLimit:(int)limit
+{
+    localRequestCount++;
+    NSString* requestId = [NSString stringWithFormat:@"featurestore-%lu", (unsigned long)localRequestCount];
+    NSMutableDictionary* request = [NSMutableDictionary dictionaryWithObjectsAndKeys:
+                                    requestId, @"requestId",
+                                    [NSValue valueWithBytes:&envelope objCType:@encode(SGEnvelope)], @"envelope",
+                                    [NSNumber numberWithInt:limit], @"limit",
+                                    [NSMutableDictionary dictionary], @"pieces",
+                                    nil];
+    if(type)
+        [request setObject:type forKey:@"type"];
+    
+    SGEnvelope remainder[kSGFeatureStore_MaxRemainderCount];
+    NSUInteger remainderCount = [self getRemainder:remainder ofEnvelope:envelope type:type];
+    if(!remainderCount) {
+        hitCount++;
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self respondToRequest:request];
+        });
+        
+        return requestId;
+    }
+    
+    missCount++;
+    SGLocationService* locationService = [SGLocationService sharedLocationService];
+    NSMutableDictionary* pieces = [request objectForKey:@"pieces"];
+    for(NSUInteger i = 0; i < remainderCount; i++) {
+        NSString* pieceRequestId = [locationService overlapsType:type inPolygon:remainder[i] withLimit:limit];
+        if(pieceRequestId) {
+            [pieces setObject:[NSValue valueWithBytes:&remainder[i] objCType:@encode(SGEnvelope)] forKey:pieceRequestId];
+            [pendingRequests setObject:request forKey:pieceRequestId];
+        }
+    }
+    
+    return [pieces count] ? requestId : nil;
+}
+
+- (void) addFeatures:(NSArray*)newFeatures
+{
+    for(NSDictionary* feature in newFeatures) {
+        SGEnvelope envelope;
+        id featureId = [feature isKindOfClass:[NSDictionary class]] ? [feature objectForKey:@"id"] : nil;
+        if(![featureId isKindOfClass:[NSString class]] || !SGGetFeatureEnvelope(feature, &envelope))
+            continue;
+        
+        // Features keep their place when they are loaded again, so the
+        // ones that were loaded first are still dropped first.
+        if(![features objectForKey:featureId])
+            [recentFeatureIds addObject:featureId];
+        
+        [features setObject:feature forKey:featureId];
+        
+        [tree release];
+        tree = nil;
+    }
+    
+    [self removeOldFeatures];
+}
+
+- (NSDictionary*) featureWithId:(NSString*)featureId
+{
+    return [features objectForKey:featureId];
+}
+
+- (NSArray*) featuresOfType:(NSString*)type inEnvelope:(SGEnvelope)envelope
+{
+    if(!tree)
+        [self buildTree];
+    
+    NSIndexSet* indexes = [tree indexesIntersectingEnvelope:envelope];
+    NSMutableArray* overlappingFeatures = [NSMutableArray arrayWithCapacity:[indexes count]];
+    for(NSUInteger i = [indexes firstIndex]; i != NSNotFound; i = [indexes indexGreaterThanIndex:i]) {
+        NSDictionary* feature = [treeFeatures objectAtIndex:i];
+        if(!type || [type isEqual:[feature objectForKey:@"type"]])
+            [overlappingFeatures addObject:feature];
+    }
+    
+    return overlappingFeatures;
+}
+
+- (NSUInteger) getRemainder:(SGEnvelope*)remainder ofEnvelope:(SGEnvelope)envelope type:(NSString*)type
+{
+    SGEnvelope fragments[kSGFeatureStore_FragmentCapacity];
+    SGEnvelope nextFragments[kSGFeatureStore_FragmentCapacity];
+    NSUInteger fragmentCount = SGEnvelopeSplitAtAntimeridian(envelope, fragments);
+    BOOL ragged = NO;
+    
+    // An envelope that was covered for every type is covered for each one.
+    for(NSDictionary* covered in coveredEnvelopes) {
+        NSString* coveredType = [covered objectForKey:@"type"];
+        if(coveredType && ![coveredType isEqual:type])
+            continue;
+        
+        SGEnvelope coveredEnvelope;
+        [[covered objectForKey:@"envelope"] getValue:&coveredEnvelope];
+        
+        SGEnvelope holes[2];
+        NSUInteger holeCount = SGEnvelopeSplitAtAntimeridian(coveredEnvelope, holes);
+        for(NSUInteger i = 0; i < holeCount && !ragged; i++) {
+            NSUInteger nextFragmentCount = 0;
+            for(NSUInteger j = 0; j < fragmentCount && !ragged; j++) {
+                SGEnvelope parts[4];
+                NSUInteger partCount = SGSubtractPiece(fragments[j], holes[i], parts);
+                ragged = nextFragmentCount + partCount > kSGFeatureStore_FragmentCapacity;
+                for(NSUInteger k = 0; k < partCount && !ragged; k++)
+                    nextFragments[nextFragmentCount++] = parts[k];
+            }
+            
+            memcpy(fragments, nextFragments, sizeof(SGEnvelope) * nextFragmentCount);
+            fragmentCount = nextFragmentCount;
+        }
+        
+        if(!fragmentCount || ragged)
+            break;
+    }
+    
+    if(ragged || fragmentCount > kSGFeatureStore_MaxRemainderCount)
+        return SGEnvelopeSplitAtAntimeridian(envelope, remainder);
+    
+    memcpy(remainder, fragments, sizeof(SGEnvelope) * fragmentCount);
+    return fragmentCount;
+}
+
+- (void) removeAllFeatures
+{
+    [features removeAllObjects];
+    [recentFeatureIds removeAllObjects];
+    [coveredEnvelopes removeAllObjects];
+    
+    [tree release];
+    tree = nil;
+    [treeFeatures release];
+    treeFeatures = nil;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark SGLocationService delegate methods 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (void) locationService:(SGLocationService*)service succeededForResponseId:(NSString*)requestId responseObject:(NSObject*)responseObject
+{
+    dispatch_async(dispatch_get_main_queue(), ^{
+        NSDictionary* request = [[[pendingRequests objectForKey:requestId] retain] autorelease];
+        if(!request)
+            return;
+        
+        [pendingRequests removeObjectForKey:requestId];
+        NSMutableDictionary* pieces = [request objectForKey:@"pieces"];
+        if([responseObject isKindOfClass:[NSArray class]]) {
+            NSArray* responseFeatures = (NSArray*)responseObject;
+            [self addFeatures:responseFeatures];
+            
+            // A response with as many features as the limit may have
+            // left some out.
+            if((NSInteger)[responseFeatures count] < [[request objectForKey:@"limit"] intValue]) {
+                SGEnvelope piece;
+                [[pieces objectForKey:requestId] getValue:&piece];
+                [self addCoveredEnvelope:piece type:[request objectForKey:@"type"]];
+            }
+        }
+        
+        [pieces removeObjectForKey:requestId];
+        if(![pieces count])
+            [self respondToRequest:request];
+    });
+}
+
+- (void) locationService:(SGLocationService*)service failedForResponseId:(NSString*)requestId error:(NSError*)error
+{
+    dispatch_async(dispatch_get_main_queue(), ^{
+        NSDictionary* request = [[[pendingRequests objectForKey:requestId] retain] autorelease];
+        if(!request)
+            return;
+        
+        // The other pieces are of no use without this one.
+        [pendingRequests removeObjectsForKeys:[[request objectForKey:@"pieces"] allKeys]];
+        [delegate locationService:service failedForResponseId:[request objectForKey:@"requestId"] error:error];
+    });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Utility methods 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (void) respondToRequest:(NSDictionary*)request
+{
+    SGEnvelope envelope;
+    [[request objectForKey:@"envelope"] getValue:&envelope];
+    NSArray* overlappingFeatures = [self featuresOfType:[request objectForKey:@"type"] inEnvelope:envelope];
+    
+    NSUInteger limit = MAX([[request objectForKey:@"limit"] intValue], 0);
+    if([overlappingFeatures count] > limit)
+        overlappingFeatures = [overlappingFeatures subarrayWithRange:NSMakeRange(0, limit)];
+    
+    [delegate locationService:[SGLocationService sharedLocationService]
+       succeededForResponseId:[request objectForKey:@"requestId"]
+               responseObject:overlappingFeatures];
+}
+
+- (void) addCoveredEnvelope:(SGEnvelope)envelope type:(NSString*)type
+{
+    if(!maxCoveredCount)
+        return;
+    
+    // Envelopes inside the new one cover nothing more.
+    NSMutableArray* redundantEnvelopes = [NSMutableArray array];
+    for(NSDictionary* covered in coveredEnvelopes) {
+        SGEnvelope coveredEnvelope;
+        [[covered objectForKey:@"envelope"] getValue:&coveredEnvelope];
+        NSString* coveredType = [covered objectForKey:@"type"];
+        if((!type || [type isEqual:coveredType]) && SGEnvelopeContainsEnvelope(envelope, coveredEnvelope))
+            [redundantEnvelopes addObject:covered];
+    }
+    
+    [coveredEnvelopes removeObjectsInArray:redundantEnvelopes];
+    
+    NSMutableDictionary* covered = [NSMutableDictionary dictionaryWithObject:[NSValue valueWithBytes:&envelope objCType:@encode(SGEnvelope)]
+                                                                      forKey:@"envelope"];
+    if(type)
+        [covered setObject:type forKey:@"type"];
+    
+    [coveredEnvelopes addObject:covered];
+    if([coveredEnvelopes count] > maxCoveredCount)
+        [coveredEnvelopes removeObjectAtIndex:0];
+}
+
+- (void) removeOldFeatures
+{
+    while([recentFeatureIds count] > maxFeatureCount) {
+        NSString* featureId = [recentFeatureIds objectAtIndex:0];
+        SGEnvelope envelope;
+        SGGetFeatureEnvelope([features objectForKey:featureId], &envelope);
+        
+        // Any envelope the feature overlaps is no longer covered.
+        NSMutableArray* uncoveredEnvelopes = [NSMutableArray array];
+        for(NSDictionary* covered in coveredEnvelopes) {
+            SGEnvelope coveredEnvelope;
+            [[covered objectForKey:@"envelope"] getValue:&coveredEnvelope];
+            if(SGEnvelopeIntersectsEnvelope(envelope, coveredEnvelope))
+                [uncoveredEnvelopes addObject:covered];
+        }
+        
+        [coveredEnvelopes removeObjectsInArray:uncoveredEnvelopes];
+        [features removeObjectForKey:featureId];
+        [recentFeatureIds removeObjectAtIndex:0];
+        
+        [tree release];
+        tree = nil;
+    }
+}
+
+- (void) buildTree
+{
+    [treeFeatures release];
+    treeFeatures = [[features allValues] retain];
+    
+    NSUInteger count = [treeFeatures count];
+    SGEnvelope* envelopes = malloc(sizeof(SGEnvelope) * MAX(count, 1));
+    for(NSUInteger i = 0; i < count; i++)
+        SGGetFeatureEnvelope([treeFeatures objectAtIndex:i], &envelopes[i]);
+    
+    tree = [[SGEnvelopeTree alloc] initWithEnvelopes:envelopes count:count];
+    free(envelopes);
+}
+
+- (void) dealloc
+{
+    [[SGLocationService sharedLocationService] removeDelegate:self];
+    
+    [features release];
+    [recentFeatureIds release];
+    [coveredEnvelopes release];
+    [tree release];
+    [treeFeatures release];
+    
+    [pendingRequests release];
+    
+    [super dealloc];
+}
+
+@end
+
+static BOOL SGGetFeatureEnvelope(NSDictionary* feature, SGEnvelope* envelope)
+{
+    // The bounds are west, south, east and north.
+    NSArray* bounds = [feature objectForKey:@"bounds"];
+    if(![bounds isKindOfClass:[NSArray class]] || [bounds count] != 4)
+        return NO;
+    
+    for(id value in bounds)
+        if(![value isKindOfClass:[NSNumber class]])
+            return NO;
+    
+    *envelope = SGEnvelopeMake([[bounds objectAtIndex:1] doubleValue],
+                               [[bounds objectAtIndex:0] doubleValue],
+                               [[bounds objectAtIndex:3] doubleValue],
+                               [[bounds objectAtIndex:2] doubleValue]);
+    return YES;
+}
+
+static NSUInteger SGSubtractPiece(SGEnvelope piece, SGEnvelope hole, SGEnvelope* parts)
+{
+    // Neither envelope crosses the antimeridian. Envelopes that only share
+    // an edge leave the piece whole.
+    if(!(hole.south < piece.north && hole.north > piece.south && hole.west < piece.east && hole.east > piece.west)) {
+        parts[0] = piece;
+        return 1;
+    }
+    
+    NSUInteger partCount = 0;
+    if(hole.south > piece.south)
+        parts[partCount++] = SGEnvelopeMake(piece.south, piece.west, hole.south, piece.east);
+    
+    if(hole.north < piece.north)
+        parts[partCount++] = SGEnvelopeMake(hole.north, piece.west, piece.north, piece.east);
+    
+    double south = MAX(piece.south, hole.south);
+    double north = MIN(piece.north, hole.north);
+    if(hole.west > piece.west)
+        parts[partCount++] = SGEnvelopeMake(south, piece.west, north, hole.west);
+    
+    if(hole.east < piece.east)
+        parts[partCount++] = SGEnvelopeMake(south, hole.east, north, piece.east);
+    
+    return partCount;
+}
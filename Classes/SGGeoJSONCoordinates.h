@@ -0,0 +1,71 @@
+//
+//  SGGeoJSONCoordinates.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+
+#import <Foundation/Foundation.h>
+#import <MapKit/MapKit.h>
+
+/*
+* SGGeoJSONCopyHistoryMapPoints reads a history page straight from the bytes
+* of its JSON, without building the NSArrays and NSNumbers a JSON parser
+* would. The positions of any depth of nested arrays are read in order, so a
+* LineString, a MultiPoint and the rings of a Polygon all come out as one
+* list. Values after the latitude of a position, such as an altitude, are
+* skipped.
+*
+* SGLocationService only hands out responses that the SDK has already
+* parsed, so pages loaded through it can not use this. It is for pages that
+* are held as JSON, through
+* @link //simplegeo/ooc/instm/SGHistoryLoader/loadHistoryData:forRecordAnnotation: loadHistoryData:forRecordAnnotation: @/link.
+*
+* Numbers with up to 15 significant digits and small exponents, which is
+* every coordinate SimpleGeo returns, are converted without strtod and
+* still rounded correctly.
+*/
+
+/*!
+* @function SGGeoJSONCopyHistoryMapPoints(const char*, NSUInteger, NSTimeInterval**, NSUInteger*)
+* @abstract Reads the points of a history page, a GeometryCollection whose
+* geometries have a created value, into new buffers of map points and times.
+* @discussion Every position of a geometry gets the created value of that
+* geometry. A geometry without one gets the time of the point before it, or
+* 0 for the first point. Members other than geometries, coordinates and
+* created are skipped.
+* @param times Receives a buffer of times that has to be freed.
+* @param count Receives the amount of points.
+* @result A buffer that has to be freed, or NULL if the text is not a
+* history page or has no points.
+*/
+extern MKMapPoint* SGGeoJSONCopyHistoryMapPoints(const char* bytes, NSUInteger length, NSTimeInterval** times, NSUInteger* count);
@@ -0,0 +1,458 @@
+//
+//  SGGeoJSONCoordinates.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+
+#import "SGGeoJSONCoordinates.h"
+#include <xlocale.h>
+
+#define kSGGeoJSONCoordinates_MaxDepth          8
+#define kSGGeoJSONCoordinates_MaxExactMantissa  (1ULL << 53)
+#define kSGGeoJSONCoordinates_MaxSkippedDepth   64
+
+typedef struct {
+
+    MKMapPoint* positions;
+    NSUInteger count;
+    NSUInteger capacity;
+
+} SGPositionBuffer;
+
+typedef struct {
+
+    NSTimeInterval* times;
+    NSUInteger capacity;
+    NSTimeInterval lastTime;
+
+} SGTimeBuffer;
+
+static const char* SGReadArray(const char* p, const char* end, SGPositionBuffer* buffer, int depth);
+static BOOL SGAddPosition(SGPositionBuffer* buffer, double longitude, double latitude);
+static const char* SGReadHistory(const char* p, const char* end, SGPositionBuffer* buffer, SGTimeBuffer* timeBuffer);
+static const char* SGReadGeometries(const char* p, const char* end, SGPositionBuffer* buffer, SGTimeBuffer* timeBuffer);
+static const char* SGReadGeometry(const char* p, const char* end, SGPositionBuffer* buffer, SGTimeBuffer* timeBuffer);
+static const char* SGReadKey(const char* p, const char* end, const char** key, NSUInteger* keyLength);
+static inline BOOL SGKeyEquals(const char* key, NSUInteger keyLength, const char* name);
+static const char* SGSkipValue(const char* p, const char* end, int depth);
+static const char* SGReadNumber(const char* p, const char* end, double* value);
+static const char* SGSkipString(const char* p, const char* end);
+static inline const char* SGSkipSpace(const char* p, const char* end);
+
+static const double SGPowersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+MKMapPoint* SGGeoJSONCopyHistoryMapPoints(const char* bytes, NSUInteger length, NSTimeInterval** times, NSUInteger* count)
+{
+    SGPositionBuffer buffer = {NULL, 0, 0};
+    SGTimeBuffer timeBuffer = {NULL, 0, 0.0};
+    const char* end = bytes + length;
+    const char* p = SGReadHistory(SGSkipSpace(bytes, end), end, &buffer, &timeBuffer);
+    if(!p || !buffer.count) {
+        free(buffer.positions);
+        free(timeBuffer.times);
+        *times = NULL;
+        *count = 0;
+        
+        return NULL;
+    }
+    
+    *times = realloc(timeBuffer.times, sizeof(NSTimeInterval) * buffer.count);
+    *count = buffer.count;
+    
+    return realloc(buffer.positions, sizeof(MKMapPoint) * buffer.count);
+}
+
+static const char* SGReadArray(const char* p, const char* end, SGPositionBuffer* buffer, int depth)
+{
+    if(depth >= kSGGeoJSONCoordinates_MaxDepth)
+        return NULL;
+    
+    // The first value tells whether this is a position or an array of them.
+    p = SGSkipSpace(p + 1, end);
+    if(p >= end)
+        return NULL;
+    
+    if(*p == ']')
+        return p + 1;
+    
+    if(*p == '[') {
+        while(p) {
+            p = SGReadArray(p, end, buffer, depth + 1);
+            p = p ? SGSkipSpace(p, end) : NULL;
+            if(!p || p >= end)
+                return NULL;
+            
+            if(*p == ']')
+                return p + 1;
+            
+            p = *p == ',' ? SGSkipSpace(p + 1, end) : NULL;
+            if(p && (p >= end || *p != '['))
+                return NULL;
+        }
+        
+        return NULL;
+    }
+    
+    double values[2];
+    NSUInteger valueCount = 0;
+    while(p) {
+        double value;
+        p = SGReadNumber(p, end, &value);
+        if(!p)
+            return NULL;
+        
+        if(valueCount < 2)
+            values[valueCount] = value;
+        
+        valueCount++;
+        p = SGSkipSpace(p, end);
+        if(p >= end)
+            return NULL;
+        
+        if(*p == ']')
+            break;
+        
+        p = *p == ',' ? SGSkipSpace(p + 1, end) : NULL;
+    }
+    
+    if(!p || valueCount < 2 || !SGAddPosition(buffer, values[0], values[1]))
+        return NULL;
+    
+    return p + 1;
+}
+
+static BOOL SGAddPosition(SGPositionBuffer* buffer, double longitude, double latitude)
+{
+    if(buffer->count >= buffer->capacity) {
+        NSUInteger capacity = MAX(buffer->capacity * 2, 256);
+        MKMapPoint* positions = realloc(buffer->positions, sizeof(MKMapPoint) * capacity);
+        if(!positions)
+            return NO;
+        
+        buffer->positions = positions;
+        buffer->capacity = capacity;
+    }
+    
+    buffer->positions[buffer->count] = MKMapPointForCoordinate(CLLocationCoordinate2DMake(latitude, longitude));
+    buffer->count++;
+    return YES;
+}
+
+static const char* SGReadHistory(const char* p, const char* end, SGPositionBuffer* buffer, SGTimeBuffer* timeBuffer)
+{
+    if(p >= end || *p != '{')
+        return NULL;
+    
+    p = SGSkipSpace(p + 1, end);
+    if(p < end && *p == '}')
+        return p + 1;
+    
+    while(p) {
+        const char* key;
+        NSUInteger keyLength;
+        p = SGReadKey(p, end, &key, &keyLength);
+        if(!p)
+            return NULL;
+        
+        if(*p == '[' && SGKeyEquals(key, keyLength, "geometries"))
+            p = SGReadGeometries(p, end, buffer, timeBuffer);
+        else
+            p = SGSkipValue(p, end, 1);
+        
+        p = p ? SGSkipSpace(p, end) : NULL;
+        if(!p || p >= end)
+            return NULL;
+        
+        if(*p == '}')
+            return p + 1;
+        
+        p = *p == ',' ? SGSkipSpace(p + 1, end) : NULL;
+    }
+    
+    return NULL;
+}
+
+static const char* SGReadGeometries(const char* p, const char* end, SGPositionBuffer* buffer, SGTimeBuffer* timeBuffer)
+{
+    p = SGSkipSpace(p + 1, end);
+    if(p < end && *p == ']')
+        return p + 1;
+    
+    while(p && p < end) {
+        if(*p == '{')
+            p = SGReadGeometry(p, end, buffer, timeBuffer);
+        else
+            p = SGSkipValue(p, end, 2);
+        
+        p = p ? SGSkipSpace(p, end) : NULL;
+        if(!p || p >= end)
+            return NULL;
+        
+        if(*p == ']')
+            return p + 1;
+        
+        p = *p == ',' ? SGSkipSpace(p + 1, end) : NULL;
+    }
+    
+    return NULL;
+}
+
+static const char* SGReadGeometry(const char* p, const char* end, SGPositionBuffer* buffer, SGTimeBuffer* timeBuffer)
+{
+    NSUInteger first = buffer->count;
+    BOOL hasCreated = NO;
+    double created = 0.0;
+    
+    // The created value can come before or after the coordinates, so the
+    // times are only filled in once the whole geometry has been read.
+    p = SGSkipSpace(p + 1, end);
+    BOOL empty = p < end && *p == '}';
+    while(p && !empty) {
+        const char* key;
+        NSUInteger keyLength;
+        p = SGReadKey(p, end, &key, &keyLength);
+        if(!p)
+            return NULL;
+        
+        if(*p == '[' && SGKeyEquals(key, keyLength, "coordinates"))
+            p = SGReadArray(p, end, buffer, 0);
+        else if((*p == '-' || (*p >= '0' && *p <= '9')) && SGKeyEquals(key, keyLength, "created")) {
+            p = SGReadNumber(p, end, &created);
+            hasCreated = YES;
+        } else
+            p = SGSkipValue(p, end, 3);
+        
+        p = p ? SGSkipSpace(p, end) : NULL;
+        if(!p || p >= end)
+            return NULL;
+        
+        if(*p == '}')
+            break;
+        
+        p = *p == ',' ? SGSkipSpace(p + 1, end) : NULL;
+    }
+    
+    if(!p || p >= end)
+        return NULL;
+    
+    if(buffer->count > first) {
+        if(timeBuffer->capacity < buffer->capacity) {
+            NSTimeInterval* times = realloc(timeBuffer->times, sizeof(NSTimeInterval) * buffer->capacity);
+            if(!times)
+                return NULL;
+            
+            timeBuffer->times = times;
+            timeBuffer->capacity = buffer->capacity;
+        }
+        
+        if(hasCreated)
+            timeBuffer->lastTime = created;
+        
+        for(NSUInteger i = first; i < buffer->count; i++)
+            timeBuffer->times[i] = timeBuffer->lastTime;
+    }
+    
+    return p + 1;
+}
+
+static const char* SGReadKey(const char* p, const char* end, const char** key, NSUInteger* keyLength)
+{
+    if(p >= end || *p != '"')
+        return NULL;
+    
+    *key = p + 1;
+    p = SGSkipString(p, end);
+    if(!p)
+        return NULL;
+    
+    *keyLength = p - *key - 1;
+    p = SGSkipSpace(p, end);
+    if(p >= end || *p != ':')
+        return NULL;
+    
+    p = SGSkipSpace(p + 1, end);
+    return p < end ? p : NULL;
+}
+
+static inline BOOL SGKeyEquals(const char* key, NSUInteger keyLength, const char* name)
+{
+    return keyLength == strlen(name) && !memcmp(key, name, keyLength);
+}
+
+static const char* SGSkipValue(const char* p, const char* end, int depth)
+{
+    if(p >= end || depth >= kSGGeoJSONCoordinates_MaxSkippedDepth)
+        return NULL;
+    
+    if(*p == '"')
+        return SGSkipString(p, end);
+    
+    if(*p == '-' || (*p >= '0' && *p <= '9')) {
+        double value;
+        return SGReadNumber(p, end, &value);
+    }
+    
+    if(*p != '{' && *p != '[') {
+        static const char* literals[] = {"true", "false", "null"};
+        for(int i = 0; i < 3; i++) {
+            NSUInteger literalLength = strlen(literals[i]);
+            if((NSUInteger)(end - p) >= literalLength && !memcmp(p, literals[i], literalLength))
+                return p + literalLength;
+        }
+        
+        return NULL;
+    }
+    
+    BOOL object = *p == '{';
+    char close = object ? '}' : ']';
+    p = SGSkipSpace(p + 1, end);
+    if(p < end && *p == close)
+        return p + 1;
+    
+    while(p) {
+        if(object) {
+            const char* key;
+            NSUInteger keyLength;
+            p = SGReadKey(p, end, &key, &keyLength);
+        }
+        
+        p = p ? SGSkipValue(p, end, depth + 1) : NULL;
+        p = p ? SGSkipSpace(p, end) : NULL;
+        if(!p || p >= end)
+            return NULL;
+        
+        if(*p == close)
+            return p + 1;
+        
+        p = *p == ',' ? SGSkipSpace(p + 1, end) : NULL;
+    }
+    
+    return NULL;
+}
+
+static const char* SGReadNumber(const char* p, const char* end, double* value)
+{
+    const char* start = p;
+    BOOL negative = p < end && *p == '-';
+    if(negative)
+        p++;
+    
+    // The digits are gathered into an integer and a power of ten. Digits past
+    // the 19th can not change a double and are only counted.
+    uint64_t mantissa = 0;
+    int digitCount = 0;
+    int exponent = 0;
+    const char* digits = p;
+    for(; p < end && *p >= '0' && *p <= '9'; p++) {
+        if(digitCount < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            digitCount += mantissa != 0;
+        } else
+            exponent++;
+    }
+    
+    if(p == digits)
+        return NULL;
+    
+    if(p < end && *p == '.') {
+        digits = ++p;
+        for(; p < end && *p >= '0' && *p <= '9'; p++)
+            if(digitCount < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                digitCount += mantissa != 0;
+                exponent--;
+            }
+        
+        if(p == digits)
+            return NULL;
+    }
+    
+    if(p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        BOOL negativeExponent = p < end && *p == '-';
+        if(p < end && (*p == '-' || *p == '+'))
+            p++;
+        
+        int explicitExponent = 0;
+        digits = p;
+        for(; p < end && *p >= '0' && *p <= '9'; p++)
+            explicitExponent = MIN(explicitExponent * 10 + (*p - '0'), 100000);
+        
+        if(p == digits)
+            return NULL;
+        
+        exponent += negativeExponent ? -explicitExponent : explicitExponent;
+    }
+    
+    // An integer of 53 bits and a power of ten up to 22 are both exact as
+    // doubles, so one multiplication or division rounds correctly.
+    if(mantissa <= kSGGeoJSONCoordinates_MaxExactMantissa && exponent >= -22 && exponent <= 22) {
+        double result = exponent < 0 ? mantissa / SGPowersOfTen[-exponent] : mantissa * SGPowersOfTen[exponent];
+        *value = negative ? -result : result;
+        return p;
+    }
+    
+    char text[64];
+    NSUInteger textLength = p - start;
+    char* copy = textLength < sizeof(text) ? text : malloc(textLength + 1);
+    memcpy(copy, start, textLength);
+    copy[textLength] = '\0';
+    *value = strtod_l(copy, NULL, NULL);
+    if(copy != text)
+        free(copy);
+    
+    return p;
+}
+
+static const char* SGSkipString(const char* p, const char* end)
+{
+    for(p++; p < end; p++) {
+        if(*p == '\\')
+            p++;
+        else if(*p == '"')
+            return p + 1;
+    }
+    
+    return NULL;
+}
+
+static inline const char* SGSkipSpace(const char* p, const char* end)
+{
+    while(p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t'))
+        p++;
+    
+    return p;
+}
@@ -0,0 +1,70 @@
+//
+//  SGGeoJSONEncoder+Patch.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import <Foundation/Foundation.h>
+
+/*!
+* @category SGGeoJSONEncoder (Patch)
+* @abstract Encodes only the properties of a record that changed since a
+* known version.
+*/
+@interface SGGeoJSONEncoder (Patch)
+
+/*!
+* @method changedPropertiesForRecordAnnotation:baselineProperties:
+* @abstract Diffs the properties of a record against a baseline.
+* @param recordAnnotation The record.
+* @param baselineProperties The properties SimpleGeo last acknowledged for the record.
+* @result The properties whose values differ from the baseline. Properties that
+* were removed map to NSNull.
+*/
++ (NSDictionary*) changedPropertiesForRecordAnnotation:(id<SGRecordAnnotation>)recordAnnotation baselineProperties:(NSDictionary*)baselineProperties;
+
+/*!
+* @method geoJSONPatchForRecordAnnotation:baselineProperties:
+* @abstract Creates the GeoJSON representation of a record that only carries
+* the changed properties.
+* @discussion The geometry and any top-level keys, including expires and
+* created, are always included. If
+* baselineProperties is nil, the full representation from
+* @link //simplegeo/ooc/clm/SGGeoJSONEncoder/geoJSONObjectForRecordAnnotation: geoJSONObjectForRecordAnnotation: @/link
+* is returned.
+* @param recordAnnotation The record.
+* @param baselineProperties The properties SimpleGeo last acknowledged for the record.
+* @result A GeoJSON Feature.
+*/
++ (NSMutableDictionary*) geoJSONPatchForRecordAnnotation:(id<SGRecordAnnotation>)recordAnnotation baselineProperties:(NSDictionary*)baselineProperties;
+
+@end
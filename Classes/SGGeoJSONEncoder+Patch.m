@@ -0,0 +1,87 @@
+//
+//  SGGeoJSONEncoder+Patch.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import "SGGeoJSONEncoder+Patch.h"
+
+@implementation SGGeoJSONEncoder (Patch)
+
++ (NSDictionary*) changedPropertiesForRecordAnnotation:(id<SGRecordAnnotation>)recordAnnotation baselineProperties:(NSDictionary*)baselineProperties
+{
+    NSDictionary* properties = [recordAnnotation respondsToSelector:@selector(properties)] ? [recordAnnotation properties] : nil;
+    NSMutableDictionary* changedProperties = [NSMutableDictionary dictionary];
+    
+    for(NSString* key in properties) {
+        id value = [properties objectForKey:key];
+        if(![value isEqual:[baselineProperties objectForKey:key]])
+            [changedProperties setObject:value forKey:key];
+    }
+    
+    for(NSString* key in baselineProperties)
+        if(![properties objectForKey:key])
+            [changedProperties setObject:[NSNull null] forKey:key];
+    
+    return changedProperties;
+}
+
++ (NSMutableDictionary*) geoJSONPatchForRecordAnnotation:(id<SGRecordAnnotation>)recordAnnotation baselineProperties:(NSDictionary*)baselineProperties
+{
+    NSMutableDictionary* geoJSONObject = [SGGeoJSONEncoder geoJSONObjectForRecordAnnotation:recordAnnotation];
+    if(!baselineProperties)
+        return geoJSONObject;
+    
+    // The encoder may add keys of its own (e.g. the record type) to the
+    // properties. Those are kept; only record properties that match the
+    // baseline are dropped.
+    NSMutableDictionary* patchProperties = [NSMutableDictionary dictionaryWithDictionary:[geoJSONObject properties]];
+    NSDictionary* properties = [recordAnnotation respondsToSelector:@selector(properties)] ? [recordAnnotation properties] : nil;
+    NSDictionary* changedProperties = [self changedPropertiesForRecordAnnotation:recordAnnotation baselineProperties:baselineProperties];
+    for(NSString* key in properties)
+        if(![changedProperties objectForKey:key])
+            [patchProperties removeObjectForKey:key];
+    
+    [patchProperties addEntriesFromDictionary:changedProperties];
+    [geoJSONObject setProperties:patchProperties];
+    
+    // The timestamps are not properties, so they always go out with the patch.
+    if([recordAnnotation respondsToSelector:@selector(expires)])
+        [geoJSONObject setExpires:[recordAnnotation expires]];
+    
+    if([recordAnnotation respondsToSelector:@selector(created)])
+        [geoJSONObject setCreated:[recordAnnotation created]];
+    
+    return geoJSONObject;
+}
+
+@end
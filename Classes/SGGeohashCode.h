@@ -0,0 +1,142 @@
+//
+//  SGGeohashCode.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import <Foundation/Foundation.h>
+#import <CoreLocation/CoreLocation.h>
+
+/*!
+* @defined kSGGeohashCode_MaxPrecision
+* @abstract The longest geohash that fits into an @link SGGeohashCode SGGeohashCode @/link.
+*/
+#define kSGGeohashCode_MaxPrecision         12
+
+/*!
+* @typedef SGGeohashCode
+* @abstract The bits of a geohash. A geohash of precision p uses the lowest
+* 5p bits, longitude and latitude bits interleaved starting with the
+* longitude, exactly like the characters of its string form.
+* @discussion Codes are compared and sorted like their strings as long as
+* they share a precision. The string is only built by
+* @link SGGeohashCodeToString SGGeohashCodeToString @/link.
+*/
+typedef uint64_t SGGeohashCode;
+
+/*!
+* @function SGGeohashCodeMake(double, double, int)
+* @abstract Encodes a coordinate.
+* @param latitude The latitude.
+* @param longitude The longitude.
+* @param precision The amount of characters, from 1 to
+* @link kSGGeohashCode_MaxPrecision kSGGeohashCode_MaxPrecision @/link.
+* @result The code of the cell that contains the coordinate.
+*/
+extern SGGeohashCode SGGeohashCodeMake(double latitude, double longitude, int precision);
+
+/*!
+* @function SGGeohashCodeMakeBatch(const CLLocationCoordinate2D*, NSUInteger, int, SGGeohashCode*)
+* @abstract Encodes many coordinates with the same precision.
+* @param coordinates The coordinates.
+* @param count The amount of coordinates.
+* @param precision The amount of characters.
+* @param codes Receives count codes.
+*/
+extern void SGGeohashCodeMakeBatch(const CLLocationCoordinate2D* coordinates, NSUInteger count, int precision, SGGeohashCode* codes);
+
+/*!
+* @function SGGeohashCodeGetCenter(SGGeohashCode, int)
+* @result The center of the cell.
+*/
+extern CLLocationCoordinate2D SGGeohashCodeGetCenter(SGGeohashCode code, int precision);
+
+/*!
+* @function SGGeohashCodeGetCenterBatch(const SGGeohashCode*, NSUInteger, int, CLLocationCoordinate2D*)
+* @abstract Decodes many codes with the same precision to the centers of
+* their cells.
+* @param coordinates Receives count coordinates.
+*/
+extern void SGGeohashCodeGetCenterBatch(const SGGeohashCode* codes, NSUInteger count, int precision, CLLocationCoordinate2D* coordinates);
+
+/*!
+* @function SGGeohashCodeMakeWithCell(uint32_t, uint32_t, int)
+* @abstract Builds the code of a cell from its column and row.
+* @discussion A geohash of precision p has 2^ceil(5p / 2) columns from west to
+* east and 2^floor(5p / 2) rows from south to north.
+*/
+extern SGGeohashCode SGGeohashCodeMakeWithCell(uint32_t column, uint32_t row, int precision);
+
+/*!
+* @function SGGeohashCodeGetCell(SGGeohashCode, int, uint32_t*, uint32_t*)
+* @abstract Splits a code into the column and row of its cell.
+*/
+extern void SGGeohashCodeGetCell(SGGeohashCode code, int precision, uint32_t* column, uint32_t* row);
+
+/*!
+* @function SGGeohashCodeGetCString(SGGeohashCode, int, char*)
+* @abstract Writes the base32 form of a code without creating any object.
+* @param buffer Has room for precision + 1 characters.
+*/
+extern void SGGeohashCodeGetCString(SGGeohashCode code, int precision, char* buffer);
+
+/*!
+* @function SGGeohashCodeToString(SGGeohashCode, int)
+* @result The base32 form of a code.
+*/
+extern NSString* SGGeohashCodeToString(SGGeohashCode code, int precision);
+
+/*!
+* @function SGGeohashCodeFromString(NSString*, SGGeohashCode*, int*)
+* @abstract Parses the base32 form of a geohash.
+* @result NO if the string is empty, too long or not a geohash.
+*/
+extern BOOL SGGeohashCodeFromString(NSString* string, SGGeohashCode* code, int* precision);
+
+/*!
+* @function SGGeohashCodeToGeohash(SGGeohashCode, int)
+* @result An @link //simplegeo/ooc/tag/SGGeohash SGGeohash @/link at the
+* center of the cell, for the queries of the SDK.
+*/
+extern SGGeohash SGGeohashCodeToGeohash(SGGeohashCode code, int precision);
+
+/*!
+* @function SGGeohashSpreadBits(uint32_t)
+* @abstract Moves bit i of a value to bit 2i.
+*/
+extern uint64_t SGGeohashSpreadBits(uint32_t value);
+
+/*!
+* @function SGGeohashCompactBits(uint64_t)
+* @abstract Moves bit 2i of a value to bit i, dropping the odd bits.
+*/
+extern uint32_t SGGeohashCompactBits(uint64_t bits);
@@ -0,0 +1,217 @@
+//
+//  SGGeohashCode.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import "SGGeohashCode.h"
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+static const char SGGeohashBase32[] = "0123456789bcdefghjkmnpqrstuvwxyz";
+
+// The bits of a geohash alternate between longitude and latitude, starting
+// with the longitude, so the longitude gets the extra bit of an odd count.
+#define SGGeohashLongitudeBits(precision)   ((5 * (precision) + 1) / 2)
+#define SGGeohashLatitudeBits(precision)    ((5 * (precision)) / 2)
+
+static inline uint64_t SGSpreadBits(uint32_t value)
+{
+#if defined(__BMI2__)
+    return _pdep_u64(value, 0x5555555555555555ULL);
+#else
+    uint64_t bits = value;
+    bits = (bits | (bits << 16)) & 0x0000FFFF0000FFFFULL;
+    bits = (bits | (bits << 8)) & 0x00FF00FF00FF00FFULL;
+    bits = (bits | (bits << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    bits = (bits | (bits << 2)) & 0x3333333333333333ULL;
+    bits = (bits | (bits << 1)) & 0x5555555555555555ULL;
+    return bits;
+#endif
+}
+
+static inline uint32_t SGCompactBits(uint64_t bits)
+{
+#if defined(__BMI2__)
+    return (uint32_t)_pext_u64(bits, 0x5555555555555555ULL);
+#else
+    bits &= 0x5555555555555555ULL;
+    bits = (bits | (bits >> 1)) & 0x3333333333333333ULL;
+    bits = (bits | (bits >> 2)) & 0x0F0F0F0F0F0F0F0FULL;
+    bits = (bits | (bits >> 4)) & 0x00FF00FF00FF00FFULL;
+    bits = (bits | (bits >> 8)) & 0x0000FFFF0000FFFFULL;
+    bits = (bits | (bits >> 16)) & 0x00000000FFFFFFFFULL;
+    return (uint32_t)bits;
+#endif
+}
+
+static inline SGGeohashCode SGInterleave(uint32_t column, uint32_t row, int precision)
+{
+    // The longitude owns the top bit, which is odd for an even bit count.
+    if((5 * precision) & 1)
+        return SGSpreadBits(column) | (SGSpreadBits(row) << 1);
+    else
+        return (SGSpreadBits(column) << 1) | SGSpreadBits(row);
+}
+
+static inline void SGDeinterleave(SGGeohashCode code, int precision, uint32_t* column, uint32_t* row)
+{
+    if((5 * precision) & 1) {
+        *column = SGCompactBits(code);
+        *row = SGCompactBits(code >> 1);
+    } else {
+        *column = SGCompactBits(code >> 1);
+        *row = SGCompactBits(code);
+    }
+}
+
+static inline uint32_t SGQuantize(double value, double scale, uint32_t maxValue)
+{
+    double scaled = value * scale;
+    if(!(scaled > 0.0))
+        return 0;
+    
+    return scaled >= (double)maxValue ? maxValue : (uint32_t)scaled;
+}
+
+SGGeohashCode SGGeohashCodeMake(double latitude, double longitude, int precision)
+{
+    CLLocationCoordinate2D coordinate = {latitude, longitude};
+    SGGeohashCode code;
+    SGGeohashCodeMakeBatch(&coordinate, 1, precision, &code);
+    return code;
+}
+
+void SGGeohashCodeMakeBatch(const CLLocationCoordinate2D* coordinates, NSUInteger count, int precision, SGGeohashCode* codes)
+{
+    precision = MIN(MAX(precision, 1), kSGGeohashCode_MaxPrecision);
+    
+    // Bisecting a range k times is the same as cutting it into 2^k equal
+    // cells, so each axis is a single multiplication.
+    uint32_t maxColumn = (uint32_t)((1ULL << SGGeohashLongitudeBits(precision)) - 1);
+    uint32_t maxRow = (uint32_t)((1ULL << SGGeohashLatitudeBits(precision)) - 1);
+    double longitudeScale = ((double)maxColumn + 1.0) / 360.0;
+    double latitudeScale = ((double)maxRow + 1.0) / 180.0;
+    
+    for(NSUInteger i = 0; i < count; i++) {
+        uint32_t column = SGQuantize(coordinates[i].longitude + 180.0, longitudeScale, maxColumn);
+        uint32_t row = SGQuantize(coordinates[i].latitude + 90.0, latitudeScale, maxRow);
+        codes[i] = SGInterleave(column, row, precision);
+    }
+}
+
+CLLocationCoordinate2D SGGeohashCodeGetCenter(SGGeohashCode code, int precision)
+{
+    CLLocationCoordinate2D coordinate;
+    SGGeohashCodeGetCenterBatch(&code, 1, precision, &coordinate);
+    return coordinate;
+}
+
+void SGGeohashCodeGetCenterBatch(const SGGeohashCode* codes, NSUInteger count, int precision, CLLocationCoordinate2D* coordinates)
+{
+    precision = MIN(MAX(precision, 1), kSGGeohashCode_MaxPrecision);
+    
+    double width = 360.0 / (double)(1ULL << SGGeohashLongitudeBits(precision));
+    double height = 180.0 / (double)(1ULL << SGGeohashLatitudeBits(precision));
+    for(NSUInteger i = 0; i < count; i++) {
+        uint32_t column, row;
+        SGDeinterleave(codes[i], precision, &column, &row);
+        coordinates[i].latitude = ((double)row + 0.5) * height - 90.0;
+        coordinates[i].longitude = ((double)column + 0.5) * width - 180.0;
+    }
+}
+
+SGGeohashCode SGGeohashCodeMakeWithCell(uint32_t column, uint32_t row, int precision)
+{
+    return SGInterleave(column, row, precision);
+}
+
+void SGGeohashCodeGetCell(SGGeohashCode code, int precision, uint32_t* column, uint32_t* row)
+{
+    SGDeinterleave(code, precision, column, row);
+}
+
+void SGGeohashCodeGetCString(SGGeohashCode code, int precision, char* buffer)
+{
+    for(int i = precision - 1; i >= 0; i--) {
+        buffer[i] = SGGeohashBase32[code & 0x1F];
+        code >>= 5;
+    }
+    
+    buffer[precision] = '\0';
+}
+
+NSString* SGGeohashCodeToString(SGGeohashCode code, int precision)
+{
+    char buffer[kSGGeohashCode_MaxPrecision + 1];
+    SGGeohashCodeGetCString(code, MIN(MAX(precision, 1), kSGGeohashCode_MaxPrecision), buffer);
+    return [NSString stringWithUTF8String:buffer];
+}
+
+BOOL SGGeohashCodeFromString(NSString* string, SGGeohashCode* code, int* precision)
+{
+    NSUInteger length = [string length];
+    if(!length || length > kSGGeohashCode_MaxPrecision)
+        return NO;
+    
+    SGGeohashCode bits = 0;
+    for(NSUInteger i = 0; i < length; i++) {
+        unichar character = [string characterAtIndex:i];
+        const char* digit = character && character < 0x80 ? strchr(SGGeohashBase32, tolower(character)) : NULL;
+        if(!digit)
+            return NO;
+        
+        bits = (bits << 5) | (SGGeohashCode)(digit - SGGeohashBase32);
+    }
+    
+    *code = bits;
+    *precision = (int)length;
+    return YES;
+}
+
+SGGeohash SGGeohashCodeToGeohash(SGGeohashCode code, int precision)
+{
+    CLLocationCoordinate2D center = SGGeohashCodeGetCenter(code, precision);
+    return SGGeohashMake(center.latitude, center.longitude, precision);
+}
+
+uint64_t SGGeohashSpreadBits(uint32_t value)
+{
+    return SGSpreadBits(value);
+}
+
+uint32_t SGGeohashCompactBits(uint64_t bits)
+{
+    return SGCompactBits(bits);
+}
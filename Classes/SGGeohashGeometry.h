@@ -0,0 +1,158 @@
+//
+//  SGGeohashGeometry.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import <Foundation/Foundation.h>
+#import <CoreLocation/CoreLocation.h>
+
+#import "SGGeohashCode.h"
+
+/*!
+* @defined kSGGeohashGeometry_ChildCount
+* @abstract The amount of children of a cell.
+*/
+#define kSGGeohashGeometry_ChildCount       32
+
+/*!
+* @struct SGGeohashCell
+* @abstract A geohash cell of any precision.
+* @field code The bits of the geohash.
+* @field precision The amount of characters.
+*/
+typedef struct {
+
+    SGGeohashCode code;
+    int precision;
+
+} SGGeohashCell;
+
+/*!
+* @function SGGeohashCellMake(SGGeohashCode, int)
+* @abstract Creates a new SGGeohashCell structure.
+*/
+extern SGGeohashCell SGGeohashCellMake(SGGeohashCode code, int precision);
+
+/*!
+* @function SGGeohashCellGetEnvelope(SGGeohashCell)
+* @result The bounds of the cell.
+*/
+extern SGEnvelope SGGeohashCellGetEnvelope(SGGeohashCell cell);
+
+/*!
+* @function SGGeohashCellGetParent(SGGeohashCell, SGGeohashCell*)
+* @abstract Finds the cell that is one character shorter.
+* @result NO for a cell of precision 1.
+*/
+extern BOOL SGGeohashCellGetParent(SGGeohashCell cell, SGGeohashCell* parent);
+
+/*!
+* @function SGGeohashCellGetChildren(SGGeohashCell, SGGeohashCell*)
+* @abstract Finds the cells that are one character longer.
+* @param children Receives @link kSGGeohashGeometry_ChildCount kSGGeohashGeometry_ChildCount @/link cells.
+* @result NO for a cell of @link kSGGeohashCode_MaxPrecision kSGGeohashCode_MaxPrecision @/link.
+*/
+extern BOOL SGGeohashCellGetChildren(SGGeohashCell cell, SGGeohashCell* children);
+
+/*!
+* @function SGGeohashCellGetNeighbor(SGGeohashCell, int, int, SGGeohashCell*)
+* @abstract Finds the cell a number of columns and rows away.
+* @discussion Columns wrap around the antimeridian. Rows stop at the poles.
+* @param columnOffset The amount of columns to the east.
+* @param rowOffset The amount of rows to the north.
+* @result NO if the cell would be past a pole.
+*/
+extern BOOL SGGeohashCellGetNeighbor(SGGeohashCell cell, int columnOffset, int rowOffset, SGGeohashCell* neighbor);
+
+/*!
+* @function SGGeohashCellGetNeighbors(SGGeohashCell, SGGeohashCell*)
+* @abstract Finds the cells around a cell, starting north and going clockwise.
+* @discussion A cell in the first or last row has no neighbors past the pole,
+* so only five are returned.
+* @param neighbors Has room for 8 cells.
+* @result The amount of neighbors.
+*/
+extern NSUInteger SGGeohashCellGetNeighbors(SGGeohashCell cell, SGGeohashCell* neighbors);
+
+/*!
+* @function SGGeohashPrecisionForEnvelope(SGEnvelope, NSUInteger)
+* @result The highest precision whose cells cover the envelope with no more
+* than maxCellCount cells, or 1.
+*/
+extern int SGGeohashPrecisionForEnvelope(SGEnvelope envelope, NSUInteger maxCellCount);
+
+/*!
+* @function SGGeohashCellsForEnvelope(SGEnvelope, int, SGGeohashCell*, NSUInteger)
+* @abstract Lists the cells of one precision that intersect an envelope, row
+* by row from south to north.
+* @discussion An envelope whose west is greater than its east crosses the
+* antimeridian.
+* @param cells Receives up to maxCellCount cells. Can be NULL.
+* @result The amount of cells that intersect the envelope, which may be more
+* than maxCellCount.
+*/
+extern NSUInteger SGGeohashCellsForEnvelope(SGEnvelope envelope, int precision, SGGeohashCell* cells, NSUInteger maxCellCount);
+
+/*!
+* @function SGGeohashCoverEnvelope(SGEnvelope, NSUInteger, int, SGGeohashCell*)
+* @abstract Covers an envelope with cells of mixed precision.
+* @discussion The cover starts with the finest grid that fits and then
+* splits the largest cells that are only partly inside the envelope, as long
+* as the count stays within maxCellCount. Cells that are inside the envelope
+* are never split.
+*
+* An envelope that needs more than maxCellCount cells of precision 1 still
+* gets all of them.
+* @param maxPrecision The longest cells to use.
+* @param cells Has room for MAX(maxCellCount, 32) cells.
+* @result The amount of cells.
+*/
+extern NSUInteger SGGeohashCoverEnvelope(SGEnvelope envelope, NSUInteger maxCellCount, int maxPrecision, SGGeohashCell* cells);
+
+/*!
+* @function SGGeohashCoverRadius(CLLocationCoordinate2D, CLLocationDistance, NSUInteger, int, SGGeohashCell*)
+* @abstract Covers a circle with cells of mixed precision.
+* @discussion Works like @link SGGeohashCoverEnvelope SGGeohashCoverEnvelope @/link
+* but leaves out cells that only touch the bounds of the circle. A circle
+* that reaches a pole covers every longitude.
+* @param radius The radius (expressed in meters).
+* @result The amount of cells.
+*/
+extern NSUInteger SGGeohashCoverRadius(CLLocationCoordinate2D center, CLLocationDistance radius, NSUInteger maxCellCount, int maxPrecision, SGGeohashCell* cells);
+
+/*!
+* @function SGEnvelopeForRadius(CLLocationCoordinate2D, CLLocationDistance)
+* @result The bounds of a circle. The envelope crosses the antimeridian when
+* the circle does.
+*/
+extern SGEnvelope SGEnvelopeForRadius(CLLocationCoordinate2D center, CLLocationDistance radius);
@@ -0,0 +1,373 @@
+//
+//  SGGeohashGeometry.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import "SGGeohashGeometry.h"
+
+#define kSGGeohashGeometry_EarthRadius      6371009.0
+#define kSGGeohashGeometry_Precision1Count  32
+
+typedef struct {
+
+    double south;
+    double north;
+    double west;
+    double east;
+    
+    BOOL circle;
+    CLLocationCoordinate2D center;
+    double radius;
+
+} SGCoverShape;
+
+static void SGCellSize(int precision, double* width, double* height);
+static void SGCellRangeForEnvelope(SGEnvelope envelope, int precision, long* firstColumn, long* columns, long* firstRow, long* rows);
+static SGCoverShape SGCoverShapeMake(SGEnvelope envelope);
+static BOOL SGCoverShapeIntersectsEnvelope(const SGCoverShape* shape, SGEnvelope envelope);
+static BOOL SGCoverShapeContainsEnvelope(const SGCoverShape* shape, SGEnvelope envelope);
+static NSUInteger SGCover(const SGCoverShape* shape, SGEnvelope envelope, NSUInteger maxCellCount, int maxPrecision, SGGeohashCell* cells);
+static double SGDistance(double latitude, double longitude, double otherLatitude, double otherLongitude);
+static double SGDistanceToMeridian(CLLocationCoordinate2D coordinate, double longitude, double south, double north);
+
+SGGeohashCell SGGeohashCellMake(SGGeohashCode code, int precision)
+{
+    SGGeohashCell cell = {code, precision};
+    return cell;
+}
+
+SGEnvelope SGGeohashCellGetEnvelope(SGGeohashCell cell)
+{
+    double width, height;
+    uint32_t column, row;
+    SGCellSize(cell.precision, &width, &height);
+    SGGeohashCodeGetCell(cell.code, cell.precision, &column, &row);
+    
+    return SGEnvelopeMake(row * height - 90.0, column * width - 180.0, (row + 1) * height - 90.0, (column + 1) * width - 180.0);
+}
+
+BOOL SGGeohashCellGetParent(SGGeohashCell cell, SGGeohashCell* parent)
+{
+    if(cell.precision <= 1)
+        return NO;
+    
+    *parent = SGGeohashCellMake(cell.code >> 5, cell.precision - 1);
+    return YES;
+}
+
+BOOL SGGeohashCellGetChildren(SGGeohashCell cell, SGGeohashCell* children)
+{
+    if(cell.precision >= kSGGeohashCode_MaxPrecision)
+        return NO;
+    
+    for(int i = 0; i < kSGGeohashGeometry_ChildCount; i++)
+        children[i] = SGGeohashCellMake((cell.code << 5) | (SGGeohashCode)i, cell.precision + 1);
+    
+    return YES;
+}
+
+BOOL SGGeohashCellGetNeighbor(SGGeohashCell cell, int columnOffset, int rowOffset, SGGeohashCell* neighbor)
+{
+    long totalColumns = 1L << ((5 * cell.precision + 1) / 2);
+    long totalRows = 1L << ((5 * cell.precision) / 2);
+    
+    uint32_t column, row;
+    SGGeohashCodeGetCell(cell.code, cell.precision, &column, &row);
+    
+    long neighborRow = (long)row + rowOffset;
+    if(neighborRow < 0 || neighborRow >= totalRows)
+        return NO;
+    
+    long neighborColumn = (((long)column + columnOffset) % totalColumns + totalColumns) % totalColumns;
+    *neighbor = SGGeohashCellMake(SGGeohashCodeMakeWithCell((uint32_t)neighborColumn, (uint32_t)neighborRow, cell.precision),
+                                  cell.precision);
+    return YES;
+}
+
+NSUInteger SGGeohashCellGetNeighbors(SGGeohashCell cell, SGGeohashCell* neighbors)
+{
+    static const int offsets[8][2] = {{0, 1}, {1, 1}, {1, 0}, {1, -1}, {0, -1}, {-1, -1}, {-1, 0}, {-1, 1}};
+    
+    NSUInteger count = 0;
+    for(int i = 0; i < 8; i++)
+        if(SGGeohashCellGetNeighbor(cell, offsets[i][0], offsets[i][1], &neighbors[count]))
+            count++;
+    
+    return count;
+}
+
+int SGGeohashPrecisionForEnvelope(SGEnvelope envelope, NSUInteger maxCellCount)
+{
+    int precision = 1;
+    for(int p = 1; p <= kSGGeohashCode_MaxPrecision; p++) {
+        long firstColumn, columns, firstRow, rows;
+        SGCellRangeForEnvelope(envelope, p, &firstColumn, &columns, &firstRow, &rows);
+        if(columns * rows > (long)maxCellCount)
+            break;
+        
+        precision = p;
+    }
+    
+    return precision;
+}
+
+NSUInteger SGGeohashCellsForEnvelope(SGEnvelope envelope, int precision, SGGeohashCell* cells, NSUInteger maxCellCount)
+{
+    long firstColumn, columns, firstRow, rows;
+    SGCellRangeForEnvelope(envelope, precision, &firstColumn, &columns, &firstRow, &rows);
+    
+    // Columns past the antimeridian wrap around to the other side.
+    long totalColumns = 1L << ((5 * precision + 1) / 2);
+    NSUInteger count = 0;
+    for(long row = firstRow; row < firstRow + rows; row++)
+        for(long column = firstColumn; column < firstColumn + columns; column++) {
+            if(cells && count < maxCellCount) {
+                long wrappedColumn = ((column % totalColumns) + totalColumns) % totalColumns;
+                cells[count] = SGGeohashCellMake(SGGeohashCodeMakeWithCell((uint32_t)wrappedColumn, (uint32_t)row, precision), precision);
+            }
+            
+            count++;
+        }
+    
+    return count;
+}
+
+NSUInteger SGGeohashCoverEnvelope(SGEnvelope envelope, NSUInteger maxCellCount, int maxPrecision, SGGeohashCell* cells)
+{
+    SGCoverShape shape = SGCoverShapeMake(envelope);
+    return SGCover(&shape, envelope, maxCellCount, maxPrecision, cells);
+}
+
+NSUInteger SGGeohashCoverRadius(CLLocationCoordinate2D center, CLLocationDistance radius, NSUInteger maxCellCount, int maxPrecision, SGGeohashCell* cells)
+{
+    SGEnvelope envelope = SGEnvelopeForRadius(center, radius);
+    SGCoverShape shape = SGCoverShapeMake(envelope);
+    shape.circle = YES;
+    shape.center = center;
+    shape.radius = radius;
+    
+    return SGCover(&shape, envelope, maxCellCount, maxPrecision, cells);
+}
+
+SGEnvelope SGEnvelopeForRadius(CLLocationCoordinate2D center, CLLocationDistance radius)
+{
+    double angle = MAX(radius, 0.0) / kSGGeohashGeometry_EarthRadius;
+    double south = center.latitude - angle * 180.0 / M_PI;
+    double north = center.latitude + angle * 180.0 / M_PI;
+    if(south <= -90.0 || north >= 90.0)
+        return SGEnvelopeMake(MAX(south, -90.0), -180.0, MIN(north, 90.0), 180.0);
+    
+    // The widest part of the circle is not on the parallel of its center, so
+    // the longitude span comes from the tangent great circles.
+    double ratio = sin(angle) / cos(center.latitude * M_PI / 180.0);
+    if(ratio >= 1.0)
+        return SGEnvelopeMake(south, -180.0, north, 180.0);
+    
+    double span = asin(ratio) * 180.0 / M_PI;
+    double west = center.longitude - span;
+    double east = center.longitude + span;
+    if(west < -180.0)
+        west += 360.0;
+    
+    if(east > 180.0)
+        east -= 360.0;
+    
+    return SGEnvelopeMake(south, west, north, east);
+}
+
+static void SGCellSize(int precision, double* width, double* height)
+{
+    int bits = 5 * precision;
+    *width = 360.0 / (double)(1ULL << ((bits + 1) / 2));
+    *height = 180.0 / (double)(1ULL << (bits / 2));
+}
+
+static void SGCellRangeForEnvelope(SGEnvelope envelope, int precision, long* firstColumn, long* columns, long* firstRow, long* rows)
+{
+    double width, height;
+    SGCellSize(precision, &width, &height);
+    
+    double west = envelope.west;
+    double east = envelope.east < envelope.west ? envelope.east + 360.0 : envelope.east;
+    double south = MIN(MAX(envelope.south, -90.0), 90.0);
+    double north = MIN(MAX(envelope.north, -90.0), 90.0);
+    
+    long totalColumns = 1L << ((5 * precision + 1) / 2);
+    long totalRows = 1L << ((5 * precision) / 2);
+    *firstColumn = (long)floor((west + 180.0) / width);
+    *columns = MIN((long)floor((east + 180.0) / width) - *firstColumn + 1, totalColumns);
+    *firstRow = MIN((long)floor((south + 90.0) / height), totalRows - 1);
+    *rows = MAX(MIN((long)floor((north + 90.0) / height), totalRows - 1) - *firstRow + 1, 0);
+}
+
+static SGCoverShape SGCoverShapeMake(SGEnvelope envelope)
+{
+    // The longitudes are unwrapped so the envelope is one interval.
+    SGCoverShape shape;
+    shape.south = MAX(envelope.south, -90.0);
+    shape.north = MIN(envelope.north, 90.0);
+    shape.west = envelope.west;
+    shape.east = envelope.east < envelope.west ? envelope.east + 360.0 : envelope.east;
+    shape.circle = NO;
+    shape.radius = 0.0;
+    return shape;
+}
+
+static BOOL SGCoverShapeIntersectsEnvelope(const SGCoverShape* shape, SGEnvelope envelope)
+{
+    if(envelope.south > shape->north || envelope.north < shape->south)
+        return NO;
+    
+    BOOL intersects = NO;
+    for(int i = -1; i <= 1 && !intersects; i++)
+        intersects = envelope.west + 360.0 * i <= shape->east && envelope.east + 360.0 * i >= shape->west;
+    
+    if(!intersects || !shape->circle)
+        return intersects;
+    
+    // Within the longitudes of the cell the closest point is on the same
+    // meridian. Otherwise it is on the west or east edge, which are parts of
+    // great circles.
+    CLLocationCoordinate2D center = shape->center;
+    BOOL insideLongitudes = NO;
+    for(int i = -1; i <= 1 && !insideLongitudes; i++)
+        insideLongitudes = center.longitude >= envelope.west + 360.0 * i && center.longitude <= envelope.east + 360.0 * i;
+    
+    double distance;
+    if(insideLongitudes)
+        distance = SGDistance(center.latitude, center.longitude, MIN(MAX(center.latitude, envelope.south), envelope.north), center.longitude);
+    else
+        distance = MIN(SGDistanceToMeridian(center, envelope.west, envelope.south, envelope.north),
+                       SGDistanceToMeridian(center, envelope.east, envelope.south, envelope.north));
+    
+    return distance <= shape->radius;
+}
+
+static BOOL SGCoverShapeContainsEnvelope(const SGCoverShape* shape, SGEnvelope envelope)
+{
+    if(envelope.south < shape->south || envelope.north > shape->north)
+        return NO;
+    
+    BOOL contains = shape->east - shape->west >= 360.0;
+    for(int i = -1; i <= 1 && !contains; i++)
+        contains = envelope.west + 360.0 * i >= shape->west && envelope.east + 360.0 * i <= shape->east;
+    
+    if(!contains || !shape->circle)
+        return contains;
+    
+    double radius = shape->radius;
+    CLLocationCoordinate2D center = shape->center;
+    return SGDistance(center.latitude, center.longitude, envelope.south, envelope.west) <= radius &&
+        SGDistance(center.latitude, center.longitude, envelope.south, envelope.east) <= radius &&
+        SGDistance(center.latitude, center.longitude, envelope.north, envelope.west) <= radius &&
+        SGDistance(center.latitude, center.longitude, envelope.north, envelope.east) <= radius;
+}
+
+static NSUInteger SGCover(const SGCoverShape* shape, SGEnvelope envelope, NSUInteger maxCellCount, int maxPrecision, SGGeohashCell* cells)
+{
+    if(!maxCellCount)
+        return 0;
+    
+    maxPrecision = MIN(MAX(maxPrecision, 1), kSGGeohashCode_MaxPrecision);
+    int precision = MIN(SGGeohashPrecisionForEnvelope(envelope, maxCellCount), maxPrecision);
+    NSUInteger capacity = MAX(maxCellCount, kSGGeohashGeometry_Precision1Count);
+    NSUInteger gridCount = MIN(SGGeohashCellsForEnvelope(envelope, precision, cells, capacity), capacity);
+    
+    NSUInteger count = 0;
+    for(NSUInteger i = 0; i < gridCount; i++)
+        if(SGCoverShapeIntersectsEnvelope(shape, SGGeohashCellGetEnvelope(cells[i])))
+            cells[count++] = cells[i];
+    
+    // Splitting the largest cells first keeps the cover even. A cell stays
+    // as it is once it is inside the shape or its children do not fit.
+    BOOL* finished = calloc(capacity, sizeof(BOOL));
+    SGGeohashCell children[kSGGeohashGeometry_ChildCount];
+    while(YES) {
+        NSUInteger next = NSNotFound;
+        for(NSUInteger i = 0; i < count; i++)
+            if(!finished[i] && cells[i].precision < maxPrecision && (next == NSNotFound || cells[i].precision < cells[next].precision))
+                next = i;
+        
+        if(next == NSNotFound)
+            break;
+        
+        finished[next] = YES;
+        if(SGCoverShapeContainsEnvelope(shape, SGGeohashCellGetEnvelope(cells[next])))
+            continue;
+        
+        SGGeohashCellGetChildren(cells[next], children);
+        NSUInteger childCount = 0;
+        for(int i = 0; i < kSGGeohashGeometry_ChildCount; i++)
+            if(SGCoverShapeIntersectsEnvelope(shape, SGGeohashCellGetEnvelope(children[i])))
+                children[childCount++] = children[i];
+        
+        if(!childCount || count - 1 + childCount > maxCellCount)
+            continue;
+        
+        cells[next] = children[0];
+        finished[next] = NO;
+        for(NSUInteger i = 1; i < childCount; i++) {
+            finished[count] = NO;
+            cells[count++] = children[i];
+        }
+    }
+    
+    free(finished);
+    return count;
+}
+
+static double SGDistanceToMeridian(CLLocationCoordinate2D coordinate, double longitude, double south, double north)
+{
+    // The closest point of the whole meridian, moved onto the edge. Past a
+    // quarter turn of longitude the closest point is the nearer pole.
+    double radians = M_PI / 180.0;
+    double longitudeDelta = (longitude - coordinate.longitude) * radians;
+    double latitude;
+    if(cos(longitudeDelta) > 0.0)
+        latitude = atan(tan(coordinate.latitude * radians) / cos(longitudeDelta)) / radians;
+    else
+        latitude = coordinate.latitude >= 0.0 ? 90.0 : -90.0;
+    
+    latitude = MIN(MAX(latitude, south), north);
+    return SGDistance(coordinate.latitude, coordinate.longitude, latitude, longitude);
+}
+
+static double SGDistance(double latitude, double longitude, double otherLatitude, double otherLongitude)
+{
+    double radians = M_PI / 180.0;
+    double latitudeDelta = (otherLatitude - latitude) * radians;
+    double longitudeDelta = (otherLongitude - longitude) * radians;
+    double a = sin(latitudeDelta / 2.0) * sin(latitudeDelta / 2.0) +
+        cos(latitude * radians) * cos(otherLatitude * radians) * sin(longitudeDelta / 2.0) * sin(longitudeDelta / 2.0);
+    return 2.0 * kSGGeohashGeometry_EarthRadius * atan2(sqrt(a), sqrt(MAX(1.0 - a, 0.0)));
+}
@@ -0,0 +1,189 @@
+//
+//  SGHistoryLoader.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import <Foundation/Foundation.h>
+
+#import "SGTimedRecordLine.h"
+
+@protocol SGHistoryLoaderDelegate;
+
+/*!
+* @class SGHistoryLoader
+* @abstract Loads the history of many records into
+* @link //simplegeo/ooc/cl/SGRecordLine SGRecordLines @/link.
+* @discussion Records are queued with
+* @link loadHistoryForRecordAnnotations: loadHistoryForRecordAnnotations: @/link
+* and no more than @link maxRequestsInFlight maxRequestsInFlight @/link
+* @link //simplegeo/ooc/cl/SGHistoryQuery SGHistoryQuery @/link requests are
+* out at any time. The next_cursor of every page is followed automatically,
+* and the next page of a track goes ahead of records that have not been
+* started so tracks complete one after the other. A record that already has
+* a history is not requested; its line is built from the history and only
+* the pages after it are loaded.
+*
+* Each page is decoded off the main thread into a single coordinate buffer
+* and added with one
+* @link //simplegeo/ooc/instm/SGTimedRecordLine/addCoordinates:times:count: addCoordinates:times:count: @/link
+* call, so the line takes its lock once per page.
+*
+* A page that is still in its JSON form can be added with
+* @link loadHistoryData:forRecordAnnotation: loadHistoryData:forRecordAnnotation: @/link,
+* which reads the points straight from the bytes. Pages requested through
+* SGLocationService never are, since the SDK parses every response before
+* handing it out, so nothing in the app calls it.
+*
+* The lines are @link //simplegeo/ooc/cl/SGTimedRecordLine SGTimedRecordLines @/link
+* and share the time window set with
+* @link setWindowStartTime:endTime: setWindowStartTime:endTime: @/link.
+*/
+@interface SGHistoryLoader : NSObject <SGLocationServiceDelegate> {
+
+    id<SGHistoryLoaderDelegate> delegate;
+    NSInteger maxRequestsInFlight;
+    NSInteger pageLimit;
+    NSInteger maxPages;
+    BOOL releasesHistory;
+    
+    @private
+    NSTimeInterval windowStartTime;
+    NSTimeInterval windowEndTime;
+    
+    NSMutableDictionary* recordLines;
+    NSMutableDictionary* pageCounts;
+    NSMutableArray* pendingQueries;
+    NSMutableDictionary* queryResponseIds;
+    
+    dispatch_queue_t decodeQueue;
+}
+
+@property (nonatomic, assign) id<SGHistoryLoaderDelegate> delegate;
+
+/*!
+* @property
+* @abstract The amount of history requests that can be out at once. The
+* default is 4.
+*/
+@property (nonatomic, assign) NSInteger maxRequestsInFlight;
+
+/*!
+* @property
+* @abstract The amount of points requested with each page. The default is 100.
+*/
+@property (nonatomic, assign) NSInteger pageLimit;
+
+/*!
+* @property
+* @abstract The most pages loaded for a single record. The default is 0, which
+* pages until the server stops returning a cursor.
+*/
+@property (nonatomic, assign) NSInteger maxPages;
+
+/*!
+* @property
+* @abstract Sets @link //simplegeo/ooc/instp/SGTimedRecordLine/releasesHistory releasesHistory @/link
+* on the lines that are built from the history a record already has. The
+* default is NO.
+*/
+@property (nonatomic, assign) BOOL releasesHistory;
+
+/*!
+* @method loadHistoryForRecordAnnotations:
+* @abstract Queues the records whose history is not loaded or loading yet.
+*/
+- (void) loadHistoryForRecordAnnotations:(NSArray*)recordAnnotations;
+
+/*!
+* @method loadHistoryData:forRecordAnnotation:
+* @abstract Adds a history page that is still in its JSON form, such as one
+* that was saved to disk, to the line of a record.
+* @discussion The page is read off the main thread with
+* @link SGGeoJSONCopyHistoryMapPoints SGGeoJSONCopyHistoryMapPoints @/link,
+* so no objects are made for its geometries. A record that gets its line
+* this way is not requested by
+* @link loadHistoryForRecordAnnotations: loadHistoryForRecordAnnotations: @/link.
+* @param data The GeometryCollection of the page.
+*/
+- (void) loadHistoryData:(NSData*)data forRecordAnnotation:(id<SGHistoricRecordAnnoation>)recordAnnotation;
+
+/*!
+* @method recordLineForRecordAnnotation:
+* @result The line of a record, or nil if its history was never requested.
+*/
+- (SGRecordLine*) recordLineForRecordAnnotation:(id<SGHistoricRecordAnnoation>)recordAnnotation;
+
+/*!
+* @method removeRecordAnnotations:
+* @abstract Stops loading the history of the records and forgets their lines.
+*/
+- (void) removeRecordAnnotations:(NSArray*)recordAnnotations;
+
+/*!
+* @method setWindowStartTime:endTime:
+* @abstract Moves the time window of every line. The delegate is told about
+* the part of each line that has to be redrawn.
+* @param startTime The beginning of the window, or 0 for no beginning.
+* @param endTime The end of the window, or 0 for no end.
+*/
+- (void) setWindowStartTime:(NSTimeInterval)startTime endTime:(NSTimeInterval)endTime;
+
+/*!
+* @method cancel
+* @abstract Stops loading. Responses for requests that are already out are ignored.
+*/
+- (void) cancel;
+
+@end
+
+/*!
+* @protocol SGHistoryLoaderDelegate
+* @abstract Receives the lines that are built by a @link SGHistoryLoader SGHistoryLoader @/link.
+*/
+@protocol SGHistoryLoaderDelegate <NSObject>
+
+/*!
+* @method historyLoader:didLoadRecordLine:
+* @abstract Called on the main thread once the first page of a record has
+* been added to its line.
+*/
+- (void) historyLoader:(SGHistoryLoader*)loader didLoadRecordLine:(SGRecordLine*)recordLine;
+
+/*!
+* @method historyLoader:didUpdateRecordLine:mapRect:
+* @abstract Called on the main thread when a later page has been added.
+* @param mapRect The part of the map covered by the new points.
+*/
+- (void) historyLoader:(SGHistoryLoader*)loader didUpdateRecordLine:(SGRecordLine*)recordLine mapRect:(MKMapRect)mapRect;
+
+@end
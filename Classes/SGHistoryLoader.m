@@ -0,0 +1,349 @@
+//
+//  SGHistoryLoader.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import "SGHistoryLoader.h"
+#import "SGGeoJSONCoordinates.h"
+
+@interface SGHistoryLoader (Private)
+
+- (void) sendQueries;
+- (void) loadHistory:(NSDictionary*)history forRecordAnnotation:(id<SGHistoricRecordAnnoation>)recordAnnotation;
+- (void) receivedPage:(NSDictionary*)geoJSONObject forQuery:(SGHistoryQuery*)query;
+- (void) deliverRecordLine:(SGRecordLine*)recordLine mapRect:(MKMapRect)mapRect firstPage:(BOOL)firstPage;
+
+- (SGTimedRecordLine*) recordLineWithRecordAnnotation:(id<SGHistoricRecordAnnoation>)recordAnnotation;
+- (NSInteger) countPageForRecordId:(NSString*)recordId;
+
+- (NSString*) cursorForGeoJSONObject:(NSDictionary*)geoJSONObject;
+
+@end
+
+@implementation SGHistoryLoader
+@synthesize delegate, maxRequestsInFlight, pageLimit, maxPages, releasesHistory;
+
+- (id) init
+{
+    if(self = [super init]) {
+        delegate = nil;
+        maxRequestsInFlight = 4;
+        pageLimit = 100;
+        maxPages = 0;
+        releasesHistory = NO;
+        windowStartTime = 0.0;
+        windowEndTime = 0.0;
+        
+        recordLines = [[NSMutableDictionary alloc] init];
+        pageCounts = [[NSMutableDictionary alloc] init];
+        pendingQueries = [[NSMutableArray alloc] init];
+        queryResponseIds = [[NSMutableDictionary alloc] init];
+        
+        decodeQueue = dispatch_queue_create("com.simplegeo.layerupdater.historyloader", NULL);
+        
+        [[SGLocationService sharedLocationService] addDelegate:self];
+    }
+    
+    return self;
+}
+
+- (void) loadHistoryForRecordAnnotations:(NSArray*)recordAnnotations
+{
+    for(id<SGHistoricRecordAnnoation> recordAnnotation in recordAnnotations) {
+        NSString* recordId = [recordAnnotation recordId];
+        if(!recordId || [recordLines objectForKey:recordId])
+            continue;
+        
+        NSDictionary* history = [recordAnnotation history];
+        if([history isKindOfClass:[NSDictionary class]]) {
+            [self loadHistory:history forRecordAnnotation:recordAnnotation];
+            continue;
+        }
+        
+        [self recordLineWithRecordAnnotation:recordAnnotation];
+        
+        SGHistoryQuery* query = [[SGHistoryQuery alloc] initWithRecord:recordAnnotation];
+        if(pageLimit > 0)
+            query.limit = pageLimit;
+        
+        [pendingQueries addObject:query];
+        [query release];
+    }
+    
+    [self sendQueries];
+}
+
+- (void) loadHistoryData:(NSData*)data forRecordAnnotation:(id<SGHistoricRecordAnnoation>)recordAnnotation
+{
+    NSString* recordId = [recordAnnotation recordId];
+    if(!recordId || !data)
+        return;
+    
+    SGTimedRecordLine* recordLine = [recordLines objectForKey:recordId];
+    if(!recordLine)
+        recordLine = [self recordLineWithRecordAnnotation:recordAnnotation];
+    
+    BOOL firstPage = [self countPageForRecordId:recordId] == 1;
+    [recordLine retain];
+    dispatch_async(decodeQueue, ^{
+        NSUInteger count = 0;
+        NSTimeInterval* times = NULL;
+        MKMapPoint* mapPoints = SGGeoJSONCopyHistoryMapPoints([data bytes], [data length], &times, &count);
+        MKMapRect mapRect = [recordLine addMapPoints:mapPoints times:times count:count];
+        free(mapPoints);
+        free(times);
+        
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self deliverRecordLine:recordLine mapRect:mapRect firstPage:firstPage];
+            [recordLine release];
+        });
+    });
+}
+
+- (SGRecordLine*) recordLineForRecordAnnotation:(id<SGHistoricRecordAnnoation>)recordAnnotation
+{
+    NSString* recordId = [recordAnnotation recordId];
+    return recordId ? [recordLines objectForKey:recordId] : nil;
+}
+
+- (void) removeRecordAnnotations:(NSArray*)recordAnnotations
+{
+    NSMutableSet* recordIds = [NSMutableSet setWithCapacity:[recordAnnotations count]];
+    for(id<SGHistoricRecordAnnoation> recordAnnotation in recordAnnotations)
+        if([recordAnnotation recordId])
+            [recordIds addObject:[recordAnnotation recordId]];
+    
+    NSMutableArray* removedQueries = [NSMutableArray array];
+    for(SGHistoryQuery* query in pendingQueries)
+        if([recordIds containsObject:query.recordId])
+            [removedQueries addObject:query];
+    
+    [pendingQueries removeObjectsInArray:removedQueries];
+    
+    // Requests that are out still count against the limit until they come
+    // back, but their pages are dropped.
+    [recordLines removeObjectsForKeys:[recordIds allObjects]];
+    [pageCounts removeObjectsForKeys:[recordIds allObjects]];
+}
+
+- (void) setWindowStartTime:(NSTimeInterval)startTime endTime:(NSTimeInterval)endTime
+{
+    windowStartTime = startTime;
+    windowEndTime = endTime;
+    
+    for(SGTimedRecordLine* recordLine in [recordLines allValues]) {
+        MKMapRect mapRect = [recordLine setWindowStartTime:startTime endTime:endTime];
+        if(!MKMapRectIsNull(mapRect))
+            [delegate historyLoader:self didUpdateRecordLine:recordLine mapRect:mapRect];
+    }
+}
+
+- (void) cancel
+{
+    [pendingQueries removeAllObjects];
+    [queryResponseIds removeAllObjects];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark SGLocationService delegate methods 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (void) locationService:(SGLocationService*)service succeededForResponseId:(NSString*)requestId responseObject:(NSObject*)responseObject
+{
+    dispatch_async(dispatch_get_main_queue(), ^{
+        SGHistoryQuery* query = [[queryResponseIds objectForKey:requestId] retain];
+        if(query) {
+            [queryResponseIds removeObjectForKey:requestId];
+            [self receivedPage:(NSDictionary*)responseObject forQuery:query];
+            [self sendQueries];
+            [query release];
+        }
+    });
+}
+
+- (void) locationService:(SGLocationService*)service failedForResponseId:(NSString*)requestId error:(NSError*)error
+{
+    // A track that fails to load keeps the points it already has.
+    dispatch_async(dispatch_get_main_queue(), ^{
+        if([queryResponseIds objectForKey:requestId]) {
+            [queryResponseIds removeObjectForKey:requestId];
+            [self sendQueries];
+        }
+    });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Paging 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (void) sendQueries
+{
+    SGLocationService* locationService = [SGLocationService sharedLocationService];
+    while([pendingQueries count] && [queryResponseIds count] < maxRequestsInFlight) {
+        SGHistoryQuery* query = [[pendingQueries objectAtIndex:0] retain];
+        [pendingQueries removeObjectAtIndex:0];
+        
+        NSString* requestId = [locationService history:query];
+        if(requestId)
+            [queryResponseIds setObject:query forKey:requestId];
+        
+        [query release];
+    }
+}
+
+- (void) receivedPage:(NSDictionary*)geoJSONObject forQuery:(SGHistoryQuery*)query
+{
+    SGTimedRecordLine* recordLine = [recordLines objectForKey:query.recordId];
+    if(!recordLine)
+        return;
+    
+    NSInteger pageCount = [self countPageForRecordId:query.recordId];
+    
+    // The next page of this track is queued ahead of the records that have
+    // not been started.
+    NSString* cursor = [self cursorForGeoJSONObject:geoJSONObject];
+    if(cursor && (!maxPages || pageCount < maxPages)) {
+        SGHistoryQuery* nextQuery = [[SGHistoryQuery alloc] initWithRecord:recordLine.recordAnnotation];
+        nextQuery.limit = query.limit;
+        nextQuery.cursor = cursor;
+        [pendingQueries insertObject:nextQuery atIndex:0];
+        [nextQuery release];
+    }
+    
+    BOOL firstPage = pageCount == 1;
+    [recordLine retain];
+    dispatch_async(decodeQueue, ^{
+        NSArray* geometries = [geoJSONObject isKindOfClass:[NSDictionary class]] ? [geoJSONObject geometries] : nil;
+        MKMapRect mapRect = [recordLine addGeometries:geometries];
+        
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self deliverRecordLine:recordLine mapRect:mapRect firstPage:firstPage];
+            [recordLine release];
+        });
+    });
+}
+
+- (void) loadHistory:(NSDictionary*)history forRecordAnnotation:(id<SGHistoricRecordAnnoation>)recordAnnotation
+{
+    SGTimedRecordLine* recordLine = [self recordLineWithRecordAnnotation:recordAnnotation];
+    recordLine.releasesHistory = releasesHistory;
+    
+    // The history counts as the first page. Its cursor is read before the
+    // line gets a chance to release it.
+    NSInteger pageCount = [self countPageForRecordId:[recordAnnotation recordId]];
+    NSString* cursor = [self cursorForGeoJSONObject:history];
+    if(cursor && (!maxPages || pageCount < maxPages)) {
+        SGHistoryQuery* query = [[SGHistoryQuery alloc] initWithRecord:recordAnnotation];
+        if(pageLimit > 0)
+            query.limit = pageLimit;
+        
+        query.cursor = cursor;
+        [pendingQueries addObject:query];
+        [query release];
+    }
+    
+    [recordLine retain];
+    dispatch_async(decodeQueue, ^{
+        [recordLine reloadAnnotation];
+        
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self deliverRecordLine:recordLine mapRect:MKMapRectNull firstPage:YES];
+            [recordLine release];
+        });
+    });
+}
+
+- (void) deliverRecordLine:(SGRecordLine*)recordLine mapRect:(MKMapRect)mapRect firstPage:(BOOL)firstPage
+{
+    NSString* recordId = [recordLine.recordAnnotation recordId];
+    if([recordLines objectForKey:recordId] != recordLine)
+        return;
+    
+    if(firstPage)
+        [delegate historyLoader:self didLoadRecordLine:recordLine];
+    else if(!MKMapRectIsNull(mapRect))
+        [delegate historyLoader:self didUpdateRecordLine:recordLine mapRect:mapRect];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Utility methods 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (SGTimedRecordLine*) recordLineWithRecordAnnotation:(id<SGHistoricRecordAnnoation>)recordAnnotation
+{
+    SGTimedRecordLine* recordLine = [[SGTimedRecordLine alloc] initWithRecordAnnoation:recordAnnotation];
+    [recordLine setWindowStartTime:windowStartTime endTime:windowEndTime];
+    [recordLines setObject:recordLine forKey:[recordAnnotation recordId]];
+    [recordLine release];
+    
+    return recordLine;
+}
+
+- (NSInteger) countPageForRecordId:(NSString*)recordId
+{
+    NSInteger pageCount = [[pageCounts objectForKey:recordId] integerValue] + 1;
+    [pageCounts setObject:[NSNumber numberWithInteger:pageCount] forKey:recordId];
+    
+    return pageCount;
+}
+
+- (NSString*) cursorForGeoJSONObject:(NSDictionary*)geoJSONObject
+{
+    NSString* cursor = nil;
+    if([geoJSONObject isKindOfClass:[NSDictionary class]]) {
+        cursor = [geoJSONObject objectForKey:@"next_cursor"];
+        if(![cursor isKindOfClass:[NSString class]] || ![cursor length])
+            cursor = nil;
+    }
+    
+    return cursor;
+}
+
+- (void) dealloc
+{
+    [[SGLocationService sharedLocationService] removeDelegate:self];
+    
+    [recordLines release];
+    [pageCounts release];
+    [pendingQueries release];
+    [queryResponseIds release];
+    
+    dispatch_release(decodeQueue);
+    
+    [super dealloc];
+}
+
+@end
@@ -0,0 +1,91 @@
+//
+//  SGLayerExporter.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import <Foundation/Foundation.h>
+
+#import "SGNearbyPager.h"
+
+@protocol SGLayerExporterDelegate;
+
+/*!
+* @class SGLayerExporter
+* @abstract Pages the records of a layer out to an NDJSON file.
+* @discussion Every record returned by the query is written as one GeoJSON
+* feature per line, which is the format @link //simplegeo/ooc/cl/SGLayerImporter SGLayerImporter @/link
+* reads back. Pages are fetched with a @link SGNearbyPager SGNearbyPager @/link
+* and written on a background queue.
+*/
+@interface SGLayerExporter : NSObject <SGNearbyPagerDelegate> {
+
+    id<SGLayerExporterDelegate> delegate;
+    
+    @private
+    SGNearbyPager* pager;
+    NSString* path;
+    NSFileHandle* fileHandle;
+    dispatch_queue_t writeQueue;
+    
+    NSInteger recordsExported;
+    NSDate* startDate;
+}
+
+@property (nonatomic, assign) id<SGLayerExporterDelegate> delegate;
+@property (nonatomic, readonly) NSString* path;
+@property (nonatomic, readonly) NSInteger recordsExported;
+
+/*!
+* @method initWithLayer:query:path:
+* @param layer The layer to export.
+* @param query The nearby query that selects the records. Its limit is used as the page size.
+* @param path The file to write. It is replaced if it exists.
+*/
+- (id) initWithLayer:(SGLayer*)layer query:(SGNearbyQuery*)query path:(NSString*)path;
+
+- (void) start;
+- (void) cancel;
+
+- (double) recordsPerSecond;
+
+@end
+
+@protocol SGLayerExporterDelegate <NSObject>
+
+- (void) layerExporter:(SGLayerExporter*)exporter failedWithError:(NSError*)error;
+- (void) layerExporterDidFinish:(SGLayerExporter*)exporter;
+
+@optional
+- (void) layerExporter:(SGLayerExporter*)exporter didExportRecords:(NSInteger)count;
+
+@end
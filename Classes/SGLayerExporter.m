@@ -0,0 +1,167 @@
+//
+//  SGLayerExporter.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import "SGLayerExporter.h"
+#import "SGJSON.h"
+
+@interface SGLayerExporter (Private)
+
+- (void) closeFile;
+
+@end
+
+@implementation SGLayerExporter
+@synthesize delegate, path, recordsExported;
+
+- (id) initWithLayer:(SGLayer*)layer query:(SGNearbyQuery*)query path:(NSString*)newPath
+{
+    if(self = [super init]) {
+        pager = [[SGNearbyPager alloc] initWithLayer:layer query:query];
+        pager.delegate = self;
+        path = [newPath retain];
+        
+        fileHandle = nil;
+        writeQueue = dispatch_queue_create("com.simplegeo.layerupdater.exporter", NULL);
+        startDate = nil;
+    }
+    
+    return self;
+}
+
+- (void) start
+{
+    if(!pager.paging) {
+        [[NSFileManager defaultManager] createFileAtPath:path contents:nil attributes:nil];
+        fileHandle = [[NSFileHandle fileHandleForWritingAtPath:path] retain];
+        if(!fileHandle) {
+            NSError* error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileWriteUnknownError
+                                             userInfo:[NSDictionary dictionaryWithObject:path forKey:NSFilePathErrorKey]];
+            [delegate layerExporter:self failedWithError:error];
+            return;
+        }
+        
+        recordsExported = 0;
+        [startDate release];
+        startDate = [[NSDate alloc] init];
+        
+        [pager start];
+    }
+}
+
+- (void) cancel
+{
+    [pager cancel];
+    [self closeFile];
+}
+
+- (double) recordsPerSecond
+{
+    NSTimeInterval elapsed = startDate ? -[startDate timeIntervalSinceNow] : 0.0;
+    return elapsed > 0.0 ? recordsExported / elapsed : 0.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark SGNearbyPager delegate methods 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (void) nearbyPager:(SGNearbyPager*)nearbyPager didLoadRecordAnnotations:(NSArray*)recordAnnotations page:(NSInteger)page
+{
+    recordsExported += [recordAnnotations count];
+    
+    NSFileHandle* pageFileHandle = fileHandle;
+    dispatch_async(writeQueue, ^{
+        NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+        CJSONSerializer* serializer = [CJSONSerializer serializer];
+        NSMutableString* lines = [NSMutableString string];
+        for(id<SGRecordAnnotation> recordAnnotation in recordAnnotations) {
+            [lines appendString:[serializer serializeObject:[SGGeoJSONEncoder geoJSONObjectForRecordAnnotation:recordAnnotation]]];
+            [lines appendString:@"\n"];
+        }
+        
+        [pageFileHandle writeData:[lines dataUsingEncoding:NSUTF8StringEncoding]];
+        [pool release];
+    });
+    
+    if([delegate respondsToSelector:@selector(layerExporter:didExportRecords:)])
+        [delegate layerExporter:self didExportRecords:recordsExported];
+}
+
+- (void) nearbyPager:(SGNearbyPager*)nearbyPager failedWithError:(NSError*)error
+{
+    [self closeFile];
+    [delegate layerExporter:self failedWithError:error];
+}
+
+- (void) nearbyPagerDidFinish:(SGNearbyPager*)nearbyPager
+{
+    [self closeFile];
+    [delegate layerExporterDidFinish:self];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Utility methods 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (void) closeFile
+{
+    if(fileHandle) {
+        // Pages that are still being written hold on to the handle until they are done.
+        NSFileHandle* pageFileHandle = fileHandle;
+        fileHandle = nil;
+        dispatch_sync(writeQueue, ^{
+            [pageFileHandle closeFile];
+        });
+        
+        [pageFileHandle release];
+    }
+}
+
+- (void) dealloc
+{
+    [self cancel];
+    
+    pager.delegate = nil;
+    [pager release];
+    [path release];
+    [startDate release];
+    
+    dispatch_release(writeQueue);
+    
+    [super dealloc];
+}
+
+@end
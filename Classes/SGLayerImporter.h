@@ -0,0 +1,166 @@
+//
+//  SGLayerImporter.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import <Foundation/Foundation.h>
+#import <libkern/OSAtomic.h>
+
+@protocol SGLayerImporterDelegate;
+
+enum SGLayerImportFormat {
+    kSGLayerImportFormat_NDJSON = 0,
+    kSGLayerImportFormat_FeatureCollection
+};
+
+typedef NSInteger SGLayerImportFormat;
+
+/*!
+* @class SGLayerImporter
+* @abstract Streams a GeoJSON file from disk into a layer.
+* @discussion The file is read in chunks and split into features without
+* loading it into memory. Batches of features are parsed, validated and turned
+* into records on @link workerCount workerCount @/link worker threads and sent with
+* @link //simplegeo/ooc/instm/SGLocationService/updateRecordAnnotations: updateRecordAnnotations: @/link.
+* Reading stops while @link maxBatchesInFlight maxBatchesInFlight @/link batches
+* are waiting on the server.
+*
+* After every acknowledged batch the byte offset up to which all features have
+* been stored is written to a checkpoint file next to the input. Calling
+* @link start start @/link again after an interruption picks up from there.
+*/
+@interface SGLayerImporter : NSObject <SGLocationServiceDelegate> {
+
+    id<SGLayerImporterDelegate> delegate;
+    SGLayerImportFormat format;
+    NSInteger batchSize;
+    NSInteger maxBatchesInFlight;
+    NSInteger workerCount;
+    
+    @private
+    SGLayer* layer;
+    NSString* path;
+    NSString* checkpointPath;
+    
+    NSOperationQueue* encodeQueue;
+    dispatch_queue_t readQueue;
+    dispatch_semaphore_t windowSemaphore;
+    
+    NSMutableDictionary* batchesInFlight;
+    NSMutableDictionary* batchEndOffsets;
+    NSInteger nextBatchSequence;
+    NSInteger readBatchCount;
+    NSInteger nextCheckpointSequence;
+    unsigned long long checkpointOffset;
+    volatile int32_t generation;
+    
+    NSInteger recordsImported;
+    NSInteger recordsRejected;
+    NSDate* startDate;
+    BOOL importing;
+    BOOL readerFinished;
+}
+
+@property (nonatomic, assign) id<SGLayerImporterDelegate> delegate;
+
+/*!
+* @property
+* @abstract The layout of the file. The default is picked from the file
+* extension; .ndjson and .geojsonl are read as NDJSON.
+*/
+@property (nonatomic, assign) SGLayerImportFormat format;
+
+/*!
+* @property
+* @abstract The amount of records sent with each request. The default is 100.
+*/
+@property (nonatomic, assign) NSInteger batchSize;
+
+/*!
+* @property
+* @abstract The amount of batches that can be encoded or sent without a
+* response. The default is 4.
+*/
+@property (nonatomic, assign) NSInteger maxBatchesInFlight;
+
+/*!
+* @property
+* @abstract The amount of threads that parse and encode features. The default is 2.
+*/
+@property (nonatomic, assign) NSInteger workerCount;
+
+@property (nonatomic, readonly) SGLayer* layer;
+@property (nonatomic, readonly) NSString* path;
+@property (nonatomic, readonly) NSInteger recordsImported;
+@property (nonatomic, readonly) NSInteger recordsRejected;
+@property (nonatomic, readonly, getter=isImporting) BOOL importing;
+
+- (id) initWithLayer:(SGLayer*)layer path:(NSString*)path;
+
+/*!
+* @method start
+* @abstract Starts importing from the last checkpoint, or from the beginning
+* of the file if there is none.
+*/
+- (void) start;
+
+/*!
+* @method cancel
+* @abstract Stops reading. The checkpoint is left in place.
+*/
+- (void) cancel;
+
+/*!
+* @method clearCheckpoint
+* @abstract Removes the checkpoint so the next import starts over.
+*/
+- (void) clearCheckpoint;
+
+/*!
+* @method recordsPerSecond
+* @result The amount of records acknowledged by the server per second since
+* @link start start @/link was called.
+*/
+- (double) recordsPerSecond;
+
+@end
+
+@protocol SGLayerImporterDelegate <NSObject>
+
+- (void) layerImporter:(SGLayerImporter*)importer failedWithError:(NSError*)error;
+- (void) layerImporterDidFinish:(SGLayerImporter*)importer;
+
+@optional
+- (void) layerImporter:(SGLayerImporter*)importer didImportRecords:(NSInteger)count checkpoint:(unsigned long long)offset;
+
+@end
@@ -0,0 +1,579 @@
+//
+//  SGLayerImporter.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import "SGLayerImporter.h"
+#import "SGJSON.h"
+
+#define kSGLayerImporter_ChunkSize          65536
+#define kSGLayerImporter_FeaturesKey        "features"
+
+typedef struct {
+    
+    NSInteger depth;
+    uint64_t arrayMask;
+    NSInteger featureDepth;
+    long long featureStart;
+    BOOL inString;
+    BOOL escaped;
+    
+    NSUInteger keyLength;
+    BOOL keyMatches;
+    BOOL featuresKey;
+    BOOL inFeatures;
+    
+} SGFeatureScanState;
+
+static void SGFeatureScanStateInit(SGFeatureScanState* state, SGLayerImportFormat format, BOOL resume);
+static BOOL SGFeatureScanNext(SGFeatureScanState* state, const unsigned char* bytes, NSUInteger length, NSUInteger* position,
+                              unsigned long long bufferOffset, long long* start, long long* end);
+static NSDictionary* SGValidatedFeature(NSDictionary* feature);
+
+@interface SGLayerImporter (Private)
+
+- (void) readFromOffset:(unsigned long long)offset generation:(int32_t)runGeneration;
+- (void) enqueueFeatures:(NSArray*)features endOffset:(unsigned long long)endOffset generation:(int32_t)runGeneration;
+- (void) sendRecordAnnotations:(NSArray*)recordAnnotations rejected:(NSInteger)rejected sequence:(NSInteger)sequence
+                     endOffset:(unsigned long long)endOffset generation:(int32_t)runGeneration;
+- (BOOL) isRunningGeneration:(int32_t)runGeneration;
+- (void) acknowledgeSequence:(NSInteger)sequence endOffset:(unsigned long long)endOffset count:(NSInteger)count;
+- (void) readerDidFinishWithBatchCount:(NSInteger)batchCount;
+- (void) finishIfDone;
+- (void) failWithError:(NSError*)error;
+
+- (unsigned long long) fileSize;
+- (unsigned long long) loadCheckpoint;
+- (void) saveCheckpoint;
+
+@end
+
+@implementation SGLayerImporter
+@synthesize delegate, format, batchSize, maxBatchesInFlight, workerCount, layer, path, recordsImported, recordsRejected, importing;
+
+- (id) initWithLayer:(SGLayer*)newLayer path:(NSString*)newPath
+{
+    if(self = [super init]) {
+        layer = [newLayer retain];
+        path = [newPath retain];
+        checkpointPath = [[path stringByAppendingPathExtension:@"checkpoint"] retain];
+        
+        NSString* extension = [[path pathExtension] lowercaseString];
+        if([extension isEqualToString:@"ndjson"] || [extension isEqualToString:@"geojsonl"])
+            format = kSGLayerImportFormat_NDJSON;
+        else
+            format = kSGLayerImportFormat_FeatureCollection;
+        
+        batchSize = 100;
+        maxBatchesInFlight = 4;
+        workerCount = 2;
+        
+        encodeQueue = [[NSOperationQueue alloc] init];
+        readQueue = dispatch_queue_create("com.simplegeo.layerupdater.importer", NULL);
+        windowSemaphore = NULL;
+        
+        batchesInFlight = [[NSMutableDictionary alloc] init];
+        batchEndOffsets = [[NSMutableDictionary alloc] init];
+        
+        startDate = nil;
+        generation = 0;
+        importing = NO;
+        readerFinished = YES;
+    }
+    
+    return self;
+}
+
+- (void) start
+{
+    if(importing || !readerFinished)
+        return;
+    
+    importing = YES;
+    readerFinished = NO;
+    
+    recordsImported = 0;
+    recordsRejected = 0;
+    readBatchCount = 0;
+    nextCheckpointSequence = 0;
+    [batchesInFlight removeAllObjects];
+    [batchEndOffsets removeAllObjects];
+    
+    [startDate release];
+    startDate = [[NSDate alloc] init];
+    
+    if(windowSemaphore)
+        dispatch_release(windowSemaphore);
+    windowSemaphore = dispatch_semaphore_create(maxBatchesInFlight);
+    encodeQueue.maxConcurrentOperationCount = workerCount;
+    
+    checkpointOffset = [self loadCheckpoint];
+    [[SGLocationService sharedLocationService] addDelegate:self];
+    
+    // Work that is still queued from a cancelled run carries an older
+    // generation and is dropped.
+    int32_t runGeneration = OSAtomicIncrement32Barrier(&generation);
+    unsigned long long offset = checkpointOffset;
+    dispatch_async(readQueue, ^{ [self readFromOffset:offset generation:runGeneration]; });
+}
+
+- (void) cancel
+{
+    if(importing) {
+        importing = NO;
+        OSAtomicIncrement32Barrier(&generation);
+        [encodeQueue cancelAllOperations];
+        [batchesInFlight removeAllObjects];
+        [[SGLocationService sharedLocationService] removeDelegate:self];
+        
+        // Wake the reader if it is waiting on the window.
+        for(NSInteger i = 0; i < maxBatchesInFlight; i++)
+            dispatch_semaphore_signal(windowSemaphore);
+    }
+}
+
+- (void) clearCheckpoint
+{
+    [[NSFileManager defaultManager] removeItemAtPath:checkpointPath error:nil];
+}
+
+- (double) recordsPerSecond
+{
+    NSTimeInterval elapsed = startDate ? -[startDate timeIntervalSinceNow] : 0.0;
+    return elapsed > 0.0 ? recordsImported / elapsed : 0.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Reading 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (void) readFromOffset:(unsigned long long)offset generation:(int32_t)runGeneration
+{
+    nextBatchSequence = 0;
+    
+    NSFileHandle* fileHandle = [NSFileHandle fileHandleForReadingAtPath:path];
+    if(!fileHandle) {
+        NSError* error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadNoSuchFileError
+                                         userInfo:[NSDictionary dictionaryWithObject:path forKey:NSFilePathErrorKey]];
+        dispatch_async(dispatch_get_main_queue(), ^{ [self failWithError:error]; [self readerDidFinishWithBatchCount:0]; });
+        return;
+    }
+    
+    [fileHandle seekToFileOffset:offset];
+    
+    SGFeatureScanState state;
+    SGFeatureScanStateInit(&state, format, offset > 0);
+    
+    NSMutableData* buffer = [[NSMutableData alloc] init];
+    unsigned long long bufferOffset = offset;
+    NSUInteger position = 0;
+    
+    NSMutableArray* features = [[NSMutableArray alloc] initWithCapacity:batchSize];
+    unsigned long long featuresEnd = offset;
+    
+    while([self isRunningGeneration:runGeneration]) {
+        NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+        NSData* chunk = [fileHandle readDataOfLength:kSGLayerImporter_ChunkSize];
+        if(![chunk length]) {
+            [pool release];
+            break;
+        }
+        
+        [buffer appendData:chunk];
+        
+        long long start, end;
+        while([self isRunningGeneration:runGeneration] && SGFeatureScanNext(&state, [buffer bytes], [buffer length], &position, bufferOffset, &start, &end)) {
+            [features addObject:[buffer subdataWithRange:NSMakeRange(start - bufferOffset, end - start)]];
+            featuresEnd = end;
+            
+            if([features count] >= batchSize) {
+                [self enqueueFeatures:features endOffset:featuresEnd generation:runGeneration];
+                [features release];
+                features = [[NSMutableArray alloc] initWithCapacity:batchSize];
+            }
+        }
+        
+        // Only the bytes of a feature that has not been closed yet are kept around.
+        NSUInteger consumed = state.featureStart < 0 ? [buffer length] : (NSUInteger)(state.featureStart - bufferOffset);
+        [buffer replaceBytesInRange:NSMakeRange(0, consumed) withBytes:NULL length:0];
+        bufferOffset += consumed;
+        position -= consumed;
+        
+        [pool release];
+    }
+    
+    if([self isRunningGeneration:runGeneration] && [features count])
+        [self enqueueFeatures:features endOffset:featuresEnd generation:runGeneration];
+    
+    [features release];
+    [buffer release];
+    [fileHandle closeFile];
+    
+    // The sequence is only touched on the read queue, so the main thread
+    // gets its final value along with the news that reading is over.
+    NSInteger batchCount = nextBatchSequence;
+    dispatch_async(dispatch_get_main_queue(), ^{ [self readerDidFinishWithBatchCount:batchCount]; });
+}
+
+- (void) enqueueFeatures:(NSArray*)features endOffset:(unsigned long long)endOffset generation:(int32_t)runGeneration
+{
+    dispatch_semaphore_wait(windowSemaphore, DISPATCH_TIME_FOREVER);
+    if(![self isRunningGeneration:runGeneration])
+        return;
+    
+    NSInteger sequence = nextBatchSequence++;
+    SGLayer* batchLayer = layer;
+    NSArray* batch = [features copy];
+    NSBlockOperation* operation = [NSBlockOperation blockOperationWithBlock:^{
+        CJSONDeserializer* deserializer = [CJSONDeserializer deserializer];
+        NSMutableArray* recordAnnotations = [NSMutableArray arrayWithCapacity:[batch count]];
+        NSInteger rejected = 0;
+        for(NSData* data in batch) {
+            NSDictionary* feature = SGValidatedFeature([deserializer deserialize:data error:nil]);
+            id<SGRecordAnnotation> recordAnnotation = feature ? [batchLayer recordAnnotationFromGeoJSONObject:feature] : nil;
+            if(recordAnnotation) {
+                if([(NSObject*)recordAnnotation isKindOfClass:[SGRecord class]])
+                    ((SGRecord*)recordAnnotation).layer = batchLayer.layerId;
+                
+                [recordAnnotations addObject:recordAnnotation];
+            } else
+                rejected++;
+        }
+        
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self sendRecordAnnotations:recordAnnotations rejected:rejected sequence:sequence endOffset:endOffset generation:runGeneration];
+        });
+    }];
+    
+    [batch release];
+    [encodeQueue addOperation:operation];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Sending 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (void) sendRecordAnnotations:(NSArray*)recordAnnotations rejected:(NSInteger)rejected sequence:(NSInteger)sequence
+                     endOffset:(unsigned long long)endOffset generation:(int32_t)runGeneration
+{
+    if(!importing || ![self isRunningGeneration:runGeneration])
+        return;
+    
+    recordsRejected += rejected;
+    if([recordAnnotations count]) {
+        NSString* requestId = [[SGLocationService sharedLocationService] updateRecordAnnotations:recordAnnotations];
+        NSArray* batch = [NSArray arrayWithObjects:
+                          [NSNumber numberWithInteger:sequence],
+                          [NSNumber numberWithUnsignedLongLong:endOffset],
+                          [NSNumber numberWithInteger:[recordAnnotations count]],
+                          nil];
+        [batchesInFlight setObject:batch forKey:requestId];
+    } else
+        [self acknowledgeSequence:sequence endOffset:endOffset count:0];
+}
+
+- (void) acknowledgeSequence:(NSInteger)sequence endOffset:(unsigned long long)endOffset count:(NSInteger)count
+{
+    recordsImported += count;
+    [batchEndOffsets setObject:[NSNumber numberWithUnsignedLongLong:endOffset] forKey:[NSNumber numberWithInteger:sequence]];
+    
+    // Batches can be acknowledged out of order. The checkpoint only moves
+    // past a batch once every batch before it has been stored as well.
+    BOOL advanced = NO;
+    NSNumber* nextOffset = nil;
+    while((nextOffset = [batchEndOffsets objectForKey:[NSNumber numberWithInteger:nextCheckpointSequence]])) {
+        checkpointOffset = [nextOffset unsignedLongLongValue];
+        [batchEndOffsets removeObjectForKey:[NSNumber numberWithInteger:nextCheckpointSequence]];
+        nextCheckpointSequence++;
+        advanced = YES;
+    }
+    
+    if(advanced) {
+        [self saveCheckpoint];
+        if([delegate respondsToSelector:@selector(layerImporter:didImportRecords:checkpoint:)])
+            [delegate layerImporter:self didImportRecords:recordsImported checkpoint:checkpointOffset];
+    }
+    
+    dispatch_semaphore_signal(windowSemaphore);
+    [self finishIfDone];
+}
+
+- (void) readerDidFinishWithBatchCount:(NSInteger)batchCount
+{
+    readBatchCount = batchCount;
+    readerFinished = YES;
+    [self finishIfDone];
+}
+
+- (void) finishIfDone
+{
+    if(importing && readerFinished && nextCheckpointSequence == readBatchCount) {
+        importing = NO;
+        [[SGLocationService sharedLocationService] removeDelegate:self];
+        [self clearCheckpoint];
+        [delegate layerImporterDidFinish:self];
+    }
+}
+
+- (BOOL) isRunningGeneration:(int32_t)runGeneration
+{
+    // importing is only touched on the main thread. The reader and the
+    // workers compare against the generation instead.
+    OSMemoryBarrier();
+    return generation == runGeneration;
+}
+
+- (void) failWithError:(NSError*)error
+{
+    if(importing) {
+        [self cancel];
+        [delegate layerImporter:self failedWithError:error];
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark SGLocationService delegate methods 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (void) locationService:(SGLocationService*)service succeededForResponseId:(NSString*)requestId responseObject:(NSObject*)responseObject
+{
+    dispatch_async(dispatch_get_main_queue(), ^{
+        NSArray* batch = [batchesInFlight objectForKey:requestId];
+        if(batch) {
+            [batch retain];
+            [batchesInFlight removeObjectForKey:requestId];
+            [self acknowledgeSequence:[[batch objectAtIndex:0] integerValue]
+                            endOffset:[[batch objectAtIndex:1] unsignedLongLongValue]
+                                count:[[batch objectAtIndex:2] integerValue]];
+            [batch release];
+        }
+    });
+}
+
+- (void) locationService:(SGLocationService*)service failedForResponseId:(NSString*)requestId error:(NSError*)error
+{
+    dispatch_async(dispatch_get_main_queue(), ^{
+        if([batchesInFlight objectForKey:requestId])
+            [self failWithError:error];
+    });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Checkpoint 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (unsigned long long) fileSize
+{
+    NSDictionary* attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:path error:nil];
+    return [attributes fileSize];
+}
+
+- (unsigned long long) loadCheckpoint
+{
+    unsigned long long offset = 0;
+    NSDictionary* checkpoint = [NSDictionary dictionaryWithContentsOfFile:checkpointPath];
+    if(checkpoint) {
+        // A checkpoint for a file that has since changed is worthless.
+        if([[checkpoint objectForKey:@"fileSize"] unsignedLongLongValue] == [self fileSize] &&
+           [[checkpoint objectForKey:@"format"] integerValue] == format)
+            offset = [[checkpoint objectForKey:@"offset"] unsignedLongLongValue];
+        else
+            [self clearCheckpoint];
+    }
+    
+    return offset;
+}
+
+- (void) saveCheckpoint
+{
+    NSDictionary* checkpoint = [NSDictionary dictionaryWithObjectsAndKeys:
+                                [NSNumber numberWithUnsignedLongLong:checkpointOffset], @"offset",
+                                [NSNumber numberWithUnsignedLongLong:[self fileSize]], @"fileSize",
+                                [NSNumber numberWithInteger:format], @"format",
+                                nil];
+    [checkpoint writeToFile:checkpointPath atomically:YES];
+}
+
+- (void) dealloc
+{
+    [self cancel];
+    
+    [layer release];
+    [path release];
+    [checkpointPath release];
+    
+    [encodeQueue release];
+    dispatch_release(readQueue);
+    if(windowSemaphore)
+        dispatch_release(windowSemaphore);
+    
+    [batchesInFlight release];
+    [batchEndOffsets release];
+    [startDate release];
+    
+    [super dealloc];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Feature scanning 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+static void SGFeatureScanStateInit(SGFeatureScanState* state, SGLayerImportFormat format, BOOL resume)
+{
+    memset(state, 0, sizeof(SGFeatureScanState));
+    state->featureStart = -1;
+    
+    // NDJSON features are top-level objects. FeatureCollection features are
+    // the objects inside the features member of the root object.
+    if(format == kSGLayerImportFormat_FeatureCollection) {
+        state->featureDepth = 2;
+        
+        // A checkpoint always lies between two elements of the features array.
+        if(resume) {
+            state->depth = 2;
+            state->arrayMask = 1ULL << 1;
+            state->inFeatures = YES;
+        }
+    }
+}
+
+static BOOL SGFeatureScanNext(SGFeatureScanState* state, const unsigned char* bytes, NSUInteger length, NSUInteger* position,
+                              unsigned long long bufferOffset, long long* start, long long* end)
+{
+    for(NSUInteger i = *position; i < length; i++) {
+        unsigned char c = bytes[i];
+        if(state->inString) {
+            if(state->escaped)
+                state->escaped = NO;
+            else if(c == '\\') {
+                state->escaped = YES;
+                state->keyMatches = NO;
+            } else if(c == '"') {
+                state->inString = NO;
+                if(state->depth == 1)
+                    state->featuresKey = state->keyMatches && state->keyLength == sizeof(kSGLayerImporter_FeaturesKey) - 1;
+            } else if(state->depth == 1 && state->keyMatches) {
+                // Keys of the root object are matched a byte at a time, since
+                // one can be split between two chunks.
+                state->keyMatches = state->keyLength < sizeof(kSGLayerImporter_FeaturesKey) - 1 &&
+                                    c == kSGLayerImporter_FeaturesKey[state->keyLength];
+                state->keyLength++;
+            }
+            
+            continue;
+        }
+        
+        switch(c) {
+            case '"':
+                state->inString = YES;
+                state->keyLength = 0;
+                state->keyMatches = YES;
+                break;
+            case '{':
+            case '[':
+                // Only the array opened by the features key holds features.
+                // A value at this depth is followed by a comma, so the last
+                // string before an array is always the array's key.
+                if(c == '[' && state->depth == 1)
+                    state->inFeatures = state->featuresKey;
+                
+                if(c == '{' && state->featureStart < 0 && state->depth == state->featureDepth &&
+                   (!state->depth || ((state->arrayMask & (1ULL << (state->depth - 1))) && state->inFeatures)))
+                    state->featureStart = bufferOffset + i;
+                
+                if(state->depth < 64) {
+                    if(c == '[')
+                        state->arrayMask |= (1ULL << state->depth);
+                    else
+                        state->arrayMask &= ~(1ULL << state->depth);
+                }
+                
+                state->depth++;
+                break;
+            case '}':
+            case ']':
+                state->depth--;
+                if(c == '}' && state->featureStart >= 0 && state->depth == state->featureDepth) {
+                    *start = state->featureStart;
+                    *end = bufferOffset + i + 1;
+                    *position = i + 1;
+                    state->featureStart = -1;
+                    return YES;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    
+    *position = length;
+    return NO;
+}
+
+static NSDictionary* SGValidatedFeature(NSDictionary* feature)
+{
+    if(![feature isKindOfClass:[NSDictionary class]] || ![feature isFeature])
+        return nil;
+    
+    NSDictionary* geometry = [feature geometry];
+    if(![geometry isKindOfClass:[NSDictionary class]] || ![geometry isPoint])
+        return nil;
+    
+    NSArray* coordinates = [geometry coordinates];
+    if(![coordinates isKindOfClass:[NSArray class]] || [coordinates count] < 2 ||
+       ![[coordinates objectAtIndex:0] isKindOfClass:[NSNumber class]] ||
+       ![[coordinates objectAtIndex:1] isKindOfClass:[NSNumber class]])
+        return nil;
+    
+    double longitude = [[coordinates objectAtIndex:0] doubleValue];
+    double latitude = [[coordinates objectAtIndex:1] doubleValue];
+    if(latitude < -90.0 || latitude > 90.0 || longitude < -180.0 || longitude > 180.0)
+        return nil;
+    
+    id recordId = [feature objectForKey:@"id"];
+    if([recordId isKindOfClass:[NSNumber class]]) {
+        NSMutableDictionary* normalizedFeature = [[feature mutableCopy] autorelease];
+        [normalizedFeature setObject:[recordId stringValue] forKey:@"id"];
+        feature = normalizedFeature;
+    } else if(![recordId isKindOfClass:[NSString class]] || ![recordId length])
+        return nil;
+    
+    return feature;
+}
@@ -0,0 +1,100 @@
+//
+//  SGLayerSnapshot.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import <Foundation/Foundation.h>
+#import <MapKit/MapKit.h>
+
+/*!
+* @class SGLayerSnapshot
+* @abstract A compact binary copy of the records a map was showing.
+* @discussion The snapshot holds a region and, for every tile and layer, the
+* records that were cached for it. Records are stored with their id, type,
+* coordinate, timestamps and properties. Properties are written as JSON, so
+* the nulls of a response come back as NSNull. A record whose properties
+* cannot be written is left out of the snapshot rather than restored without
+* them, and counted in @link skippedRecordCount skippedRecordCount @/link.
+* Snapshots are read from a memory mapped file, so only the pages that are
+* parsed are loaded.
+*/
+@interface SGLayerSnapshot : NSObject {
+
+    @private
+    MKCoordinateRegion region;
+    NSDictionary* tiles;
+    NSUInteger skippedRecordCount;
+}
+
+/*!
+* @property
+* @abstract The region that was visible.
+*/
+@property (nonatomic, readonly) MKCoordinateRegion region;
+
+/*!
+* @property
+* @abstract The records of the snapshot, keyed by tile and then by layer.
+*/
+@property (nonatomic, readonly) NSDictionary* tiles;
+
+/*!
+* @property
+* @abstract The amount of records the last
+* @link writeToFile: writeToFile: @/link left out because their properties
+* could not be written.
+*/
+@property (nonatomic, readonly) NSUInteger skippedRecordCount;
+
+/*!
+* @method snapshotWithContentsOfFile:
+* @result The snapshot stored in the file, or nil if the file is missing or
+* not a valid snapshot.
+*/
++ (SGLayerSnapshot*) snapshotWithContentsOfFile:(NSString*)path;
+
+/*!
+* @method initWithRegion:tiles:
+* @param region The region that is visible.
+* @param tiles Arrays of records, keyed by tile and then by layer.
+*/
+- (id) initWithRegion:(MKCoordinateRegion)region tiles:(NSDictionary*)tiles;
+
+/*!
+* @method writeToFile:
+* @abstract Writes the snapshot atomically.
+* @result YES if the file was written.
+*/
+- (BOOL) writeToFile:(NSString*)path;
+
+@end
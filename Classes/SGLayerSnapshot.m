@@ -0,0 +1,309 @@
+//
+//  SGLayerSnapshot.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import "SGLayerSnapshot.h"
+#import "SGJSON.h"
+
+#define kSGLayerSnapshot_Magic              0x534C4753
+#define kSGLayerSnapshot_Version            2
+
+typedef struct {
+
+    const unsigned char* bytes;
+    NSUInteger length;
+    NSUInteger position;
+    BOOL failed;
+
+} SGSnapshotReader;
+
+static void SGSnapshotAppendString(NSMutableData* data, NSString* string);
+static const void* SGSnapshotRead(SGSnapshotReader* reader, NSUInteger length);
+static uint32_t SGSnapshotReadUInt32(SGSnapshotReader* reader);
+static double SGSnapshotReadDouble(SGSnapshotReader* reader);
+static NSString* SGSnapshotReadString(SGSnapshotReader* reader);
+
+@interface SGLayerSnapshot (Private)
+
+- (BOOL) appendRecordAnnotation:(id<SGRecordAnnotation>)recordAnnotation toData:(NSMutableData*)data;
+- (SGRecord*) readRecord:(SGSnapshotReader*)reader layer:(NSString*)layerId;
+
+@end
+
+@implementation SGLayerSnapshot
+@synthesize region, tiles, skippedRecordCount;
+
++ (SGLayerSnapshot*) snapshotWithContentsOfFile:(NSString*)path
+{
+    NSData* data = [NSData dataWithContentsOfFile:path options:NSDataReadingMapped error:nil];
+    if(!data)
+        return nil;
+    
+    SGSnapshotReader reader = {[data bytes], [data length], 0, NO};
+    if(SGSnapshotReadUInt32(&reader) != kSGLayerSnapshot_Magic || SGSnapshotReadUInt32(&reader) != kSGLayerSnapshot_Version)
+        return nil;
+    
+    MKCoordinateRegion region;
+    region.center.latitude = SGSnapshotReadDouble(&reader);
+    region.center.longitude = SGSnapshotReadDouble(&reader);
+    region.span.latitudeDelta = SGSnapshotReadDouble(&reader);
+    region.span.longitudeDelta = SGSnapshotReadDouble(&reader);
+    
+    SGLayerSnapshot* snapshot = [[[SGLayerSnapshot alloc] initWithRegion:region tiles:nil] autorelease];
+    NSMutableDictionary* tiles = [NSMutableDictionary dictionary];
+    uint32_t groupCount = SGSnapshotReadUInt32(&reader);
+    for(uint32_t group = 0; group < groupCount && !reader.failed; group++) {
+        NSString* tile = SGSnapshotReadString(&reader);
+        NSString* layerId = SGSnapshotReadString(&reader);
+        uint32_t recordCount = SGSnapshotReadUInt32(&reader);
+        if(reader.failed || !tile || !layerId)
+            break;
+        
+        NSMutableArray* records = [NSMutableArray arrayWithCapacity:MIN(recordCount, 1024)];
+        for(uint32_t i = 0; i < recordCount && !reader.failed; i++) {
+            SGRecord* record = [snapshot readRecord:&reader layer:layerId];
+            if(record)
+                [records addObject:record];
+        }
+        
+        NSMutableDictionary* layers = [tiles objectForKey:tile];
+        if(!layers) {
+            layers = [NSMutableDictionary dictionary];
+            [tiles setObject:layers forKey:tile];
+        }
+        
+        [layers setObject:records forKey:layerId];
+    }
+    
+    if(reader.failed)
+        return nil;
+    
+    snapshot->tiles = [tiles retain];
+    return snapshot;
+}
+
+- (id) initWithRegion:(MKCoordinateRegion)newRegion tiles:(NSDictionary*)newTiles
+{
+    if(self = [super init]) {
+        region = newRegion;
+        tiles = [newTiles retain];
+        skippedRecordCount = 0;
+    }
+    
+    return self;
+}
+
+- (BOOL) writeToFile:(NSString*)path
+{
+    NSMutableData* data = [NSMutableData dataWithCapacity:65536];
+    uint32_t header[2] = {kSGLayerSnapshot_Magic, kSGLayerSnapshot_Version};
+    double regionValues[4] = {region.center.latitude, region.center.longitude, region.span.latitudeDelta, region.span.longitudeDelta};
+    [data appendBytes:header length:sizeof(header)];
+    [data appendBytes:regionValues length:sizeof(regionValues)];
+    
+    uint32_t groupCount = 0;
+    for(NSDictionary* layers in [tiles allValues])
+        groupCount += [layers count];
+    
+    [data appendBytes:&groupCount length:sizeof(groupCount)];
+    skippedRecordCount = 0;
+    NSMutableData* recordData = [NSMutableData data];
+    for(NSString* tile in tiles) {
+        NSDictionary* layers = [tiles objectForKey:tile];
+        for(NSString* layerId in layers) {
+            // The count is only known once the records that could not be
+            // written have been left out.
+            uint32_t recordCount = 0;
+            [recordData setLength:0];
+            for(id<SGRecordAnnotation> recordAnnotation in [layers objectForKey:layerId]) {
+                if([self appendRecordAnnotation:recordAnnotation toData:recordData])
+                    recordCount++;
+                else
+                    skippedRecordCount++;
+            }
+            
+            SGSnapshotAppendString(data, tile);
+            SGSnapshotAppendString(data, layerId);
+            [data appendBytes:&recordCount length:sizeof(recordCount)];
+            [data appendData:recordData];
+        }
+    }
+    
+    return [data writeToFile:path atomically:YES];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Records 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (BOOL) appendRecordAnnotation:(id<SGRecordAnnotation>)recordAnnotation toData:(NSMutableData*)data
+{
+    NSData* propertyData = nil;
+    if([recordAnnotation respondsToSelector:@selector(properties)] && [recordAnnotation properties]) {
+        NSString* propertyString = [[CJSONSerializer serializer] serializeObject:[recordAnnotation properties]];
+        if(!propertyString)
+            return NO;
+        
+        propertyData = [propertyString dataUsingEncoding:NSUTF8StringEncoding];
+    }
+    
+    CLLocationCoordinate2D coordinate = recordAnnotation.coordinate;
+    double values[4] = {
+        coordinate.latitude,
+        coordinate.longitude,
+        [recordAnnotation respondsToSelector:@selector(created)] ? [recordAnnotation created] : 0.0,
+        [recordAnnotation respondsToSelector:@selector(expires)] ? [recordAnnotation expires] : 0.0
+    };
+    
+    SGSnapshotAppendString(data, [recordAnnotation recordId]);
+    SGSnapshotAppendString(data, [recordAnnotation respondsToSelector:@selector(type)] ? [recordAnnotation type] : nil);
+    [data appendBytes:values length:sizeof(values)];
+    
+    uint32_t propertyLength = [propertyData length];
+    [data appendBytes:&propertyLength length:sizeof(propertyLength)];
+    if(propertyLength)
+        [data appendData:propertyData];
+    
+    return YES;
+}
+
+- (SGRecord*) readRecord:(SGSnapshotReader*)reader layer:(NSString*)layerId
+{
+    NSString* recordId = SGSnapshotReadString(reader);
+    NSString* type = SGSnapshotReadString(reader);
+    double latitude = SGSnapshotReadDouble(reader);
+    double longitude = SGSnapshotReadDouble(reader);
+    double created = SGSnapshotReadDouble(reader);
+    double expires = SGSnapshotReadDouble(reader);
+    
+    uint32_t propertyLength = SGSnapshotReadUInt32(reader);
+    const void* propertyBytes = SGSnapshotRead(reader, propertyLength);
+    if(reader->failed || !recordId)
+        return nil;
+    
+    SGRecord* record = [[[SGRecord alloc] init] autorelease];
+    record.recordId = recordId;
+    record.layer = layerId;
+    record.latitude = latitude;
+    record.longitude = longitude;
+    record.created = created;
+    record.expires = expires;
+    if(type)
+        record.type = type;
+    
+    if(propertyLength) {
+        // Properties that cannot be read back mean the snapshot is damaged.
+        NSData* propertyData = [NSData dataWithBytesNoCopy:(void*)propertyBytes length:propertyLength freeWhenDone:NO];
+        id properties = [[CJSONDeserializer deserializer] deserialize:propertyData error:nil];
+        if(![properties isKindOfClass:[NSDictionary class]]) {
+            reader->failed = YES;
+            return nil;
+        }
+        
+        record.properties = [NSMutableDictionary dictionaryWithDictionary:properties];
+    }
+    
+    return record;
+}
+
+- (void) dealloc
+{
+    [tiles release];
+    [super dealloc];
+}
+
+@end
+
+static void SGSnapshotAppendString(NSMutableData* data, NSString* string)
+{
+    const char* utf8 = string ? [string UTF8String] : NULL;
+    size_t length = utf8 ? strlen(utf8) : 0;
+    
+    // A string that does not fit is written as missing.
+    uint16_t storedLength = length < 0xFFFF ? (uint16_t)length + 1 : 0;
+    [data appendBytes:&storedLength length:sizeof(storedLength)];
+    if(storedLength)
+        [data appendBytes:utf8 length:storedLength - 1];
+}
+
+static const void* SGSnapshotRead(SGSnapshotReader* reader, NSUInteger length)
+{
+    if(reader->failed || length > reader->length - reader->position) {
+        reader->failed = YES;
+        return NULL;
+    }
+    
+    const void* bytes = reader->bytes + reader->position;
+    reader->position += length;
+    return bytes;
+}
+
+static uint32_t SGSnapshotReadUInt32(SGSnapshotReader* reader)
+{
+    uint32_t value = 0;
+    const void* bytes = SGSnapshotRead(reader, sizeof(value));
+    if(bytes)
+        memcpy(&value, bytes, sizeof(value));
+    
+    return value;
+}
+
+static double SGSnapshotReadDouble(SGSnapshotReader* reader)
+{
+    double value = 0.0;
+    const void* bytes = SGSnapshotRead(reader, sizeof(value));
+    if(bytes)
+        memcpy(&value, bytes, sizeof(value));
+    
+    return value;
+}
+
+static NSString* SGSnapshotReadString(SGSnapshotReader* reader)
+{
+    uint16_t storedLength = 0;
+    const void* lengthBytes = SGSnapshotRead(reader, sizeof(storedLength));
+    if(!lengthBytes)
+        return nil;
+    
+    memcpy(&storedLength, lengthBytes, sizeof(storedLength));
+    if(!storedLength)
+        return nil;
+    
+    const void* bytes = SGSnapshotRead(reader, storedLength - 1);
+    if(!bytes)
+        return nil;
+    
+    return [[[NSString alloc] initWithBytes:bytes length:storedLength - 1 encoding:NSUTF8StringEncoding] autorelease];
+}
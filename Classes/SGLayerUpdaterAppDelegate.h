@@ -34,9 +34,12 @@
 
 #import <UIKit/UIKit.h>
 
+@class SGMainViewController;
+
 @interface SGLayerUpdaterAppDelegate : NSObject <UIApplicationDelegate> {
     
     UIWindow* window;
+    SGMainViewController* mainViewController;
     
 }
 
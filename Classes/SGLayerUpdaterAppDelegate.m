@@ -66,7 +66,7 @@
     // We want to make sure that we are adding the proper credentials to the
     // location service before we make the window visible. We might end up using
     // the location service in some of the UIVIew initialization code.
-    SGMainViewController* mainViewController = [[SGMainViewController alloc] initWithLayer:layer];
+    mainViewController = [[SGMainViewController alloc] initWithLayer:layer];
     UINavigationController* navigationController = [[UINavigationController alloc] initWithRootViewController:mainViewController];
     [window addSubview:navigationController.view];
     [window makeKeyAndVisible];
@@ -74,8 +74,29 @@
 	return YES;
 }
 
+- (void) applicationDidEnterBackground:(UIApplication*)application
+{
+    // Writing the snapshot may outlast the time the system grants before the
+    // application is suspended.
+    __block UIBackgroundTaskIdentifier taskIdentifier = [application beginBackgroundTaskWithExpirationHandler:^{
+        [application endBackgroundTask:taskIdentifier];
+        taskIdentifier = UIBackgroundTaskInvalid;
+    }];
+    
+    [mainViewController saveSnapshot];
+    
+    if(taskIdentifier != UIBackgroundTaskInvalid)
+        [application endBackgroundTask:taskIdentifier];
+}
+
+- (void) applicationWillTerminate:(UIApplication*)application
+{
+    [mainViewController saveSnapshot];
+}
+
 - (void) dealloc
 {        
+    [mainViewController release];
     [window release];
     [super dealloc];
 }
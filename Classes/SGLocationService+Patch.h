@@ -0,0 +1,58 @@
+//
+//  SGLocationService+Patch.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import <Foundation/Foundation.h>
+
+/*!
+* @category SGLocationService (Patch)
+* @abstract Sends only the properties of a record that changed.
+* @discussion The patch relies on SimpleGeo merging the properties of an
+* update into the stored record. Properties that were removed locally are sent
+* as null. The type, expires and created values are always sent.
+*/
+@interface SGLocationService (Patch)
+
+/*!
+* @method updateRecordAnnotation:baselineProperties:
+* @abstract Updates a record with a property-level patch.
+* @discussion If baselineProperties is nil, the full record is sent with
+* @link updateRecordAnnotation: updateRecordAnnotation: @/link.
+* @param record The record to update.
+* @param baselineProperties The properties SimpleGeo last acknowledged for the record.
+* @result A response identifier.
+*/
+- (NSString*) updateRecordAnnotation:(id<SGRecordAnnotation>)record baselineProperties:(NSDictionary*)baselineProperties;
+
+@end
@@ -0,0 +1,59 @@
+//
+//  SGLocationService+Patch.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import "SGLocationService+Patch.h"
+#import "SGGeoJSONEncoder+Patch.h"
+
+@implementation SGLocationService (Patch)
+
+- (NSString*) updateRecordAnnotation:(id<SGRecordAnnotation>)record baselineProperties:(NSDictionary*)baselineProperties
+{
+    if(!baselineProperties)
+        return [self updateRecordAnnotation:record];
+    
+    // The patch is sent as a record of its own so that its type and
+    // timestamps go out with it, which updateRecord:layer:coord:properties:
+    // would leave behind.
+    NSDictionary* patch = [SGGeoJSONEncoder geoJSONPatchForRecordAnnotation:record baselineProperties:baselineProperties];
+    id<SGRecordAnnotation> patchRecord = [SGGeoJSONEncoder recordForGeoJSONObject:patch];
+    if([(NSObject*)patchRecord isKindOfClass:[SGRecord class]]) {
+        ((SGRecord*)patchRecord).recordId = [record recordId];
+        ((SGRecord*)patchRecord).layer = [record layer];
+    }
+    
+    return [self updateRecordAnnotation:patchRecord];
+}
+
+@end
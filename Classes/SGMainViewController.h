@@ -36,12 +36,13 @@
 #import <MapKit/MapKit.h>
 
 #import "SGCreateRecordViewController.h"
+#import "SGRecordMapView.h"
 
 
 @interface SGMainViewController : UIViewController <SGLocationServiceDelegate, MKMapViewDelegate> {
 
     @private
-    SGLayerMapView* layerMapView;
+    SGRecordMapView* layerMapView;
 
     SGCreateRecordViewController* createRecordViewController;
     UINavigationController* createRecordNavigationViewController;
@@ -51,9 +52,15 @@
     NSString* deleteRequestId;
     NSString* sendRequestId;
     
+    SGRecord* sentRecord;
+    NSMutableDictionary* acknowledgedProperties;
+    BOOL sendsPropertyPatches;
+    
     NSString* layerName;
     
     SGARView* arView;
 }
 
+- (void) saveSnapshot;
+
 @end
@@ -35,14 +35,17 @@
 #import "SGMainViewController.h"
 
 #import "SGSimpleAnnotationView.h"
+#import "SGLocationService+Patch.h"
 
 @interface SGMainViewController (Private) <SGARViewDataSource, SGAnnotationViewDelegate>
 
 - (BOOL) isRequestId:(NSString*)requestIdOne equalTo:(NSString*)requestIdTwo;
 - (NSArray*) getMapAnnotations;
+- (NSString*) snapshotPath;
 
 - (void) initializeCreateRecordViewController;
 - (void) initializeARView;
+- (void) initializeAnnotationViewPools;
 
 @end
 
@@ -58,6 +61,13 @@
         
         sendRequestId = nil;
         deleteRequestId = nil;
+        
+        sentRecord = nil;
+        acknowledgedProperties = [[NSMutableDictionary alloc] init];
+        
+        // Patches rely on SimpleGeo merging properties into the stored
+        // record. Turn this on only for endpoints that do.
+        sendsPropertyPatches = NO;
     }
     
     return self;
@@ -90,6 +100,43 @@
     [addRecordButton release];    
 }
 
+- (void) initializeAnnotationViewPools
+{
+    // Building a pin and its callout buttons is the expensive part of showing
+    // a record, so the map builds them ahead of time while it is idle.
+    SGAnnotationViewPool* recordPinPool = [[SGAnnotationViewPool alloc] initWithReuseIdentifier:@"RecordPin" builder:^(NSString* reuseIdentifier) {
+        MKPinAnnotationView* pinAnnotationView = [[[MKPinAnnotationView alloc] initWithAnnotation:nil reuseIdentifier:reuseIdentifier] autorelease];
+        
+        UIButton* deleteButton = [UIButton buttonWithType:UIButtonTypeRoundedRect];
+        deleteButton.frame = CGRectMake(0.0, 0.0, 50.0, 20.0);
+        [deleteButton setTitle:@"Delete" forState:UIControlStateNormal];
+        deleteButton.titleLabel.textColor = [UIColor redColor];
+        deleteButton.tag = 0;
+
+        UIButton* noteButton = [UIButton buttonWithType:UIButtonTypeRoundedRect];
+        noteButton.frame = deleteButton.frame;
+        [noteButton setTitle:@"Note" forState:UIControlStateNormal];
+        noteButton.tag = 1;
+        
+        pinAnnotationView.leftCalloutAccessoryView = noteButton;
+        pinAnnotationView.rightCalloutAccessoryView = deleteButton;
+        pinAnnotationView.canShowCallout = YES;
+        return (MKAnnotationView*)pinAnnotationView;
+    }];
+    
+    SGAnnotationViewPool* clusterPinPool = [[SGAnnotationViewPool alloc] initWithReuseIdentifier:@"ClusterPin" builder:^(NSString* reuseIdentifier) {
+        MKPinAnnotationView* pinAnnotationView = [[[MKPinAnnotationView alloc] initWithAnnotation:nil reuseIdentifier:reuseIdentifier] autorelease];
+        pinAnnotationView.pinColor = MKPinAnnotationColorPurple;
+        pinAnnotationView.canShowCallout = YES;
+        return (MKAnnotationView*)pinAnnotationView;
+    }];
+    
+    [layerMapView addAnnotationViewPool:recordPinPool];
+    [layerMapView addAnnotationViewPool:clusterPinPool];
+    [recordPinPool release];
+    [clusterPinPool release];
+}
+
 - (void) initializeARView
 {
     arView = [[SGARView alloc] initWithFrame:self.view.bounds];
@@ -116,15 +163,19 @@
     
     self.title = @"Layer Updater";
         
-    layerMapView = [[SGLayerMapView alloc] initWithFrame:self.view.bounds];
+    layerMapView = [[SGRecordMapView alloc] initWithFrame:self.view.bounds];
     [layerMapView addLayers:[NSArray arrayWithObject:[[SGLayer alloc] initWithLayerName:layerName]]];
 
     layerMapView.addRetrievedRecordsToLayer = NO;
     layerMapView.delegate = self;
     layerMapView.showsUserLocation = YES;
-    layerMapView.reloadTimeInterval = 10.0;
+    layerMapView.reloadTimeInterval = 120.0;
 
     [self.view addSubview:layerMapView];
+    
+    // The pins of the last session show up right away. Retrieving refreshes
+    // them from SimpleGeo.
+    [layerMapView restoreSnapshotFromFile:[self snapshotPath]];
     [layerMapView startRetrieving];
     
     UIButton* locateMeButton = [UIButton buttonWithType:UIButtonTypeCustom];
@@ -139,6 +190,7 @@
     
     [self initializeCreateRecordViewController];    
     [self initializeARView];
+    [self initializeAnnotationViewPools];
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -162,7 +214,14 @@
         SGRecord* newRecord = createRecordViewController.record;
         newRecord.layer = layerName;
 
-        sendRequestId = [locationService updateRecordAnnotation:newRecord];
+        // Records that were already sent from here only need their changed properties.
+        [sentRecord release];
+        sentRecord = newRecord;
+        if(sendsPropertyPatches)
+            sendRequestId = [locationService updateRecordAnnotation:newRecord
+                                                 baselineProperties:[acknowledgedProperties objectForKey:newRecord.recordId]];
+        else
+            sendRequestId = [locationService updateRecordAnnotation:newRecord];
 
         [createRecordNavigationViewController dismissModalViewControllerAnimated:YES];
     }
@@ -211,8 +270,14 @@
 {
     if([self isRequestId:requestId equalTo:sendRequestId]) {  
         id<SGRecordAnnotation> recordAnnotation = [SGGeoJSONEncoder recordForGeoJSONObject:(NSDictionary*)responseObject];
-        [layerMapView addAnnotation:recordAnnotation];
+        [layerMapView addRecordAnnotation:recordAnnotation toLayerId:layerName];
         sendRequestId = nil;
+        
+        NSDictionary* properties = [[NSDictionary alloc] initWithDictionary:sentRecord.properties copyItems:YES];
+        [acknowledgedProperties setObject:properties forKey:sentRecord.recordId];
+        [properties release];
+        [sentRecord release];
+        sentRecord = nil;
     } else if([self isRequestId:requestId equalTo:deleteRequestId]) {
         deleteRequestId = nil;
     }
@@ -239,30 +304,10 @@
 - (MKAnnotationView*) mapView:(MKMapView*)mapView viewForAnnotation:(id<MKAnnotation>)annotation
 {
     MKAnnotationView* annotationView = nil;
-    if([annotation isKindOfClass:[SGRecord class]]) {
-        MKPinAnnotationView* pinAnnotationView = (MKPinAnnotationView*)[mapView dequeueReusableAnnotationViewWithIdentifier:@"RecordPin"];
-        if(!pinAnnotationView) {
-            pinAnnotationView = [[[MKPinAnnotationView alloc] initWithAnnotation:annotation reuseIdentifier:@"RecordPin"] autorelease];
-            
-            UIButton* deleteButton = [UIButton buttonWithType:UIButtonTypeRoundedRect];
-            deleteButton.frame = CGRectMake(0.0, 0.0, 50.0, 20.0);
-            [deleteButton setTitle:@"Delete" forState:UIControlStateNormal];
-            deleteButton.titleLabel.textColor = [UIColor redColor];
-            deleteButton.tag = 0;
-
-            UIButton* noteButton = [UIButton buttonWithType:UIButtonTypeRoundedRect];
-            noteButton.frame = deleteButton.frame;
-            [noteButton setTitle:@"Note" forState:UIControlStateNormal];
-            noteButton.tag = 1;
-            
-            pinAnnotationView.leftCalloutAccessoryView = noteButton;
-            pinAnnotationView.rightCalloutAccessoryView = deleteButton;
-            pinAnnotationView.canShowCallout = YES;
-        }
-        
-        pinAnnotationView.annotation = annotation;
-        annotationView = pinAnnotationView;
-    }
+    if([annotation isKindOfClass:[SGRecord class]])
+        annotationView = [layerMapView dequeueAnnotationViewWithIdentifier:@"RecordPin" forAnnotation:annotation];
+    else if([annotation isKindOfClass:[SGClusterAnnotation class]])
+        annotationView = [layerMapView dequeueAnnotationViewWithIdentifier:@"ClusterPin" forAnnotation:annotation];
     
     return annotationView;
 }
@@ -281,7 +326,8 @@
             [noteAlertView release];
         } else {
             if(!deleteRequestId) {
-                [layerMapView removeAnnotation:record];            
+                [layerMapView removeRecordAnnotation:record fromLayerId:layerName];
+                [acknowledgedProperties removeObjectForKey:record.recordId];
                 deleteRequestId = [locationService deleteRecordAnnotation:record];
             }
         }
@@ -340,10 +386,29 @@
     return requestIdOne && requestIdTwo && [requestIdOne isEqualToString:requestIdTwo];
 }
 
+- (void) saveSnapshot
+{
+    if(layerMapView)
+        [layerMapView writeSnapshotToFile:[self snapshotPath]];
+}
+
+- (NSString*) snapshotPath
+{
+    NSString* cachesDirectory = [NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES) objectAtIndex:0];
+    return [cachesDirectory stringByAppendingPathComponent:[layerName stringByAppendingPathExtension:@"snapshot"]];
+}
+
 - (NSArray*) getMapAnnotations
 {
-    NSMutableArray* annotations = [NSMutableArray arrayWithArray:layerMapView.annotations];
-    [annotations removeObject:layerMapView.userLocation];
+    // The AR view shows every record, so clusters are expanded.
+    NSMutableArray* annotations = [NSMutableArray array];
+    for(id<MKAnnotation> annotation in layerMapView.annotations) {
+        if([annotation isKindOfClass:[SGClusterAnnotation class]])
+            [annotations addObjectsFromArray:((SGClusterAnnotation*)annotation).recordAnnotations];
+        else if(annotation != layerMapView.userLocation)
+            [annotations addObject:annotation];
+    }
+    
     return annotations;
 }
 
@@ -359,6 +424,9 @@
     [deleteRequestId release];
     [sendRequestId release];
     
+    [sentRecord release];
+    [acknowledgedProperties release];
+    
     [layerName release];
     
     [super dealloc];
@@ -0,0 +1,139 @@
+//
+//  SGNearbyPager.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import <Foundation/Foundation.h>
+
+@protocol SGNearbyPagerDelegate;
+
+/*!
+* @class SGNearbyPager
+* @abstract Follows the next_cursor of a nearby request until a layer
+* has been paged out.
+* @discussion The request for page N + 1 is sent as soon as the response
+* for page N arrives, so the next round trip overlaps with decoding and
+* delivering the current page. Records are decoded off the main thread with
+* @link //simplegeo/ooc/instm/SGLayer/recordAnnotationFromGeoJSONObject: recordAnnotationFromGeoJSONObject: @/link
+* and handed to the delegate on the main thread. No more than
+* @link maxPagesInFlight maxPagesInFlight @/link pages are requested but not
+* yet delivered at any time.
+*/
+@interface SGNearbyPager : NSObject <SGLocationServiceDelegate> {
+
+    id<SGNearbyPagerDelegate> delegate;
+    NSInteger maxPagesInFlight;
+    NSInteger maxPages;
+    
+    @private
+    SGLayer* layer;
+    SGNearbyQuery* query;
+    
+    NSString* pageRequestId;
+    NSString* heldCursor;
+    NSInteger pagesInFlight;
+    NSInteger pagesRequested;
+    NSInteger pagesLoaded;
+    NSInteger recordCount;
+    BOOL paging;
+    
+    dispatch_queue_t decodeQueue;
+}
+
+@property (nonatomic, assign) id<SGNearbyPagerDelegate> delegate;
+
+/*!
+* @property
+* @abstract The amount of pages that can be requested or decoded but not yet
+* delivered. The default is 2.
+*/
+@property (nonatomic, assign) NSInteger maxPagesInFlight;
+
+/*!
+* @property
+* @abstract Stop after this many pages. The default is 0, which pages until
+* the server stops returning a cursor.
+*/
+@property (nonatomic, assign) NSInteger maxPages;
+
+@property (nonatomic, readonly) SGLayer* layer;
+@property (nonatomic, readonly) SGNearbyQuery* query;
+@property (nonatomic, readonly) NSInteger pagesLoaded;
+@property (nonatomic, readonly) NSInteger recordCount;
+@property (nonatomic, readonly, getter=isPaging) BOOL paging;
+
+- (id) initWithLayer:(SGLayer*)layer query:(SGNearbyQuery*)query;
+
+/*!
+* @method start
+* @abstract Sends the first page of the query.
+*/
+- (void) start;
+
+/*!
+* @method cancel
+* @abstract Stops paging. Responses for pages that are already out are ignored.
+*/
+- (void) cancel;
+
+@end
+
+/*!
+* @protocol SGNearbyPagerDelegate
+* @abstract Receives the pages that are loaded by a @link SGNearbyPager SGNearbyPager @/link.
+*/
+@protocol SGNearbyPagerDelegate <NSObject>
+
+/*!
+* @method nearbyPager:didLoadRecordAnnotations:page:
+* @abstract Called on the main thread for every page, in order.
+* @param pager The pager.
+* @param recordAnnotations The records decoded from the page.
+* @param page The zero-based index of the page.
+*/
+- (void) nearbyPager:(SGNearbyPager*)pager didLoadRecordAnnotations:(NSArray*)recordAnnotations page:(NSInteger)page;
+
+/*!
+* @method nearbyPager:failedWithError:
+* @abstract Called when a page request fails. Paging stops.
+*/
+- (void) nearbyPager:(SGNearbyPager*)pager failedWithError:(NSError*)error;
+
+@optional
+/*!
+* @method nearbyPagerDidFinish:
+* @abstract Called once the last page has been delivered.
+*/
+- (void) nearbyPagerDidFinish:(SGNearbyPager*)pager;
+
+@end
@@ -0,0 +1,226 @@
+//
+//  SGNearbyPager.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import "SGNearbyPager.h"
+
+@interface SGNearbyPager (Private)
+
+- (void) requestPageWithCursor:(NSString*)cursor;
+- (void) receivedPage:(NSDictionary*)geoJSONObject;
+- (void) deliverRecordAnnotations:(NSArray*)recordAnnotations page:(NSInteger)page;
+- (void) finishIfDone;
+
+- (NSString*) cursorForGeoJSONObject:(NSDictionary*)geoJSONObject;
+
+@end
+
+@implementation SGNearbyPager
+@synthesize delegate, maxPagesInFlight, maxPages, layer, query, pagesLoaded, recordCount, paging;
+
+- (id) initWithLayer:(SGLayer*)newLayer query:(SGNearbyQuery*)newQuery
+{
+    if(self = [super init]) {
+        layer = [newLayer retain];
+        query = [newQuery retain];
+        
+        delegate = nil;
+        maxPagesInFlight = 2;
+        maxPages = 0;
+        
+        pageRequestId = nil;
+        heldCursor = nil;
+        paging = NO;
+        
+        decodeQueue = dispatch_queue_create("com.simplegeo.layerupdater.nearbypager", NULL);
+    }
+    
+    return self;
+}
+
+- (void) start
+{
+    if(!paging) {
+        paging = YES;
+        pagesInFlight = 0;
+        pagesRequested = 0;
+        pagesLoaded = 0;
+        recordCount = 0;
+        
+        [[SGLocationService sharedLocationService] addDelegate:self];
+        [self requestPageWithCursor:query.cursor];
+    }
+}
+
+- (void) cancel
+{
+    if(paging) {
+        paging = NO;
+        
+        [pageRequestId release];
+        pageRequestId = nil;
+        [heldCursor release];
+        heldCursor = nil;
+        
+        [[SGLocationService sharedLocationService] removeDelegate:self];
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark SGLocationService delegate methods 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (void) locationService:(SGLocationService*)service succeededForResponseId:(NSString*)requestId responseObject:(NSObject*)responseObject
+{
+    dispatch_async(dispatch_get_main_queue(), ^{
+        if(paging && pageRequestId && [pageRequestId isEqualToString:requestId]) {
+            [pageRequestId release];
+            pageRequestId = nil;
+            [self receivedPage:(NSDictionary*)responseObject];
+        }
+    });
+}
+
+- (void) locationService:(SGLocationService*)service failedForResponseId:(NSString*)requestId error:(NSError*)error
+{
+    dispatch_async(dispatch_get_main_queue(), ^{
+        if(paging && pageRequestId && [pageRequestId isEqualToString:requestId]) {
+            [self cancel];
+            [delegate nearbyPager:self failedWithError:error];
+        }
+    });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Paging 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (void) requestPageWithCursor:(NSString*)cursor
+{
+    query.cursor = cursor;
+    pagesInFlight++;
+    pagesRequested++;
+    pageRequestId = [[layer nearby:query] retain];
+}
+
+- (void) receivedPage:(NSDictionary*)geoJSONObject
+{
+    NSInteger page = pagesRequested - 1;
+    
+    // Send the next request before anything is decoded so the round trip
+    // overlaps with the work below.
+    NSString* cursor = [self cursorForGeoJSONObject:geoJSONObject];
+    if(cursor && (!maxPages || pagesRequested < maxPages)) {
+        if(pagesInFlight < maxPagesInFlight)
+            [self requestPageWithCursor:cursor];
+        else
+            heldCursor = [cursor retain];
+    }
+
+    SGLayer* pageLayer = layer;
+    dispatch_async(decodeQueue, ^{
+        NSArray* features = [geoJSONObject isKindOfClass:[NSDictionary class]] ? [geoJSONObject features] : nil;
+        NSMutableArray* recordAnnotations = [NSMutableArray arrayWithCapacity:[features count]];
+        for(NSDictionary* feature in features) {
+            id<SGRecordAnnotation> recordAnnotation = [pageLayer recordAnnotationFromGeoJSONObject:feature];
+            if(recordAnnotation)
+                [recordAnnotations addObject:recordAnnotation];
+        }
+        
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self deliverRecordAnnotations:recordAnnotations page:page];
+        });
+    });
+}
+
+- (void) deliverRecordAnnotations:(NSArray*)recordAnnotations page:(NSInteger)page
+{
+    if(!paging)
+        return;
+    
+    pagesInFlight--;
+    pagesLoaded++;
+    recordCount += [recordAnnotations count];
+    [delegate nearbyPager:self didLoadRecordAnnotations:recordAnnotations page:page];
+
+    if(paging && heldCursor && pagesInFlight < maxPagesInFlight) {
+        NSString* cursor = [heldCursor autorelease];
+        heldCursor = nil;
+        [self requestPageWithCursor:cursor];
+    }
+    
+    [self finishIfDone];
+}
+
+- (void) finishIfDone
+{
+    if(paging && !pagesInFlight && !heldCursor && !pageRequestId) {
+        [self cancel];
+        if([delegate respondsToSelector:@selector(nearbyPagerDidFinish:)])
+            [delegate nearbyPagerDidFinish:self];
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Utility methods 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (NSString*) cursorForGeoJSONObject:(NSDictionary*)geoJSONObject
+{
+    NSString* cursor = nil;
+    if([geoJSONObject isKindOfClass:[NSDictionary class]]) {
+        cursor = [geoJSONObject objectForKey:@"next_cursor"];
+        if(![cursor isKindOfClass:[NSString class]] || ![cursor length])
+            cursor = nil;
+    }
+    
+    return cursor;
+}
+
+- (void) dealloc
+{
+    [self cancel];
+    
+    [layer release];
+    [query release];
+    
+    dispatch_release(decodeQueue);
+    
+    [super dealloc];
+}
+
+@end
@@ -0,0 +1,184 @@
+//
+//  SGPolygonCache.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import <Foundation/Foundation.h>
+
+#import "SGPreparedPolygon.h"
+#import "SGEnvelopeTree.h"
+
+/*!
+* @class SGPolygonCache
+* @abstract Answers PushPin requests from boundaries that were loaded before.
+* @discussion Every @link contains: contains: @/link response is remembered
+* as a cone, the features that contain the coordinate. When
+* @link loadsBoundaries loadsBoundaries @/link is YES the boundaries of those
+* features are loaded and kept as
+* @link //simplegeo/ooc/cl/SGPreparedPolygon SGPreparedPolygons @/link,
+* indexed by an @link //simplegeo/ooc/cl/SGEnvelopeTree SGEnvelopeTree @/link
+* of their bounds.
+*
+* A later @link contains: contains: @/link is answered locally when the
+* kept boundaries that contain the coordinate are exactly the features of a
+* remembered cone. This assumes that the features of one type do not
+* overlap, so a coordinate can only be in one country, one province and so
+* on. A coordinate in a feature whose boundary is not kept, such as a
+* neighborhood next to the one that was asked for, would be missed; cones
+* are only kept for
+* @link maxConeCount maxConeCount @/link requests for that reason.
+*
+* Responses are sent to the delegate as if they came from
+* @link //simplegeo/ooc/cl/SGLocationService SGLocationService @/link, on
+* the main thread, whether they were answered locally or not. Only the
+* requests that were made through the cache are sent.
+*/
+@interface SGPolygonCache : NSObject <SGLocationServiceDelegate> {
+
+    id<SGLocationServiceDelegate> delegate;
+    NSUInteger maxPolygonCount;
+    NSUInteger maxConeCount;
+    BOOL loadsBoundaries;
+    NSUInteger hitCount;
+    NSUInteger missCount;
+    
+    @private
+    NSMutableDictionary* polygons;
+    NSMutableArray* recentFeatureIds;
+    NSMutableArray* cones;
+    SGEnvelopeTree* tree;
+    NSArray* treePolygons;
+    
+    NSMutableSet* containsRequestIds;
+    NSMutableDictionary* boundaryRequests;
+    NSMutableSet* forwardedRequestIds;
+    NSUInteger localRequestCount;
+    
+    dispatch_queue_t prepareQueue;
+}
+
+@property (nonatomic, assign) id<SGLocationServiceDelegate> delegate;
+
+/*!
+* @property
+* @abstract The most boundaries to keep. The least recently used ones are
+* dropped first. The default is 32.
+*/
+@property (nonatomic, assign) NSUInteger maxPolygonCount;
+
+/*!
+* @property
+* @abstract The most cones to keep. The default is 64.
+*/
+@property (nonatomic, assign) NSUInteger maxConeCount;
+
+/*!
+* @property
+* @abstract Load the boundary of every feature a
+* @link contains: contains: @/link response has. The default is YES.
+*/
+@property (nonatomic, assign) BOOL loadsBoundaries;
+
+/*!
+* @property
+* @abstract The amount of @link contains: contains: @/link requests that
+* were answered locally.
+*/
+@property (nonatomic, readonly) NSUInteger hitCount;
+
+/*!
+* @property
+* @abstract The amount of @link contains: contains: @/link requests that
+* were sent to SimpleGeo.
+*/
+@property (nonatomic, readonly) NSUInteger missCount;
+
+/*!
+* @method contains:
+* @abstract Finds the features that contain a coordinate.
+* @discussion See @link //simplegeo/ooc/instm/SGLocationService/contains: contains: @/link.
+* @param coordinate The coordinate.
+* @result A response id.
+*/
+- (NSString*) contains:(CLLocationCoordinate2D)coordinate;
+
+/*!
+* @method boundary:
+* @abstract Loads the boundary of a feature and keeps it.
+* @discussion See @link //simplegeo/ooc/instm/SGLocationService/boundary: boundary: @/link.
+* The request always goes to SimpleGeo since the geometry is not kept in a
+* form that can be sent back.
+* @param featureId The id of the feature.
+* @result A response id.
+*/
+- (NSString*) boundary:(NSString*)featureId;
+
+/*!
+* @method addBoundary:
+* @abstract Keeps a boundary that was loaded some other way.
+* @param feature A feature returned by
+* @link //simplegeo/ooc/instm/SGLocationService/boundary: boundary: @/link.
+* @result The prepared boundary, or nil if the feature has no polygon.
+*/
+- (SGPreparedPolygon*) addBoundary:(NSDictionary*)feature;
+
+/*!
+* @method polygonWithFeatureId:
+* @result The boundary of the feature if it is kept.
+*/
+- (SGPreparedPolygon*) polygonWithFeatureId:(NSString*)featureId;
+
+/*!
+* @method polygonsContainingCoordinate:
+* @abstract Finds the kept boundaries that contain a coordinate.
+* @param coordinate The coordinate.
+* @result The @link //simplegeo/ooc/cl/SGPreparedPolygon SGPreparedPolygons @/link.
+*/
+- (NSArray*) polygonsContainingCoordinate:(CLLocationCoordinate2D)coordinate;
+
+/*!
+* @method featuresContainingCoordinate:
+* @abstract Answers a @link contains: contains: @/link request locally.
+* @param coordinate The coordinate.
+* @result The features, or nil if the kept boundaries that contain the
+* coordinate are not the features of a remembered cone.
+*/
+- (NSArray*) featuresContainingCoordinate:(CLLocationCoordinate2D)coordinate;
+
+/*!
+* @method removeAllPolygons
+* @abstract Drops every boundary and cone.
+*/
+- (void) removeAllPolygons;
+
+@end
@@ -0,0 +1,357 @@
+//
+//  SGPolygonCache.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import "SGPolygonCache.h"
+
+@interface SGPolygonCache (Private)
+
+- (void) addCone:(NSArray*)features;
+- (void) loadBoundariesForFeatureIds:(NSArray*)featureIds;
+- (void) addPolygon:(SGPreparedPolygon*)polygon;
+- (void) removeLeastRecentlyUsedPolygons;
+- (void) buildTree;
+
+@end
+
+@implementation SGPolygonCache
+@synthesize delegate, maxPolygonCount, maxConeCount, loadsBoundaries, hitCount, missCount;
+
+- (id) init
+{
+    if(self = [super init]) {
+        delegate = nil;
+        maxPolygonCount = 32;
+        maxConeCount = 64;
+        loadsBoundaries = YES;
+        hitCount = 0;
+        missCount = 0;
+        
+        polygons = [[NSMutableDictionary alloc] init];
+        recentFeatureIds = [[NSMutableArray alloc] init];
+        cones = [[NSMutableArray alloc] init];
+        tree = nil;
+        treePolygons = nil;
+        
+        containsRequestIds = [[NSMutableSet alloc] init];
+        boundaryRequests = [[NSMutableDictionary alloc] init];
+        forwardedRequestIds = [[NSMutableSet alloc] init];
+        localRequestCount = 0;
+        
+        prepareQueue = dispatch_queue_create("com.simplegeo.layerupdater.polygoncache", NULL);
+        
+        [[SGLocationService sharedLocationService] addDelegate:self];
+    }
+    
+    return self;
+}
+
+- (void) setMaxPolygonCount:(NSUInteger)count
+{
+    maxPolygonCount = count;
+    [self removeLeastRecentlyUsedPolygons];
+}
+
+- (void) setMaxConeCount:(NSUInteger)count
+{
+    maxConeCount = count;
+    if([cones count] > maxConeCount)
+        [cones removeObjectsInRange:NSMakeRange(0, [cones count] - maxConeCount)];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark PushPin 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (NSString*) contains:(CLLocationCoordinate2D)coordinate
+{
+    NSArray* features = [self featuresContainingCoordinate:coordinate];
+    if(features) {
+        hitCount++;
+        localRequestCount++;
+        NSString* requestId = [NSString stringWithFormat:@"polygoncache-%lu", (unsigned long)localRequestCount];
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [delegate locationService:[SGLocationService sharedLocationService] succeededForResponseId:requestId responseObject:features];
+        });
+        
+        return requestId;
+    }
+    
+    missCount++;
+    NSString* requestId = [[SGLocationService sharedLocationService] contains:coordinate];
+    if(requestId) {
+        [containsRequestIds addObject:requestId];
+        [forwardedRequestIds addObject:requestId];
+    }
+    
+    return requestId;
+}
+
+- (NSString*) boundary:(NSString*)featureId
+{
+    NSString* requestId = [[SGLocationService sharedLocationService] boundary:featureId];
+    if(requestId) {
+        [boundaryRequests setObject:featureId forKey:requestId];
+        [forwardedRequestIds addObject:requestId];
+    }
+    
+    return requestId;
+}
+
+- (SGPreparedPolygon*) addBoundary:(NSDictionary*)feature
+{
+    SGPreparedPolygon* polygon = [[[SGPreparedPolygon alloc] initWithFeature:feature] autorelease];
+    if(polygon)
+        [self addPolygon:polygon];
+    
+    return polygon;
+}
+
+- (SGPreparedPolygon*) polygonWithFeatureId:(NSString*)featureId
+{
+    return [polygons objectForKey:featureId];
+}
+
+- (NSArray*) polygonsContainingCoordinate:(CLLocationCoordinate2D)coordinate
+{
+    if(!tree)
+        [self buildTree];
+    
+    NSMutableArray* containingPolygons = [NSMutableArray array];
+    NSIndexSet* indexes = [tree indexesContainingCoordinate:coordinate];
+    for(NSUInteger i = [indexes firstIndex]; i != NSNotFound; i = [indexes indexGreaterThanIndex:i]) {
+        SGPreparedPolygon* polygon = [treePolygons objectAtIndex:i];
+        if([polygon containsCoordinate:coordinate])
+            [containingPolygons addObject:polygon];
+    }
+    
+    return containingPolygons;
+}
+
+- (NSArray*) featuresContainingCoordinate:(CLLocationCoordinate2D)coordinate
+{
+    NSArray* containingPolygons = [self polygonsContainingCoordinate:coordinate];
+    if(![containingPolygons count])
+        return nil;
+    
+    NSMutableSet* containingFeatureIds = [NSMutableSet setWithCapacity:[containingPolygons count]];
+    for(SGPreparedPolygon* polygon in containingPolygons)
+        [containingFeatureIds addObject:polygon.featureId];
+    
+    // A cone only answers when the kept boundaries around the coordinate are
+    // exactly its features. A cone with fewer features, such as the country
+    // without the city, would leave out a feature that is known to contain
+    // the coordinate.
+    NSArray* matchingCone = nil;
+    for(NSArray* cone in [cones reverseObjectEnumerator])
+        if([[NSSet setWithArray:cone] isEqualToSet:containingFeatureIds]) {
+            matchingCone = [[cone retain] autorelease];
+            break;
+        }
+    
+    if(!matchingCone)
+        return nil;
+    
+    [cones removeObject:matchingCone];
+    [cones addObject:matchingCone];
+    
+    NSMutableArray* features = [NSMutableArray arrayWithCapacity:[matchingCone count]];
+    for(NSString* featureId in matchingCone) {
+        [features addObject:[[polygons objectForKey:featureId] feature]];
+        [recentFeatureIds removeObject:featureId];
+        [recentFeatureIds addObject:featureId];
+    }
+    
+    return features;
+}
+
+- (void) removeAllPolygons
+{
+    [polygons removeAllObjects];
+    [recentFeatureIds removeAllObjects];
+    [cones removeAllObjects];
+    
+    [tree release];
+    tree = nil;
+    [treePolygons release];
+    treePolygons = nil;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark SGLocationService delegate methods 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (void) locationService:(SGLocationService*)service succeededForResponseId:(NSString*)requestId responseObject:(NSObject*)responseObject
+{
+    dispatch_async(dispatch_get_main_queue(), ^{
+        BOOL forwarded = [forwardedRequestIds containsObject:requestId];
+        [forwardedRequestIds removeObject:requestId];
+        
+        if([containsRequestIds containsObject:requestId]) {
+            [containsRequestIds removeObject:requestId];
+            if([responseObject isKindOfClass:[NSArray class]])
+                [self addCone:(NSArray*)responseObject];
+        } else if([boundaryRequests objectForKey:requestId]) {
+            // Large boundaries have many thousands of edges, so they are
+            // prepared off the main thread.
+            [boundaryRequests removeObjectForKey:requestId];
+            dispatch_async(prepareQueue, ^{
+                SGPreparedPolygon* polygon = [[SGPreparedPolygon alloc] initWithFeature:(NSDictionary*)responseObject];
+                dispatch_async(dispatch_get_main_queue(), ^{
+                    if(polygon)
+                        [self addPolygon:polygon];
+                    
+                    [polygon release];
+                });
+            });
+        }
+        
+        if(forwarded)
+            [delegate locationService:service succeededForResponseId:requestId responseObject:responseObject];
+    });
+}
+
+- (void) locationService:(SGLocationService*)service failedForResponseId:(NSString*)requestId error:(NSError*)error
+{
+    dispatch_async(dispatch_get_main_queue(), ^{
+        BOOL forwarded = [forwardedRequestIds containsObject:requestId];
+        [forwardedRequestIds removeObject:requestId];
+        [containsRequestIds removeObject:requestId];
+        [boundaryRequests removeObjectForKey:requestId];
+        
+        if(forwarded)
+            [delegate locationService:service failedForResponseId:requestId error:error];
+    });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Utility methods 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (void) addCone:(NSArray*)features
+{
+    NSMutableArray* featureIds = [NSMutableArray arrayWithCapacity:[features count]];
+    for(NSDictionary* feature in features) {
+        id featureId = [feature isKindOfClass:[NSDictionary class]] ? [feature objectForKey:@"id"] : nil;
+        if([featureId isKindOfClass:[NSString class]])
+            [featureIds addObject:featureId];
+    }
+    
+    // A coordinate outside every feature can not be recognized later.
+    if(![featureIds count] || !maxConeCount)
+        return;
+    
+    [cones removeObject:featureIds];
+    [cones addObject:featureIds];
+    if([cones count] > maxConeCount)
+        [cones removeObjectAtIndex:0];
+    
+    if(loadsBoundaries)
+        [self loadBoundariesForFeatureIds:featureIds];
+}
+
+- (void) loadBoundariesForFeatureIds:(NSArray*)featureIds
+{
+    SGLocationService* locationService = [SGLocationService sharedLocationService];
+    NSArray* loadingFeatureIds = [boundaryRequests allValues];
+    for(NSString* featureId in featureIds)
+        if(![polygons objectForKey:featureId] && ![loadingFeatureIds containsObject:featureId]) {
+            NSString* requestId = [locationService boundary:featureId];
+            if(requestId)
+                [boundaryRequests setObject:featureId forKey:requestId];
+        }
+}
+
+- (void) addPolygon:(SGPreparedPolygon*)polygon
+{
+    [polygons setObject:polygon forKey:polygon.featureId];
+    [recentFeatureIds removeObject:polygon.featureId];
+    [recentFeatureIds addObject:polygon.featureId];
+    
+    [tree release];
+    tree = nil;
+    
+    [self removeLeastRecentlyUsedPolygons];
+}
+
+- (void) removeLeastRecentlyUsedPolygons
+{
+    while([recentFeatureIds count] > maxPolygonCount) {
+        [polygons removeObjectForKey:[recentFeatureIds objectAtIndex:0]];
+        [recentFeatureIds removeObjectAtIndex:0];
+        
+        [tree release];
+        tree = nil;
+    }
+}
+
+- (void) buildTree
+{
+    // The tree is packed again the next time it is needed after the
+    // boundaries change, which is rare next to lookups.
+    [treePolygons release];
+    treePolygons = [[polygons allValues] retain];
+    
+    NSUInteger count = [treePolygons count];
+    SGEnvelope* envelopes = malloc(sizeof(SGEnvelope) * MAX(count, 1));
+    for(NSUInteger i = 0; i < count; i++)
+        envelopes[i] = [[treePolygons objectAtIndex:i] envelope];
+    
+    tree = [[SGEnvelopeTree alloc] initWithEnvelopes:envelopes count:count];
+    free(envelopes);
+}
+
+- (void) dealloc
+{
+    [[SGLocationService sharedLocationService] removeDelegate:self];
+    
+    [polygons release];
+    [recentFeatureIds release];
+    [cones release];
+    [tree release];
+    [treePolygons release];
+    
+    [containsRequestIds release];
+    [boundaryRequests release];
+    [forwardedRequestIds release];
+    
+    dispatch_release(prepareQueue);
+    
+    [super dealloc];
+}
+
+@end
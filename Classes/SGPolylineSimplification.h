@@ -0,0 +1,56 @@
+//
+//  SGPolylineSimplification.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+
+#import <Foundation/Foundation.h>
+#import <MapKit/MapKit.h>
+
+/*!
+* @function SGSimplifyMapPoints(const MKMapPoint*, const uint32_t*, NSUInteger, double, uint32_t*)
+* @abstract Drops the points of a line that are within a tolerance of the
+* line through the others, with Douglas-Peucker.
+* @discussion The line is given by the indexes of its points so that a line
+* can be simplified again without copying points. The first and last points
+* are always kept.
+* @param points The points the indexes refer to.
+* @param indexes The indexes of the points of the line, in order.
+* @param count The amount of indexes.
+* @param tolerance The distance in map points a dropped point can be from the
+* simplified line.
+* @param simplifiedIndexes Receives the indexes of the points that are kept,
+* in order. Has room for count indexes and can be the same as indexes.
+* @result The amount of points that are kept.
+*/
+extern NSUInteger SGSimplifyMapPoints(const MKMapPoint* points, const uint32_t* indexes, NSUInteger count, double tolerance, uint32_t* simplifiedIndexes);
@@ -0,0 +1,112 @@
+//
+//  SGPolylineSimplification.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+
+#import "SGPolylineSimplification.h"
+
+static inline double SGSquaredSegmentDistance(MKMapPoint point, MKMapPoint start, MKMapPoint end);
+
+NSUInteger SGSimplifyMapPoints(const MKMapPoint* points, const uint32_t* indexes, NSUInteger count, double tolerance, uint32_t* simplifiedIndexes)
+{
+    if(count <= 2) {
+        memmove(simplifiedIndexes, indexes, sizeof(uint32_t) * count);
+        return count;
+    }
+    
+    // The spans left to split are kept on a stack instead of recursing, since
+    // a long track that doubles back on itself can nest very deeply. Every
+    // span on the stack ends at a kept point, so there are fewer spans than
+    // points.
+    BOOL* kept = calloc(count, sizeof(BOOL));
+    NSUInteger* spans = malloc(sizeof(NSUInteger) * 2 * count);
+    NSUInteger spanCount = 0;
+    double squaredTolerance = tolerance * tolerance;
+    
+    kept[0] = kept[count - 1] = YES;
+    spans[spanCount++] = 0;
+    spans[spanCount++] = count - 1;
+    while(spanCount) {
+        NSUInteger last = spans[--spanCount];
+        NSUInteger first = spans[--spanCount];
+        MKMapPoint start = points[indexes[first]];
+        MKMapPoint end = points[indexes[last]];
+        
+        NSUInteger farthest = first;
+        double farthestDistance = squaredTolerance;
+        for(NSUInteger i = first + 1; i < last; i++) {
+            double distance = SGSquaredSegmentDistance(points[indexes[i]], start, end);
+            if(distance > farthestDistance) {
+                farthest = i;
+                farthestDistance = distance;
+            }
+        }
+        
+        if(farthest != first) {
+            kept[farthest] = YES;
+            if(farthest - first > 1) {
+                spans[spanCount++] = first;
+                spans[spanCount++] = farthest;
+            }
+            
+            if(last - farthest > 1) {
+                spans[spanCount++] = farthest;
+                spans[spanCount++] = last;
+            }
+        }
+    }
+    
+    NSUInteger simplifiedCount = 0;
+    for(NSUInteger i = 0; i < count; i++)
+        if(kept[i])
+            simplifiedIndexes[simplifiedCount++] = indexes[i];
+    
+    free(kept);
+    free(spans);
+    
+    return simplifiedCount;
+}
+
+static inline double SGSquaredSegmentDistance(MKMapPoint point, MKMapPoint start, MKMapPoint end)
+{
+    double dx = end.x - start.x;
+    double dy = end.y - start.y;
+    double length = dx * dx + dy * dy;
+    double t = length > 0.0 ? ((point.x - start.x) * dx + (point.y - start.y) * dy) / length : 0.0;
+    t = MAX(0.0, MIN(t, 1.0));
+    
+    double x = start.x + t * dx - point.x;
+    double y = start.y + t * dy - point.y;
+    return x * x + y * y;
+}
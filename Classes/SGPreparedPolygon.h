@@ -0,0 +1,117 @@
+//
+//  SGPreparedPolygon.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import <Foundation/Foundation.h>
+#import <CoreLocation/CoreLocation.h>
+
+typedef struct {
+
+    double latitude;
+    double longitude;
+    double otherLatitude;
+    double otherLongitude;
+
+} SGPolygonEdge;
+
+/*!
+* @class SGPreparedPolygon
+* @abstract A boundary from the SimpleGeo gazetteer that is ready for fast
+* point-in-polygon tests.
+* @discussion The edges of every ring, holes included, are kept in one array.
+* The polygon is cut into latitude bands and every band lists the edges that
+* reach into it, so a test only looks at the edges of one band. A coordinate
+* is inside if a line from it to the east crosses an odd amount of edges,
+* which handles holes and multipolygons alike.
+*/
+@interface SGPreparedPolygon : NSObject {
+
+    @private
+    NSString* featureId;
+    NSDictionary* feature;
+    SGEnvelope envelope;
+    
+    SGPolygonEdge* edges;
+    NSUInteger edgeCount;
+    NSUInteger* bandStarts;
+    NSUInteger* bandEdges;
+    NSUInteger bandCount;
+    double bandHeight;
+}
+
+/*!
+* @property
+* @abstract The id of the feature in the gazetteer.
+*/
+@property (nonatomic, readonly) NSString* featureId;
+
+/*!
+* @property
+* @abstract The feature without its geometry, in the form that
+* @link //simplegeo/ooc/instm/SGLocationService/contains: contains: @/link
+* returns.
+*/
+@property (nonatomic, readonly) NSDictionary* feature;
+
+/*!
+* @property
+* @abstract The bounds of the polygon.
+*/
+@property (nonatomic, readonly) SGEnvelope envelope;
+
+/*!
+* @property
+* @abstract The amount of edges that are not horizontal.
+*/
+@property (nonatomic, readonly) NSUInteger edgeCount;
+
+/*!
+* @method initWithFeature:
+* @abstract Prepares the geometry of a feature.
+* @param feature A feature returned by
+* @link //simplegeo/ooc/instm/SGLocationService/boundary: boundary: @/link.
+* @result nil if the feature has no id or its geometry is not a Polygon or
+* a MultiPolygon.
+*/
+- (id) initWithFeature:(NSDictionary*)feature;
+
+/*!
+* @method containsCoordinate:
+* @abstract Tests a coordinate against the polygon.
+* @param coordinate The coordinate.
+* @result YES if the coordinate is inside the polygon and not in a hole.
+*/
+- (BOOL) containsCoordinate:(CLLocationCoordinate2D)coordinate;
+
+@end
@@ -0,0 +1,242 @@
+//
+//  SGPreparedPolygon.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import "SGPreparedPolygon.h"
+
+#define kSGPreparedPolygon_EdgesPerBand     4
+#define kSGPreparedPolygon_MaxBandCount     1024
+
+@interface SGPreparedPolygon (Private)
+
+- (void) addEdgesWithPolygons:(NSArray*)polygons;
+- (void) buildBands;
+
+@end
+
+static BOOL SGGetPosition(id position, double* latitude, double* longitude);
+static NSUInteger SGBandForLatitude(double latitude, double south, double bandHeight, NSUInteger bandCount);
+
+@implementation SGPreparedPolygon
+@synthesize featureId, feature, envelope, edgeCount;
+
+- (id) initWithFeature:(NSDictionary*)newFeature
+{
+    id identifier = nil;
+    NSArray* polygons = nil;
+    if([newFeature isKindOfClass:[NSDictionary class]]) {
+        identifier = [newFeature objectForKey:@"id"];
+        NSDictionary* geometry = [newFeature geometry];
+        if([geometry isKindOfClass:[NSDictionary class]]) {
+            if([geometry isPolygon])
+                polygons = [NSArray arrayWithObject:[geometry coordinates]];
+            else if([geometry isMultiPolygon])
+                polygons = [geometry coordinates];
+        }
+    }
+    
+    if(![identifier isKindOfClass:[NSString class]] || ![polygons isKindOfClass:[NSArray class]]) {
+        [self release];
+        return nil;
+    }
+    
+    if(self = [super init]) {
+        featureId = [identifier copy];
+        
+        NSMutableDictionary* strippedFeature = [newFeature mutableCopy];
+        [strippedFeature removeObjectForKey:@"geometry"];
+        feature = [strippedFeature copy];
+        [strippedFeature release];
+        
+        [self addEdgesWithPolygons:polygons];
+        if(!edgeCount) {
+            [self release];
+            return nil;
+        }
+        
+        [self buildBands];
+    }
+    
+    return self;
+}
+
+- (BOOL) containsCoordinate:(CLLocationCoordinate2D)coordinate
+{
+    double latitude = coordinate.latitude;
+    double longitude = coordinate.longitude;
+    if(!(latitude >= envelope.south && latitude <= envelope.north && longitude >= envelope.west && longitude <= envelope.east))
+        return NO;
+    
+    // An edge is crossed if one end is above the coordinate and the other is
+    // not, and it passes the latitude east of the coordinate.
+    BOOL inside = NO;
+    NSUInteger band = SGBandForLatitude(latitude, envelope.south, bandHeight, bandCount);
+    for(NSUInteger i = bandStarts[band]; i < bandStarts[band + 1]; i++) {
+        SGPolygonEdge* edge = &edges[bandEdges[i]];
+        if((edge->latitude > latitude) != (edge->otherLatitude > latitude)) {
+            double crossing = edge->longitude + (latitude - edge->latitude) *
+                (edge->otherLongitude - edge->longitude) / (edge->otherLatitude - edge->latitude);
+            if(longitude < crossing)
+                inside = !inside;
+        }
+    }
+    
+    return inside;
+}
+
+- (void) addEdgesWithPolygons:(NSArray*)polygons
+{
+    NSUInteger maxEdgeCount = 0;
+    for(NSArray* rings in polygons)
+        if([rings isKindOfClass:[NSArray class]])
+            for(NSArray* ring in rings)
+                if([ring isKindOfClass:[NSArray class]])
+                    maxEdgeCount += [ring count];
+    
+    edges = malloc(sizeof(SGPolygonEdge) * MAX(maxEdgeCount, 1));
+    edgeCount = 0;
+    
+    BOOL hasVertex = NO;
+    for(NSArray* rings in polygons) {
+        if(![rings isKindOfClass:[NSArray class]])
+            continue;
+        
+        for(NSArray* ring in rings) {
+            if(![ring isKindOfClass:[NSArray class]])
+                continue;
+            
+            // Rings are closed whether or not the last position repeats the
+            // first one. A repeated position adds a horizontal edge, which
+            // is dropped.
+            double firstLatitude, firstLongitude, latitude, longitude;
+            NSUInteger vertexCount = 0;
+            for(id position in ring) {
+                double nextLatitude, nextLongitude;
+                if(!SGGetPosition(position, &nextLatitude, &nextLongitude))
+                    continue;
+                
+                if(!hasVertex) {
+                    envelope = SGEnvelopeMake(nextLatitude, nextLongitude, nextLatitude, nextLongitude);
+                    hasVertex = YES;
+                }
+                
+                envelope.south = MIN(envelope.south, nextLatitude);
+                envelope.west = MIN(envelope.west, nextLongitude);
+                envelope.north = MAX(envelope.north, nextLatitude);
+                envelope.east = MAX(envelope.east, nextLongitude);
+                
+                if(vertexCount) {
+                    if(nextLatitude != latitude)
+                        edges[edgeCount++] = (SGPolygonEdge){latitude, longitude, nextLatitude, nextLongitude};
+                } else {
+                    firstLatitude = nextLatitude;
+                    firstLongitude = nextLongitude;
+                }
+                
+                latitude = nextLatitude;
+                longitude = nextLongitude;
+                vertexCount++;
+            }
+            
+            if(vertexCount > 2 && firstLatitude != latitude)
+                edges[edgeCount++] = (SGPolygonEdge){latitude, longitude, firstLatitude, firstLongitude};
+        }
+    }
+}
+
+- (void) buildBands
+{
+    bandCount = MAX(MIN(edgeCount / kSGPreparedPolygon_EdgesPerBand, kSGPreparedPolygon_MaxBandCount), 1);
+    bandHeight = (envelope.north - envelope.south) / bandCount;
+    
+    // The edges of every band are stored one band after the other, with
+    // bandStarts pointing at the first one of each.
+    bandStarts = calloc(bandCount + 1, sizeof(NSUInteger));
+    for(NSUInteger i = 0; i < edgeCount; i++) {
+        NSUInteger first = SGBandForLatitude(MIN(edges[i].latitude, edges[i].otherLatitude), envelope.south, bandHeight, bandCount);
+        NSUInteger last = SGBandForLatitude(MAX(edges[i].latitude, edges[i].otherLatitude), envelope.south, bandHeight, bandCount);
+        for(NSUInteger band = first; band <= last; band++)
+            bandStarts[band + 1]++;
+    }
+    
+    for(NSUInteger band = 0; band < bandCount; band++)
+        bandStarts[band + 1] += bandStarts[band];
+    
+    NSUInteger* cursors = malloc(sizeof(NSUInteger) * bandCount);
+    memcpy(cursors, bandStarts, sizeof(NSUInteger) * bandCount);
+    bandEdges = malloc(sizeof(NSUInteger) * MAX(bandStarts[bandCount], 1));
+    for(NSUInteger i = 0; i < edgeCount; i++) {
+        NSUInteger first = SGBandForLatitude(MIN(edges[i].latitude, edges[i].otherLatitude), envelope.south, bandHeight, bandCount);
+        NSUInteger last = SGBandForLatitude(MAX(edges[i].latitude, edges[i].otherLatitude), envelope.south, bandHeight, bandCount);
+        for(NSUInteger band = first; band <= last; band++)
+            bandEdges[cursors[band]++] = i;
+    }
+    
+    free(cursors);
+}
+
+- (void) dealloc
+{
+    [featureId release];
+    [feature release];
+    
+    free(edges);
+    free(bandStarts);
+    free(bandEdges);
+    
+    [super dealloc];
+}
+
+@end
+
+static BOOL SGGetPosition(id position, double* latitude, double* longitude)
+{
+    if(![position isKindOfClass:[NSArray class]] || [position count] < 2)
+        return NO;
+    
+    id longitudeNumber = [position objectAtIndex:0];
+    id latitudeNumber = [position objectAtIndex:1];
+    if(![longitudeNumber isKindOfClass:[NSNumber class]] || ![latitudeNumber isKindOfClass:[NSNumber class]])
+        return NO;
+    
+    *latitude = [latitudeNumber doubleValue];
+    *longitude = [longitudeNumber doubleValue];
+    return YES;
+}
+
+static NSUInteger SGBandForLatitude(double latitude, double south, double bandHeight, NSUInteger bandCount)
+{
+    long band = (long)floor((latitude - south) / bandHeight);
+    return (NSUInteger)MIN(MAX(band, 0L), (long)bandCount - 1);
+}
@@ -0,0 +1,360 @@
+//
+//  SGRecordMapView.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import <Foundation/Foundation.h>
+#import <MapKit/MapKit.h>
+#import <QuartzCore/QuartzCore.h>
+
+#import "SGTileCache.h"
+#import "SGClusterTree.h"
+#import "SGClusterAnnotation.h"
+#import "SGRecordQuadtree.h"
+#import "SGHistoryLoader.h"
+#import "SGLayerSnapshot.h"
+#import "SGTimeIndex.h"
+#import "SGAnnotationViewPool.h"
+
+/*!
+* @class SGRecordMapView
+* @abstract A @link //simplegeo/ooc/cl/SGLayerMapView SGLayerMapView @/link that
+* loads its layers tile by tile.
+* @discussion The visible region is split into a grid of geohash tiles. The
+* precision of the grid follows the zoom level so the region never needs more
+* than @link maxTileCount maxTileCount @/link tiles. Every tile is fetched
+* with its own @link //simplegeo/ooc/cl/SGGeohashNearbyQuery SGGeohashNearbyQuery @/link
+* and the result is kept in an @link //simplegeo/ooc/cl/SGTileCache SGTileCache @/link,
+* so panning only loads the tiles that came into view. Tiles that are already
+* cached and still fresh are never requested again.
+*
+* The requests of a refresh are sent in one burst. Once the burst has been
+* answered the responses are decoded in a single pass, each record is built by
+* the @link //simplegeo/ooc/cl/SGLayer SGLayer @/link it belongs to, and the
+* annotations of every layer are assembled from the cached tiles. Each layer
+* is reconciled with the map through an
+* @link //simplegeo/ooc/cl/SGAnnotationChangeset SGAnnotationChangeset @/link
+* so only inserted, removed and updated records touch the map.
+*
+* When @link clustersAnnotations clustersAnnotations @/link is set, the records
+* of each layer go into an @link //simplegeo/ooc/cl/SGClusterTree SGClusterTree @/link
+* and the map shows @link //simplegeo/ooc/cl/SGClusterAnnotation SGClusterAnnotations @/link
+* for the current zoom level instead, never more than
+* @link maxVisibleAnnotations maxVisibleAnnotations @/link in total. Moving the
+* map only regroups what is visible; the trees are rebuilt when the records
+* change.
+*
+* When @link thinsAnnotations thinsAnnotations @/link is set instead, each
+* layer is indexed by an @link //simplegeo/ooc/cl/SGRecordQuadtree SGRecordQuadtree @/link
+* and the map shows the records with the highest
+* @link priorityKey priorityKey @/link value in every visible cell. Thinning
+* takes precedence over clustering.
+*
+* If @link loadsHistory loadsHistory @/link is set, the history of every
+* record that comes on screen is loaded by an
+* @link //simplegeo/ooc/cl/SGHistoryLoader SGHistoryLoader @/link and drawn as
+* an @link //simplegeo/ooc/cl/SGRecordLine SGRecordLine @/link overlay.
+*
+* The tiles are requested for the whole range between
+* @link //simplegeo/ooc/instp/SGLayerMapView/requestStartTime requestStartTime @/link
+* and @link //simplegeo/ooc/instp/SGLayerMapView/requestEndTime requestEndTime @/link.
+* Within that range a playback window can be set with
+* @link setPlaybackStartTime:endTime: setPlaybackStartTime:endTime: @/link.
+* The records of each layer are then kept in an
+* @link //simplegeo/ooc/cl/SGTimeIndex SGTimeIndex @/link and the history
+* lines are cut to the same window, so moving the window never sends a
+* request and only the records that enter or leave it touch the map. Without
+* clustering or thinning, moving the window only looks at the time buckets
+* that changed. A cluster tree is updated from the records that came and
+* went, which is linear in the window instead of a full sort. A thinning
+* quadtree is rebuilt over the whole window every time it moves.
+*
+* Decoding, caching, building the trees and computing the changesets happen
+* on a serial queue. The main thread only receives finished changesets and
+* applies them in small steps from a display link, spending no more than
+* @link frameTimeBudget frameTimeBudget @/link per frame.
+*
+* Annotation views can be taken from
+* @link //simplegeo/ooc/cl/SGAnnotationViewPool SGAnnotationViewPools @/link
+* that are added with @link addAnnotationViewPool: addAnnotationViewPool: @/link.
+* Whenever the map is idle the pools are warmed up to the amount of views
+* that may still come on screen, split across the pools by how many views of
+* each kind are shown.
+*
+* Refreshes are driven by the viewport and only happen after the region has
+* been still for @link debounceTimeInterval debounceTimeInterval @/link. A tile
+* goes stale after
+* @link //simplegeo/ooc/instp/SGLayerMapView/reloadTimeInterval reloadTimeInterval @/link;
+* the reload timer only refetches stale tiles and is skipped while the
+* application is in the background.
+*
+* The cached records of the visible tiles can be written to an
+* @link //simplegeo/ooc/cl/SGLayerSnapshot SGLayerSnapshot @/link when the
+* application leaves the foreground. Restoring it on the next launch shows
+* the pins before any request has been sent; the restored tiles are stale, so
+* the first refresh reconciles them with SimpleGeo.
+*/
+@interface SGRecordMapView : SGLayerMapView <SGHistoryLoaderDelegate> {
+
+    NSTimeInterval debounceTimeInterval;
+    NSUInteger maxTileCount;
+    
+    BOOL clustersAnnotations;
+    NSUInteger maxVisibleAnnotations;
+    CGFloat clusterCellSize;
+    
+    BOOL thinsAnnotations;
+    NSString* priorityKey;
+    
+    BOOL loadsHistory;
+    NSTimeInterval frameTimeBudget;
+    
+    NSTimeInterval playbackStartTime;
+    NSTimeInterval playbackEndTime;
+    NSTimeInterval playbackBucketInterval;
+    
+    @private
+    NSMutableDictionary* recordLayers;
+    NSMutableDictionary* layerAnnotations;
+    NSMutableDictionary* layerVersions;
+    NSMutableDictionary* clusterTrees;
+    NSMutableDictionary* recordQuadtrees;
+    NSMutableDictionary* timeIndexes;
+    NSMutableDictionary* playbackRanges;
+    NSMutableDictionary* annotationViewPools;
+    
+    SGHistoryLoader* historyLoader;
+    
+    dispatch_queue_t pipelineQueue;
+    NSMutableArray* pendingChanges;
+    CADisplayLink* displayLink;
+    
+    SGTileCache* tileCache;
+    NSDictionary* visibleTiles;
+    
+    NSMutableDictionary* tileResponseIds;
+    NSMutableSet* pendingTiles;
+    NSMutableArray* tileResponses;
+    NSUInteger burstNumber;
+    NSUInteger burstOutstanding;
+    
+    NSTimer* reloadTimer;
+    BOOL retrieving;
+    BOOL regionChanging;
+}
+
+/*!
+* @property
+* @abstract The time (expressed in seconds) the region has to stay still
+* before the map reloads. The default is 0.3.
+*/
+@property (nonatomic, assign) NSTimeInterval debounceTimeInterval;
+
+/*!
+* @property
+* @abstract The most tiles the visible region is split into. The default is 16.
+*/
+@property (nonatomic, assign) NSUInteger maxTileCount;
+
+/*!
+* @property
+* @abstract Groups the records into clusters for the zoom level. The default is NO.
+*/
+@property (nonatomic, assign) BOOL clustersAnnotations;
+
+/*!
+* @property
+* @abstract The most annotations all layers show together when clustering or
+* thinning. The default is 200.
+*/
+@property (nonatomic, assign) NSUInteger maxVisibleAnnotations;
+
+/*!
+* @property
+* @abstract The smallest width of a cluster or thinning cell, in screen points.
+* The default is 60.
+*/
+@property (nonatomic, assign) CGFloat clusterCellSize;
+
+/*!
+* @property
+* @abstract Shows a representative subset of the records for the zoom level.
+* The default is NO.
+*/
+@property (nonatomic, assign) BOOL thinsAnnotations;
+
+/*!
+* @property
+* @abstract The record property that ranks records when thinning. If nil,
+* the most recently created records are shown first. The default is nil.
+*/
+@property (nonatomic, retain) NSString* priorityKey;
+
+/*!
+* @property
+* @abstract Draws the history of the visible records. The default is NO.
+*/
+@property (nonatomic, assign) BOOL loadsHistory;
+
+/*!
+* @property
+* @abstract The loader that builds the history lines. Its limits can be
+* adjusted before @link loadsHistory loadsHistory @/link is set. It
+* releases the history of records whose line is built from it.
+*/
+@property (nonatomic, readonly) SGHistoryLoader* historyLoader;
+
+/*!
+* @property
+* @abstract The time (expressed in seconds) spent applying changes to the map
+* in every frame. The default is 0.004.
+*/
+@property (nonatomic, assign) NSTimeInterval frameTimeBudget;
+
+/*!
+* @property
+* @abstract The beginning of the playback window. The default is 0, which
+* means the window has no beginning.
+*/
+@property (nonatomic, readonly) NSTimeInterval playbackStartTime;
+
+/*!
+* @property
+* @abstract The end of the playback window. The default is 0, which means the
+* window has no end.
+*/
+@property (nonatomic, readonly) NSTimeInterval playbackEndTime;
+
+/*!
+* @property
+* @abstract The width (expressed in seconds) of the time buckets records are
+* grouped into. The default is 60. Takes effect the next time the records
+* are assembled.
+*/
+@property (nonatomic, assign) NSTimeInterval playbackBucketInterval;
+
+/*!
+* @method recordLayers
+* @result The layers that are registered with the map view.
+*/
+- (NSArray*) recordLayers;
+
+/*!
+* @method retrieveLayersIfNeeded
+* @abstract Loads the visible tiles that are missing or stale.
+*/
+- (void) retrieveLayersIfNeeded;
+
+/*!
+* @method reloadLayers
+* @abstract Loads every visible tile again, even the ones that are still
+* fresh. Does nothing while the map view is not retrieving.
+* @discussion @link //simplegeo/ooc/instm/SGLayerMapView/retrieveLayers retrieveLayers @/link
+* is called by the map view on every region change, so it only loads the
+* missing and stale tiles once the map has been still for
+* @link debounceTimeInterval debounceTimeInterval @/link.
+*/
+- (void) reloadLayers;
+
+/*!
+* @method addRecordAnnotation:toLayerId:
+* @abstract Shows a record that was created or changed locally.
+* @discussion The record is put into the cached tile it falls in and the
+* layer is reconciled like after a refresh, so a record that is shown
+* already is updated in place. The tile is loaded again on the next refresh.
+* @param recordAnnotation The record.
+* @param layerId The layer the record belongs to.
+*/
+- (void) addRecordAnnotation:(id<SGRecordAnnotation>)recordAnnotation toLayerId:(NSString*)layerId;
+
+/*!
+* @method removeRecordAnnotation:fromLayerId:
+* @abstract Stops showing a record that was deleted locally.
+* @discussion The record is taken out of the cached visible tiles, which are
+* loaded again on the next refresh.
+* @param recordAnnotation The record.
+* @param layerId The layer the record belongs to.
+*/
+- (void) removeRecordAnnotation:(id<SGRecordAnnotation>)recordAnnotation fromLayerId:(NSString*)layerId;
+
+/*!
+* @method setPlaybackStartTime:endTime:
+* @abstract Shows only the records and history created within a window. Both
+* ends are inclusive.
+* @discussion Moving the window filters the records that are already loaded.
+* Setting both ends to 0 shows everything again.
+* @param startTime The beginning of the window, or 0 for no beginning.
+* @param endTime The end of the window, or 0 for no end.
+*/
+- (void) setPlaybackStartTime:(NSTimeInterval)startTime endTime:(NSTimeInterval)endTime;
+
+/*!
+* @method addAnnotationViewPool:
+* @abstract Registers a pool for its reuse identifier and starts warming it up.
+*/
+- (void) addAnnotationViewPool:(SGAnnotationViewPool*)annotationViewPool;
+
+/*!
+* @method annotationViewPoolWithIdentifier:
+* @result The pool registered for the reuse identifier, or nil.
+*/
+- (SGAnnotationViewPool*) annotationViewPoolWithIdentifier:(NSString*)identifier;
+
+/*!
+* @method dequeueAnnotationViewWithIdentifier:forAnnotation:
+* @abstract Returns a view from the pool of the reuse identifier.
+* @result A view for the annotation. If there is no pool for the identifier,
+* the view from the reuse queue of the map, or nil.
+*/
+- (MKAnnotationView*) dequeueAnnotationViewWithIdentifier:(NSString*)identifier forAnnotation:(id<MKAnnotation>)annotation;
+
+/*!
+* @method writeSnapshotToFile:
+* @abstract Writes the region and the cached records of the visible tiles.
+* @param path The file to write.
+* @result YES if the snapshot was written.
+*/
+- (BOOL) writeSnapshotToFile:(NSString*)path;
+
+/*!
+* @method restoreSnapshotFromFile:
+* @abstract Moves the map to the region of a snapshot and shows its records.
+* @discussion The layers have to be added before the snapshot is restored.
+* Records of layers that are not registered are ignored. The restored tiles
+* are loaded again once the map view is retrieving.
+* @param path The file to read.
+* @result YES if the snapshot could be read.
+*/
+- (BOOL) restoreSnapshotFromFile:(NSString*)path;
+
+@end
@@ -0,0 +1,1146 @@
+//
+//  SGRecordMapView.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import "SGRecordMapView.h"
+#import "SGAnnotationChangeset.h"
+#import "SGGeohashGeometry.h"
+#import "SGEnvelopeGeometry.h"
+#import "SGSimplifiedPolylineView.h"
+
+#define kSGRecordMapView_MaxGeohashPrecision        12
+#define kSGRecordMapView_RepresentativeCount        4
+#define kSGRecordMapView_ChangeBatchSize            32
+
+enum {
+    kSGRecordMapView_RemoveChange = 0,
+    kSGRecordMapView_UpdateChange,
+    kSGRecordMapView_InsertChange
+};
+
+static SGEnvelope SGEnvelopeForRegion(MKCoordinateRegion region);
+static NSDictionary* SGTilesForRegion(MKCoordinateRegion region, NSUInteger maxTileCount);
+
+@interface SGRecordMapView (Private)
+
+- (void) updateVisibleTiles;
+- (void) retrieveTiles;
+- (void) scheduleRetrieval;
+- (SGNearbyQuery*) nearbyQueryForLayer:(SGLayer*)layer geohash:(SGGeohash)geohash;
+- (void) receivedResponse:(NSObject*)responseObject forResponseId:(NSString*)requestId;
+- (void) finishTiles;
+- (void) assembleRecordAnnotations;
+- (void) updateLevelOfDetail;
+- (void) removeRecordId:(NSString*)recordId fromTiles:(NSArray*)tiles layerId:(NSString*)layerId;
+
+- (void) updateAnnotationsWithResponses:(NSArray*)responses assemble:(BOOL)assemble;
+- (void) setRecordAnnotations:(NSArray*)recordAnnotations forLayerId:(NSString*)layerId;
+- (void) insertRecordAnnotations:(NSArray*)inserted removeRecordAnnotations:(NSArray*)removed forLayerId:(NSString*)layerId;
+- (void) buildLevelOfDetailWithRecordAnnotations:(NSArray*)recordAnnotations forLayerId:(NSString*)layerId priorityKey:(NSString*)key thins:(BOOL)thins;
+- (NSArray*) levelOfDetailAnnotationsForLayerId:(NSString*)layerId mapRect:(MKMapRect)mapRect cellSize:(double)cellSize maxCount:(NSUInteger)maxCount thins:(BOOL)thins;
+- (double) cellSizeForVisibleMapRect;
+
+- (void) enqueueChangeset:(SGAnnotationChangeset*)changeset;
+- (void) applyPendingChanges;
+
+- (void) updatePlaybackWindow;
+
+- (void) warmUpAnnotationViewPools;
+- (void) drainAnnotationViewPools;
+
+- (void) loadHistoryForAnnotations:(NSArray*)annotations;
+- (void) removeHistoryForAnnotations:(NSArray*)annotations;
+
+- (void) refreshLayers;
+- (BOOL) isApplicationActive;
+
+@end
+
+@implementation SGRecordMapView
+@synthesize debounceTimeInterval, maxTileCount, clustersAnnotations, maxVisibleAnnotations, clusterCellSize;
+@synthesize thinsAnnotations, priorityKey, loadsHistory, historyLoader, frameTimeBudget;
+@synthesize playbackStartTime, playbackEndTime, playbackBucketInterval;
+
+- (id) initWithFrame:(CGRect)frame
+{
+    if(self = [super initWithFrame:frame]) {
+        recordLayers = [[NSMutableDictionary alloc] init];
+        layerAnnotations = [[NSMutableDictionary alloc] init];
+        layerVersions = [[NSMutableDictionary alloc] init];
+        clusterTrees = [[NSMutableDictionary alloc] init];
+        recordQuadtrees = [[NSMutableDictionary alloc] init];
+        timeIndexes = [[NSMutableDictionary alloc] init];
+        playbackRanges = [[NSMutableDictionary alloc] init];
+        annotationViewPools = [[NSMutableDictionary alloc] init];
+        
+        tileCache = [[SGTileCache alloc] init];
+        visibleTiles = nil;
+        
+        tileResponseIds = [[NSMutableDictionary alloc] init];
+        pendingTiles = [[NSMutableSet alloc] init];
+        tileResponses = [[NSMutableArray alloc] init];
+        burstNumber = 0;
+        burstOutstanding = 0;
+        
+        reloadTimer = nil;
+        retrieving = NO;
+        regionChanging = NO;
+        debounceTimeInterval = 0.3;
+        maxTileCount = 16;
+        clustersAnnotations = NO;
+        maxVisibleAnnotations = 200;
+        clusterCellSize = 60.0;
+        thinsAnnotations = NO;
+        priorityKey = nil;
+        
+        loadsHistory = NO;
+        historyLoader = [[SGHistoryLoader alloc] init];
+        historyLoader.delegate = self;
+        
+        // Once a line holds the points of a record's history, the history
+        // is only a second, larger copy of them.
+        historyLoader.releasesHistory = YES;
+        
+        pipelineQueue = dispatch_queue_create("com.simplegeo.layerupdater.recordmapview", NULL);
+        pendingChanges = [[NSMutableArray alloc] init];
+        displayLink = nil;
+        frameTimeBudget = 0.004;
+        
+        playbackStartTime = 0.0;
+        playbackEndTime = 0.0;
+        playbackBucketInterval = 60.0;
+        
+        // Responses for the tiles are handled here, whether or not the
+        // super class has already registered the view.
+        SGLocationService* locationService = [SGLocationService sharedLocationService];
+        [locationService removeDelegate:self];
+        [locationService addDelegate:self];
+        
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(drainAnnotationViewPools)
+                                                     name:UIApplicationDidReceiveMemoryWarningNotification
+                                                   object:nil];
+    }
+    
+    return self;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Layers 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (NSArray*) recordLayers
+{
+    return [recordLayers allValues];
+}
+
+- (void) addLayers:(NSArray*)layers
+{
+    for(SGLayer* layer in layers)
+        [recordLayers setObject:layer forKey:layer.layerId];
+    
+    [super addLayers:layers];
+}
+
+- (void) addLayer:(SGLayer*)layer
+{
+    [recordLayers setObject:layer forKey:layer.layerId];
+    [super addLayer:layer];
+}
+
+- (void) removeLayers:(NSArray*)layers
+{
+    for(SGLayer* layer in layers)
+        [self removeLayer:layer];
+}
+
+- (void) removeLayer:(SGLayer*)layer
+{
+    NSString* layerId = layer.layerId;
+    dispatch_async(pipelineQueue, ^{
+        [self setRecordAnnotations:nil forLayerId:layerId];
+        [tileCache removeLayer:layerId];
+        [clusterTrees removeObjectForKey:layerId];
+        [recordQuadtrees removeObjectForKey:layerId];
+        [timeIndexes removeObjectForKey:layerId];
+        [playbackRanges removeObjectForKey:layerId];
+    });
+    
+    [recordLayers removeObjectForKey:layerId];
+    [super removeLayer:layer];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Retrieval 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (void) startRetrieving
+{
+    if(!retrieving) {
+        retrieving = YES;
+        tileCache.timeToLive = reloadTimeInterval;
+        if(reloadTimeInterval > 0.0)
+            reloadTimer = [[NSTimer scheduledTimerWithTimeInterval:reloadTimeInterval
+                                                            target:self
+                                                          selector:@selector(refreshLayers)
+                                                          userInfo:nil
+                                                           repeats:YES] retain];
+        
+        [self retrieveLayersIfNeeded];
+    }
+}
+
+- (void) stopRetrieving
+{
+    if(retrieving) {
+        retrieving = NO;
+        [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(retrieveLayersIfNeeded) object:nil];
+        [reloadTimer invalidate];
+        [reloadTimer release];
+        reloadTimer = nil;
+        
+        [tileResponseIds removeAllObjects];
+        [pendingTiles removeAllObjects];
+        [tileResponses removeAllObjects];
+        burstOutstanding = 0;
+    }
+}
+
+- (void) retrieveLayersIfNeeded
+{
+    if(!retrieving || regionChanging)
+        return;
+    
+    // Whatever is already cached for the new region shows up right away. The
+    // missing tiles fill in once their burst has been answered.
+    NSDictionary* previousTiles = [visibleTiles retain];
+    [self updateVisibleTiles];
+    if(![visibleTiles isEqualToDictionary:previousTiles])
+        [self assembleRecordAnnotations];
+    else if(thinsAnnotations || clustersAnnotations)
+        [self updateLevelOfDetail];
+    
+    [previousTiles release];
+    
+    [self retrieveTiles];
+}
+
+- (void) refreshLayers
+{
+    // The timer only refetches the tiles that went stale on a still map.
+    if(!regionChanging && [self isApplicationActive])
+        [self retrieveTiles];
+}
+
+- (void) retrieveLayers
+{
+    // SGLayerMapView calls this after every region change, so it goes
+    // through the cache and the debounce like any other pan.
+    [self scheduleRetrieval];
+}
+
+- (void) reloadLayers
+{
+    if(!retrieving)
+        return;
+    
+    [self updateVisibleTiles];
+    for(NSString* tile in visibleTiles)
+        for(NSString* layerId in recordLayers)
+            [tileCache invalidateTile:tile layer:layerId];
+    
+    [self retrieveTiles];
+}
+
+- (void) scheduleRetrieval
+{
+    if(retrieving && !regionChanging) {
+        [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(retrieveLayersIfNeeded) object:nil];
+        [self performSelector:@selector(retrieveLayersIfNeeded) withObject:nil afterDelay:debounceTimeInterval];
+    }
+}
+
+- (void) updateVisibleTiles
+{
+    MKCoordinateRegion region = self.region;
+    [visibleTiles release];
+    visibleTiles = [SGTilesForRegion(region, maxTileCount) retain];
+}
+
+- (void) retrieveTiles
+{
+    if(!visibleTiles || ![recordLayers count])
+        return;
+    
+    // Responses of an older burst are still cached when they arrive, but only
+    // the newest burst decides when the annotations are assembled.
+    burstNumber++;
+    burstOutstanding = 0;
+    NSNumber* burst = [NSNumber numberWithUnsignedInteger:burstNumber];
+    
+    SGLocationService* locationService = [SGLocationService sharedLocationService];
+    for(NSString* tile in visibleTiles) {
+        SGGeohash geohash;
+        [[visibleTiles objectForKey:tile] getValue:&geohash];
+        
+        for(SGLayer* layer in [recordLayers allValues]) {
+            NSString* pendingKey = [NSString stringWithFormat:@"%@/%@", layer.layerId, tile];
+            if([pendingTiles containsObject:pendingKey] || [tileCache isTileFresh:tile layer:layer.layerId])
+                continue;
+            
+            NSString* requestId = [locationService nearby:[self nearbyQueryForLayer:layer geohash:geohash]];
+            if(requestId) {
+                [tileResponseIds setObject:[NSArray arrayWithObjects:tile, layer.layerId, burst, nil] forKey:requestId];
+                [pendingTiles addObject:pendingKey];
+                burstOutstanding++;
+            }
+        }
+    }
+    
+    if(!burstOutstanding)
+        [self finishTiles];
+}
+
+- (SGNearbyQuery*) nearbyQueryForLayer:(SGLayer*)layer geohash:(SGGeohash)geohash
+{
+    SGGeohashNearbyQuery* query = [[SGGeohashNearbyQuery alloc] initWithLayer:layer.layerId];
+    query.geohash = geohash;
+    
+    if(limit > 0)
+        query.limit = limit;
+    
+    if(requestStartTime > 0.0)
+        query.start = requestStartTime;
+    
+    if(requestEndTime > 0.0)
+        query.end = requestEndTime;
+    
+    return [query autorelease];
+}
+
+- (void) receivedResponse:(NSObject*)responseObject forResponseId:(NSString*)requestId
+{
+    NSArray* tileInfo = [[tileResponseIds objectForKey:requestId] retain];
+    if(!tileInfo)
+        return;
+    
+    NSString* tile = [tileInfo objectAtIndex:0];
+    NSString* layerId = [tileInfo objectAtIndex:1];
+    [tileResponseIds removeObjectForKey:requestId];
+    [pendingTiles removeObject:[NSString stringWithFormat:@"%@/%@", layerId, tile]];
+    
+    [tileResponses addObject:[NSArray arrayWithObjects:tile, layerId, responseObject ? responseObject : [NSNull null], nil]];
+    if([[tileInfo objectAtIndex:2] unsignedIntegerValue] == burstNumber)
+        burstOutstanding--;
+    
+    if(!burstOutstanding)
+        [self finishTiles];
+    
+    [tileInfo release];
+}
+
+- (void) finishTiles
+{
+    if(![tileResponses count])
+        return;
+    
+    NSArray* responses = [NSArray arrayWithArray:tileResponses];
+    [tileResponses removeAllObjects];
+    [self updateAnnotationsWithResponses:responses assemble:YES];
+}
+
+- (void) assembleRecordAnnotations
+{
+    [self updateAnnotationsWithResponses:nil assemble:YES];
+}
+
+- (void) updateLevelOfDetail
+{
+    [self updateAnnotationsWithResponses:nil assemble:NO];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Local changes 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (void) addRecordAnnotation:(id<SGRecordAnnotation>)recordAnnotation toLayerId:(NSString*)layerId
+{
+    if(!visibleTiles)
+        [self updateVisibleTiles];
+    
+    // All visible tiles share one precision, so the tile of the record is
+    // its geohash at that precision.
+    NSArray* tiles = [visibleTiles allKeys];
+    NSString* tile = nil;
+    if([tiles count]) {
+        int precision = (int)[[tiles objectAtIndex:0] length];
+        CLLocationCoordinate2D coordinate = recordAnnotation.coordinate;
+        tile = SGGeohashCodeToString(SGGeohashCodeMake(coordinate.latitude, coordinate.longitude, precision), precision);
+    }
+    
+    NSString* recordId = [recordAnnotation recordId];
+    dispatch_async(pipelineQueue, ^{
+        [self removeRecordId:recordId fromTiles:tiles layerId:layerId];
+        if(tile) {
+            NSMutableArray* recordAnnotations = [NSMutableArray arrayWithArray:[tileCache recordAnnotationsForTile:tile layer:layerId]];
+            [recordAnnotations addObject:recordAnnotation];
+            [tileCache setRecordAnnotations:recordAnnotations forTile:tile layer:layerId];
+            [tileCache invalidateTile:tile layer:layerId];
+        }
+    });
+    
+    [self assembleRecordAnnotations];
+}
+
+- (void) removeRecordAnnotation:(id<SGRecordAnnotation>)recordAnnotation fromLayerId:(NSString*)layerId
+{
+    if(!visibleTiles)
+        [self updateVisibleTiles];
+    
+    NSArray* tiles = [visibleTiles allKeys];
+    NSString* recordId = [recordAnnotation recordId];
+    dispatch_async(pipelineQueue, ^{
+        [self removeRecordId:recordId fromTiles:tiles layerId:layerId];
+    });
+    
+    [self assembleRecordAnnotations];
+}
+
+- (void) removeRecordId:(NSString*)recordId fromTiles:(NSArray*)tiles layerId:(NSString*)layerId
+{
+    // Runs on the pipeline. A tile that held the record is loaded again on
+    // the next refresh, so SimpleGeo gets the final word.
+    for(NSString* tile in tiles) {
+        NSArray* tileAnnotations = [tileCache recordAnnotationsForTile:tile layer:layerId];
+        NSMutableArray* recordAnnotations = [NSMutableArray arrayWithCapacity:[tileAnnotations count]];
+        for(id<SGRecordAnnotation> tileAnnotation in tileAnnotations)
+            if(![[tileAnnotation recordId] isEqualToString:recordId])
+                [recordAnnotations addObject:tileAnnotation];
+        
+        if([recordAnnotations count] != [tileAnnotations count]) {
+            [tileCache setRecordAnnotations:recordAnnotations forTile:tile layer:layerId];
+            [tileCache invalidateTile:tile layer:layerId];
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Snapshots 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (BOOL) writeSnapshotToFile:(NSString*)path
+{
+    if(!visibleTiles)
+        [self updateVisibleTiles];
+    
+    NSArray* tiles = [visibleTiles allKeys];
+    NSArray* layerIds = [recordLayers allKeys];
+    NSMutableDictionary* snapshotTiles = [NSMutableDictionary dictionary];
+    
+    // Going through the pipeline includes every response that was already
+    // handed to it.
+    dispatch_sync(pipelineQueue, ^{
+        for(NSString* tile in tiles) {
+            NSMutableDictionary* tileLayers = [NSMutableDictionary dictionary];
+            for(NSString* layerId in layerIds) {
+                NSArray* recordAnnotations = [tileCache recordAnnotationsForTile:tile layer:layerId];
+                if(recordAnnotations)
+                    [tileLayers setObject:recordAnnotations forKey:layerId];
+            }
+            
+            if([tileLayers count])
+                [snapshotTiles setObject:tileLayers forKey:tile];
+        }
+    });
+    
+    SGLayerSnapshot* snapshot = [[SGLayerSnapshot alloc] initWithRegion:self.region tiles:snapshotTiles];
+    BOOL written = [snapshot writeToFile:path];
+    [snapshot release];
+    
+    return written;
+}
+
+- (BOOL) restoreSnapshotFromFile:(NSString*)path
+{
+    SGLayerSnapshot* snapshot = [SGLayerSnapshot snapshotWithContentsOfFile:path];
+    if(!snapshot)
+        return NO;
+    
+    [self setRegion:snapshot.region animated:NO];
+    [self updateVisibleTiles];
+    
+    NSDictionary* layers = [NSDictionary dictionaryWithDictionary:recordLayers];
+    NSDictionary* tiles = snapshot.tiles;
+    dispatch_async(pipelineQueue, ^{
+        // Each record is rebuilt by its layer, just like a response. Tiles
+        // that were loaded in the meantime are newer than the snapshot.
+        for(NSString* tile in tiles) {
+            NSDictionary* tileLayers = [tiles objectForKey:tile];
+            for(NSString* layerId in tileLayers) {
+                SGLayer* layer = [layers objectForKey:layerId];
+                if(!layer || [tileCache recordAnnotationsForTile:tile layer:layerId])
+                    continue;
+                
+                NSArray* records = [tileLayers objectForKey:layerId];
+                NSMutableArray* recordAnnotations = [NSMutableArray arrayWithCapacity:[records count]];
+                for(SGRecord* record in records) {
+                    id<SGRecordAnnotation> recordAnnotation = [layer recordAnnotationFromGeoJSONObject:[SGGeoJSONEncoder geoJSONObjectForRecordAnnotation:record]];
+                    if(recordAnnotation)
+                        [recordAnnotations addObject:recordAnnotation];
+                }
+                
+                [tileCache setRecordAnnotations:recordAnnotations forTile:tile layer:layerId];
+                [tileCache invalidateTile:tile layer:layerId];
+            }
+        }
+    });
+    
+    [self assembleRecordAnnotations];
+    
+    return YES;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Pipeline 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (void) updateAnnotationsWithResponses:(NSArray*)responses assemble:(BOOL)assemble
+{
+    // Everything the pipeline needs from the view is captured here, so the
+    // work below never touches UIKit or MapKit state.
+    NSDictionary* layers = [NSDictionary dictionaryWithDictionary:recordLayers];
+    NSArray* tiles = [visibleTiles allKeys];
+    NSString* key = [[priorityKey copy] autorelease];
+    BOOL thins = thinsAnnotations;
+    BOOL clusters = clustersAnnotations;
+    BOOL addToLayer = addRetrievedRecordsToLayer;
+    MKMapRect mapRect = self.visibleMapRect;
+    double cellSize = [self cellSizeForVisibleMapRect];
+    NSUInteger maxCount = maxVisibleAnnotations / MAX([recordLayers count], 1);
+    NSTimeInterval startTime = playbackStartTime;
+    NSTimeInterval endTime = playbackEndTime;
+    NSTimeInterval bucketInterval = playbackBucketInterval;
+    BOOL playback = startTime > 0.0 || endTime > 0.0;
+    
+    dispatch_async(pipelineQueue, ^{
+        // A tile whose request failed keeps the records it already has and is
+        // retried on the next refresh.
+        for(NSArray* tileResponse in responses) {
+            SGLayer* layer = [layers objectForKey:[tileResponse objectAtIndex:1]];
+            NSDictionary* geoJSONObject = [tileResponse objectAtIndex:2];
+            if(!layer || ![geoJSONObject isKindOfClass:[NSDictionary class]])
+                continue;
+            
+            NSArray* features = [geoJSONObject features];
+            NSMutableArray* recordAnnotations = [NSMutableArray arrayWithCapacity:[features count]];
+            for(NSDictionary* feature in features) {
+                id<SGRecordAnnotation> recordAnnotation = [layer recordAnnotationFromGeoJSONObject:feature];
+                if(recordAnnotation)
+                    [recordAnnotations addObject:recordAnnotation];
+            }
+            
+            if(addToLayer)
+                dispatch_async(dispatch_get_main_queue(), ^{
+                    [layer addRecordAnnotations:recordAnnotations update:NO];
+                });
+            
+            [tileCache setRecordAnnotations:recordAnnotations forTile:[tileResponse objectAtIndex:0] layer:layer.layerId];
+        }
+        
+        for(NSString* layerId in layers) {
+            NSArray* annotations = nil;
+            if(assemble) {
+                // A record that moved between tiles may be cached in both. The
+                // changeset keeps the first one it sees.
+                NSMutableArray* recordAnnotations = [NSMutableArray array];
+                for(NSString* tile in tiles) {
+                    NSArray* tileAnnotations = [tileCache recordAnnotationsForTile:tile layer:layerId];
+                    if(tileAnnotations)
+                        [recordAnnotations addObjectsFromArray:tileAnnotations];
+                }
+                
+                // Everything that was loaded is indexed, so the playback
+                // window can move without the tiles.
+                NSArray* windowAnnotations = recordAnnotations;
+                if(playback) {
+                    SGTimeIndex* timeIndex = [[SGTimeIndex alloc] initWithRecordAnnotations:recordAnnotations bucketInterval:bucketInterval];
+                    NSRange range = [timeIndex rangeFromTime:startTime toTime:endTime];
+                    [timeIndexes setObject:timeIndex forKey:layerId];
+                    [playbackRanges setObject:[NSValue valueWithRange:range] forKey:layerId];
+                    windowAnnotations = [timeIndex.recordAnnotations subarrayWithRange:range];
+                    [timeIndex release];
+                } else {
+                    [timeIndexes removeObjectForKey:layerId];
+                    [playbackRanges removeObjectForKey:layerId];
+                }
+                
+                if(thins || clusters)
+                    [self buildLevelOfDetailWithRecordAnnotations:windowAnnotations forLayerId:layerId priorityKey:key thins:thins];
+                else
+                    annotations = windowAnnotations;
+            }
+            
+            if(thins || clusters) {
+                annotations = [self levelOfDetailAnnotationsForLayerId:layerId mapRect:mapRect cellSize:cellSize maxCount:maxCount thins:thins];
+                if(!annotations)
+                    continue;
+            }
+            
+            if(annotations)
+                [self setRecordAnnotations:annotations forLayerId:layerId];
+        }
+    });
+}
+
+- (void) setRecordAnnotations:(NSArray*)recordAnnotations forLayerId:(NSString*)layerId
+{
+    // Runs on the pipeline. Only the records that changed will touch the
+    // map; records that are shown already keep their annotation and move in
+    // place.
+    SGAnnotationChangeset* changeset = [[SGAnnotationChangeset alloc] initWithAnnotations:[layerAnnotations objectForKey:layerId]
+                                                                                 versions:[layerVersions objectForKey:layerId]
+                                                                        recordAnnotations:recordAnnotations];
+    if(recordAnnotations) {
+        [layerAnnotations setObject:changeset.annotations forKey:layerId];
+        [layerVersions setObject:changeset.versions forKey:layerId];
+    } else {
+        [layerAnnotations removeObjectForKey:layerId];
+        [layerVersions removeObjectForKey:layerId];
+    }
+    
+    if([changeset hasChanges])
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self enqueueChangeset:changeset];
+        });
+    
+    [changeset release];
+}
+
+- (void) insertRecordAnnotations:(NSArray*)inserted removeRecordAnnotations:(NSArray*)removed forLayerId:(NSString*)layerId
+{
+    // Runs on the pipeline. Unlike setRecordAnnotations:forLayerId: only the
+    // records that come and go are looked at.
+    SGAnnotationChangeset* changeset = [[SGAnnotationChangeset alloc] initWithAnnotations:[layerAnnotations objectForKey:layerId]
+                                                                                 versions:[layerVersions objectForKey:layerId]
+                                                                insertedRecordAnnotations:inserted
+                                                                 removedRecordAnnotations:removed];
+    [layerAnnotations setObject:changeset.annotations forKey:layerId];
+    [layerVersions setObject:changeset.versions forKey:layerId];
+    
+    if([changeset hasChanges])
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self enqueueChangeset:changeset];
+        });
+    
+    [changeset release];
+}
+
+- (void) buildLevelOfDetailWithRecordAnnotations:(NSArray*)recordAnnotations forLayerId:(NSString*)layerId priorityKey:(NSString*)key thins:(BOOL)thins
+{
+    if(thins) {
+        SGRecordQuadtree* quadtree = [[SGRecordQuadtree alloc] initWithRecordAnnotations:recordAnnotations
+                                                                             priorityKey:key
+                                                                     representativeCount:kSGRecordMapView_RepresentativeCount];
+        [recordQuadtrees setObject:quadtree forKey:layerId];
+        [quadtree release];
+    } else {
+        SGClusterTree* clusterTree = [[SGClusterTree alloc] initWithRecordAnnotations:recordAnnotations
+                                                                         previousTree:[clusterTrees objectForKey:layerId]];
+        [clusterTrees setObject:clusterTree forKey:layerId];
+        [clusterTree release];
+    }
+}
+
+- (NSArray*) levelOfDetailAnnotationsForLayerId:(NSString*)layerId mapRect:(MKMapRect)mapRect cellSize:(double)cellSize maxCount:(NSUInteger)maxCount thins:(BOOL)thins
+{
+    if(thins) {
+        SGRecordQuadtree* quadtree = [recordQuadtrees objectForKey:layerId];
+        return quadtree ? [quadtree recordAnnotationsInMapRect:mapRect cellSize:cellSize maxCount:maxCount] : nil;
+    }
+    
+    SGClusterTree* clusterTree = [clusterTrees objectForKey:layerId];
+    return clusterTree ? [clusterTree annotationsInMapRect:mapRect cellSize:cellSize maxCount:maxCount] : nil;
+}
+
+- (double) cellSizeForVisibleMapRect
+{
+    MKMapRect mapRect = self.visibleMapRect;
+    CGFloat width = self.bounds.size.width;
+    return width > 0.0 ? clusterCellSize * mapRect.size.width / width : mapRect.size.width;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Applying changes 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (void) enqueueChangeset:(SGAnnotationChangeset*)changeset
+{
+    // Every changeset is cut into small steps: removals first, then updates,
+    // then insertions. Changesets are applied in the order they were made.
+    NSUInteger batchSize = kSGRecordMapView_ChangeBatchSize;
+    NSArray* removedAnnotations = changeset.removedAnnotations;
+    for(NSUInteger i = 0; i < [removedAnnotations count]; i += batchSize) {
+        NSRange range = NSMakeRange(i, MIN(batchSize, [removedAnnotations count] - i));
+        [pendingChanges addObject:[NSArray arrayWithObjects:[NSNumber numberWithInt:kSGRecordMapView_RemoveChange],
+                                   [removedAnnotations subarrayWithRange:range], nil]];
+    }
+    
+    NSUInteger updateCount = [changeset.updatedAnnotations count];
+    for(NSUInteger i = 0; i < updateCount; i += batchSize) {
+        NSRange range = NSMakeRange(i, MIN(batchSize, updateCount - i));
+        [pendingChanges addObject:[NSArray arrayWithObjects:[NSNumber numberWithInt:kSGRecordMapView_UpdateChange],
+                                   changeset, [NSValue valueWithRange:range], nil]];
+    }
+    
+    NSArray* insertedAnnotations = changeset.insertedAnnotations;
+    for(NSUInteger i = 0; i < [insertedAnnotations count]; i += batchSize) {
+        NSRange range = NSMakeRange(i, MIN(batchSize, [insertedAnnotations count] - i));
+        [pendingChanges addObject:[NSArray arrayWithObjects:[NSNumber numberWithInt:kSGRecordMapView_InsertChange],
+                                   [insertedAnnotations subarrayWithRange:range], nil]];
+    }
+    
+    // The display link retains the view, so it only exists while there is
+    // something to apply.
+    if([pendingChanges count] && !displayLink) {
+        displayLink = [[CADisplayLink displayLinkWithTarget:self selector:@selector(applyPendingChanges)] retain];
+        [displayLink addToRunLoop:[NSRunLoop mainRunLoop] forMode:NSRunLoopCommonModes];
+    }
+}
+
+- (void) applyPendingChanges
+{
+    // At least one step is applied every frame so the queue always drains.
+    CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+    do {
+        NSArray* change = [[pendingChanges objectAtIndex:0] retain];
+        [pendingChanges removeObjectAtIndex:0];
+        
+        switch([[change objectAtIndex:0] intValue]) {
+            case kSGRecordMapView_RemoveChange:
+                [self removeAnnotations:[change objectAtIndex:1]];
+                [self removeHistoryForAnnotations:[change objectAtIndex:1]];
+                break;
+            case kSGRecordMapView_UpdateChange:
+                [[change objectAtIndex:1] applyUpdatesInRange:[[change objectAtIndex:2] rangeValue]];
+                break;
+            case kSGRecordMapView_InsertChange:
+                [self addAnnotations:[change objectAtIndex:1]];
+                [self loadHistoryForAnnotations:[change objectAtIndex:1]];
+                break;
+        }
+        
+        [change release];
+    } while([pendingChanges count] && CFAbsoluteTimeGetCurrent() - start < frameTimeBudget);
+    
+    if(![pendingChanges count]) {
+        [displayLink invalidate];
+        [displayLink release];
+        displayLink = nil;
+        
+        [self warmUpAnnotationViewPools];
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Annotation views 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (void) addAnnotationViewPool:(SGAnnotationViewPool*)annotationViewPool
+{
+    [[annotationViewPools objectForKey:annotationViewPool.reuseIdentifier] drain];
+    [annotationViewPools setObject:annotationViewPool forKey:annotationViewPool.reuseIdentifier];
+    [self warmUpAnnotationViewPools];
+}
+
+- (SGAnnotationViewPool*) annotationViewPoolWithIdentifier:(NSString*)identifier
+{
+    return [annotationViewPools objectForKey:identifier];
+}
+
+- (MKAnnotationView*) dequeueAnnotationViewWithIdentifier:(NSString*)identifier forAnnotation:(id<MKAnnotation>)annotation
+{
+    SGAnnotationViewPool* annotationViewPool = [annotationViewPools objectForKey:identifier];
+    if(annotationViewPool)
+        return [annotationViewPool dequeueAnnotationViewForAnnotation:annotation fromMapView:self];
+    
+    MKAnnotationView* annotationView = [self dequeueReusableAnnotationViewWithIdentifier:identifier];
+    annotationView.annotation = annotation;
+    return annotationView;
+}
+
+- (void) warmUpAnnotationViewPools
+{
+    // The views that can still come on screen are split across the pools
+    // in the proportion their kinds of views are shown now. Before anything
+    // is shown every pool gets an equal share.
+    NSArray* annotations = self.annotations;
+    NSUInteger shownCount = [annotations count];
+    NSUInteger remainingCount = maxVisibleAnnotations > shownCount ? maxVisibleAnnotations - shownCount : 0;
+    
+    NSMutableDictionary* viewCounts = [NSMutableDictionary dictionaryWithCapacity:[annotationViewPools count]];
+    NSUInteger viewCount = 0;
+    for(id<MKAnnotation> annotation in annotations) {
+        NSString* identifier = [self viewForAnnotation:annotation].reuseIdentifier;
+        if(identifier && [annotationViewPools objectForKey:identifier]) {
+            NSUInteger count = [[viewCounts objectForKey:identifier] unsignedIntegerValue];
+            [viewCounts setObject:[NSNumber numberWithUnsignedInteger:count + 1] forKey:identifier];
+            viewCount++;
+        }
+    }
+    
+    for(SGAnnotationViewPool* annotationViewPool in [annotationViewPools allValues]) {
+        if(viewCount)
+            annotationViewPool.targetCount = remainingCount * [[viewCounts objectForKey:annotationViewPool.reuseIdentifier] unsignedIntegerValue] / viewCount;
+        else
+            annotationViewPool.targetCount = remainingCount / [annotationViewPools count];
+        
+        [annotationViewPool warmUp];
+    }
+}
+
+- (void) drainAnnotationViewPools
+{
+    for(SGAnnotationViewPool* annotationViewPool in [annotationViewPools allValues])
+        [annotationViewPool drain];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Level of detail 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (void) setClustersAnnotations:(BOOL)clusters
+{
+    if(clustersAnnotations != clusters) {
+        clustersAnnotations = clusters;
+        dispatch_async(pipelineQueue, ^{ [clusterTrees removeAllObjects]; });
+        [self assembleRecordAnnotations];
+    }
+}
+
+- (void) setThinsAnnotations:(BOOL)thins
+{
+    if(thinsAnnotations != thins) {
+        thinsAnnotations = thins;
+        dispatch_async(pipelineQueue, ^{ [recordQuadtrees removeAllObjects]; });
+        [self assembleRecordAnnotations];
+    }
+}
+
+- (void) setPriorityKey:(NSString*)key
+{
+    if(priorityKey != key) {
+        [priorityKey release];
+        priorityKey = [key retain];
+        
+        if(thinsAnnotations)
+            [self assembleRecordAnnotations];
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Playback 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (void) setPlaybackStartTime:(NSTimeInterval)startTime endTime:(NSTimeInterval)endTime
+{
+    if(playbackStartTime == startTime && playbackEndTime == endTime)
+        return;
+    
+    BOOL wasPlaying = playbackStartTime > 0.0 || playbackEndTime > 0.0;
+    playbackStartTime = startTime;
+    playbackEndTime = endTime;
+    [historyLoader setWindowStartTime:startTime endTime:endTime];
+    
+    // The records are only indexed while there is a window.
+    if(wasPlaying != (startTime > 0.0 || endTime > 0.0))
+        [self assembleRecordAnnotations];
+    else
+        [self updatePlaybackWindow];
+}
+
+- (void) updatePlaybackWindow
+{
+    NSString* key = [[priorityKey copy] autorelease];
+    BOOL thins = thinsAnnotations;
+    BOOL clusters = clustersAnnotations;
+    MKMapRect mapRect = self.visibleMapRect;
+    double cellSize = [self cellSizeForVisibleMapRect];
+    NSUInteger maxCount = maxVisibleAnnotations / MAX([recordLayers count], 1);
+    NSTimeInterval startTime = playbackStartTime;
+    NSTimeInterval endTime = playbackEndTime;
+    
+    dispatch_async(pipelineQueue, ^{
+        for(NSString* layerId in timeIndexes) {
+            SGTimeIndex* timeIndex = [timeIndexes objectForKey:layerId];
+            NSRange oldRange = [[playbackRanges objectForKey:layerId] rangeValue];
+            NSRange newRange = [timeIndex rangeFromTime:startTime toTime:endTime];
+            if(NSEqualRanges(oldRange, newRange))
+                continue;
+            
+            [playbackRanges setObject:[NSValue valueWithRange:newRange] forKey:layerId];
+            
+            NSMutableArray* inserted = [NSMutableArray array];
+            NSMutableArray* removed = [NSMutableArray array];
+            [timeIndex getInsertedRecordAnnotations:inserted removedRecordAnnotations:removed fromRange:oldRange toRange:newRange];
+            
+            // A cluster tree takes the records that come and go. The quadtree
+            // ranks every record in the window, so thinning rebuilds it.
+            SGClusterTree* previousTree = [clusterTrees objectForKey:layerId];
+            if(!thins && clusters && previousTree) {
+                SGClusterTree* clusterTree = [[SGClusterTree alloc] initWithPreviousTree:previousTree
+                                                               insertedRecordAnnotations:inserted
+                                                                removedRecordAnnotations:removed];
+                [clusterTrees setObject:clusterTree forKey:layerId];
+                [clusterTree release];
+            } else if(thins || clusters)
+                [self buildLevelOfDetailWithRecordAnnotations:[timeIndex.recordAnnotations subarrayWithRange:newRange]
+                                                   forLayerId:layerId
+                                                  priorityKey:key
+                                                        thins:thins];
+            
+            if(thins || clusters) {
+                NSArray* annotations = [self levelOfDetailAnnotationsForLayerId:layerId mapRect:mapRect cellSize:cellSize maxCount:maxCount thins:thins];
+                if(annotations)
+                    [self setRecordAnnotations:annotations forLayerId:layerId];
+            } else
+                [self insertRecordAnnotations:inserted removeRecordAnnotations:removed forLayerId:layerId];
+        }
+    });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark History 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (void) setLoadsHistory:(BOOL)loads
+{
+    if(loadsHistory != loads) {
+        NSArray* annotations = self.annotations;
+        if(loads) {
+            loadsHistory = YES;
+            [self loadHistoryForAnnotations:annotations];
+        } else {
+            [self removeHistoryForAnnotations:annotations];
+            [historyLoader cancel];
+            loadsHistory = NO;
+        }
+    }
+}
+
+- (void) loadHistoryForAnnotations:(NSArray*)annotations
+{
+    if(!loadsHistory)
+        return;
+    
+    NSMutableArray* recordAnnotations = [NSMutableArray arrayWithCapacity:[annotations count]];
+    for(id<MKAnnotation> annotation in annotations)
+        if([annotation conformsToProtocol:@protocol(SGHistoricRecordAnnoation)])
+            [recordAnnotations addObject:annotation];
+    
+    [historyLoader loadHistoryForRecordAnnotations:recordAnnotations];
+}
+
+- (void) removeHistoryForAnnotations:(NSArray*)annotations
+{
+    if(!loadsHistory)
+        return;
+    
+    NSMutableArray* recordAnnotations = [NSMutableArray arrayWithCapacity:[annotations count]];
+    for(id<MKAnnotation> annotation in annotations)
+        if([annotation conformsToProtocol:@protocol(SGHistoricRecordAnnoation)]) {
+            SGRecordLine* recordLine = [historyLoader recordLineForRecordAnnotation:(id<SGHistoricRecordAnnoation>)annotation];
+            if(recordLine)
+                [self removeOverlay:recordLine];
+            
+            [recordAnnotations addObject:annotation];
+        }
+    
+    [historyLoader removeRecordAnnotations:recordAnnotations];
+}
+
+- (void) historyLoader:(SGHistoryLoader*)loader didLoadRecordLine:(SGRecordLine*)recordLine
+{
+    [self addOverlay:recordLine];
+}
+
+- (void) historyLoader:(SGHistoryLoader*)loader didUpdateRecordLine:(SGRecordLine*)recordLine mapRect:(MKMapRect)mapRect
+{
+    [[self viewForOverlay:recordLine] setNeedsDisplayInMapRect:mapRect];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark MKMapView delegate methods 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (MKOverlayView*) mapView:(MKMapView*)mapView viewForOverlay:(id<MKOverlay>)overlay
+{
+    MKOverlayView* overlayView = nil;
+    if([SGLayerMapView instancesRespondToSelector:_cmd])
+        overlayView = [super mapView:mapView viewForOverlay:overlay];
+    
+    if(!overlayView && [overlay isKindOfClass:[SGRecordLine class]])
+        overlayView = [[[SGSimplifiedPolylineView alloc] initWithOverlay:overlay] autorelease];
+    
+    return overlayView;
+}
+
+- (void) mapView:(MKMapView*)mapView regionWillChangeAnimated:(BOOL)animated
+{
+    if([SGLayerMapView instancesRespondToSelector:_cmd])
+        [super mapView:mapView regionWillChangeAnimated:animated];
+    
+    regionChanging = YES;
+    [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(retrieveLayersIfNeeded) object:nil];
+}
+
+- (void) mapView:(MKMapView*)mapView regionDidChangeAnimated:(BOOL)animated
+{
+    if([SGLayerMapView instancesRespondToSelector:_cmd])
+        [super mapView:mapView regionDidChangeAnimated:animated];
+    
+    regionChanging = NO;
+    [self scheduleRetrieval];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark SGLocationService delegate methods 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (void) locationService:(SGLocationService*)service succeededForResponseId:(NSString*)requestId responseObject:(NSObject*)responseObject
+{
+    [super locationService:service succeededForResponseId:requestId responseObject:responseObject];
+    
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [self receivedResponse:responseObject forResponseId:requestId];
+    });
+}
+
+- (void) locationService:(SGLocationService*)service failedForResponseId:(NSString*)requestId error:(NSError*)error
+{
+    [super locationService:service failedForResponseId:requestId error:error];
+    
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [self receivedResponse:nil forResponseId:requestId];
+    });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Utility methods 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (BOOL) isApplicationActive
+{
+    UIApplication* application = [UIApplication sharedApplication];
+    return ![application respondsToSelector:@selector(applicationState)] || application.applicationState == UIApplicationStateActive;
+}
+
+- (void) dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    [self stopRetrieving];
+    [[SGLocationService sharedLocationService] removeDelegate:self];
+    
+    [recordLayers release];
+    [layerAnnotations release];
+    [layerVersions release];
+    [clusterTrees release];
+    [recordQuadtrees release];
+    [timeIndexes release];
+    [playbackRanges release];
+    
+    [self drainAnnotationViewPools];
+    [annotationViewPools release];
+    
+    historyLoader.delegate = nil;
+    [historyLoader cancel];
+    [historyLoader release];
+    
+    dispatch_release(pipelineQueue);
+    [pendingChanges release];
+    [priorityKey release];
+    
+    [tileCache release];
+    [visibleTiles release];
+    
+    [tileResponseIds release];
+    [pendingTiles release];
+    [tileResponses release];
+    
+    [super dealloc];
+}
+
+@end
+
+static SGEnvelope SGEnvelopeForRegion(MKCoordinateRegion region)
+{
+    // A region across the antimeridian becomes an envelope whose west is
+    // greater than its east.
+    CLLocationCoordinate2D center = region.center;
+    return SGEnvelopeExpandByDegrees(SGEnvelopeMake(center.latitude, center.longitude, center.latitude, center.longitude),
+                                     region.span.latitudeDelta / 2.0, region.span.longitudeDelta / 2.0);
+}
+
+static NSDictionary* SGTilesForRegion(MKCoordinateRegion region, NSUInteger maxTileCount)
+{
+    // The tiles are the finest uniform grid that fits, so the same tiles are
+    // found again while the map pans at one zoom level.
+    SGEnvelope envelope = SGEnvelopeForRegion(region);
+    int precision = MIN(SGGeohashPrecisionForEnvelope(envelope, maxTileCount), kSGRecordMapView_MaxGeohashPrecision);
+    NSUInteger count = SGGeohashCellsForEnvelope(envelope, precision, NULL, 0);
+    SGGeohashCell* cells = malloc(sizeof(SGGeohashCell) * MAX(count, 1));
+    SGGeohashCellsForEnvelope(envelope, precision, cells, count);
+    
+    NSMutableDictionary* tiles = [NSMutableDictionary dictionaryWithCapacity:count];
+    for(NSUInteger i = 0; i < count; i++) {
+        SGGeohash geohash = SGGeohashCodeToGeohash(cells[i].code, precision);
+        [tiles setObject:[NSValue valueWithBytes:&geohash objCType:@encode(SGGeohash)]
+                  forKey:SGGeohashCodeToString(cells[i].code, precision)];
+    }
+    
+    free(cells);
+    return tiles;
+}
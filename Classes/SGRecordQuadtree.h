@@ -0,0 +1,99 @@
+//
+//  SGRecordQuadtree.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import <Foundation/Foundation.h>
+#import <MapKit/MapKit.h>
+
+typedef struct {
+
+    MKMapRect rect;
+    NSInteger children[4];
+    NSUInteger representativeStart;
+    NSUInteger representativeCount;
+
+} SGQuadtreeNode;
+
+/*!
+* @class SGRecordQuadtree
+* @abstract Picks a representative subset of records for every zoom level.
+* @discussion The records are ranked once by their priority, highest first,
+* with ties broken by the order they were given in. Every node of the tree
+* keeps the @link representativeCount representativeCount @/link best ranked
+* records below it. A node's representatives are always taken from the
+* representatives of its children, so a record that is shown at one level is
+* still shown when zooming in. Asking for the records in a map rect visits
+* only the nodes that are visible at that level.
+*/
+@interface SGRecordQuadtree : NSObject {
+
+    NSUInteger representativeCount;
+    
+    @private
+    NSArray* recordAnnotations;
+    SGQuadtreeNode* nodes;
+    NSUInteger nodeCount;
+    NSUInteger* representatives;
+    NSUInteger representativesLength;
+}
+
+/*!
+* @property
+* @abstract The amount of records each node keeps.
+*/
+@property (nonatomic, readonly) NSUInteger representativeCount;
+
+/*!
+* @method initWithRecordAnnotations:priorityKey:representativeCount:
+* @abstract Builds the tree.
+* @param recordAnnotations The records.
+* @param priorityKey The property whose numeric value is the priority of a
+* record. If nil, more recently created records have a higher priority.
+* @param representativeCount The amount of records each node keeps.
+*/
+- (id) initWithRecordAnnotations:(NSArray*)recordAnnotations priorityKey:(NSString*)priorityKey representativeCount:(NSUInteger)representativeCount;
+
+/*!
+* @method recordAnnotationsInMapRect:cellSize:maxCount:
+* @abstract Returns the representatives of the visible nodes.
+* @discussion The level is the finest one whose nodes are at least cellSize
+* map points wide. If that shows more than maxCount records, coarser levels
+* are tried.
+* @param mapRect The visible map rect.
+* @param cellSize The smallest node width in map points.
+* @param maxCount The most records to return.
+*/
+- (NSArray*) recordAnnotationsInMapRect:(MKMapRect)mapRect cellSize:(double)cellSize maxCount:(NSUInteger)maxCount;
+
+@end
@@ -0,0 +1,274 @@
+//
+//  SGRecordQuadtree.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import "SGRecordQuadtree.h"
+
+#define kSGRecordQuadtree_MaxDepth          20
+
+typedef struct {
+
+    MKMapPoint point;
+    NSUInteger rank;
+
+} SGQuadtreePoint;
+
+typedef struct {
+
+    double priority;
+    NSUInteger index;
+
+} SGQuadtreePriority;
+
+static int SGComparePriorities(const void* one, const void* two);
+static int SGCompareRanks(const void* one, const void* two);
+
+@interface SGRecordQuadtree (Private)
+
+- (NSInteger) buildNodeWithRect:(MKMapRect)rect points:(SGQuadtreePoint*)nodePoints count:(NSUInteger)count depth:(int)depth;
+- (void) appendRanksOfNode:(NSInteger)nodeIndex inMapRect:(MKMapRect)mapRect depth:(int)depth maxDepth:(int)maxDepth
+                  toBuffer:(NSUInteger*)buffer count:(NSUInteger*)count max:(NSUInteger)max;
+
+@end
+
+@implementation SGRecordQuadtree
+@synthesize representativeCount;
+
+- (id) initWithRecordAnnotations:(NSArray*)annotations priorityKey:(NSString*)priorityKey representativeCount:(NSUInteger)count
+{
+    if(self = [super init]) {
+        recordAnnotations = [annotations retain];
+        representativeCount = MAX(count, 1);
+        
+        NSUInteger pointCount = [recordAnnotations count];
+        SGQuadtreePriority* priorities = malloc(sizeof(SGQuadtreePriority) * MAX(pointCount, 1));
+        NSUInteger index = 0;
+        for(id<SGRecordAnnotation> recordAnnotation in recordAnnotations) {
+            double priority = 0.0;
+            if(priorityKey) {
+                if([recordAnnotation respondsToSelector:@selector(properties)])
+                    priority = [[[recordAnnotation properties] objectForKey:priorityKey] doubleValue];
+            } else if([recordAnnotation respondsToSelector:@selector(created)])
+                priority = [recordAnnotation created];
+            
+            priorities[index].priority = priority;
+            priorities[index].index = index;
+            index++;
+        }
+        
+        // The rank is the position in priority order. The records array is
+        // reordered by rank so a rank is also an index into it.
+        qsort(priorities, pointCount, sizeof(SGQuadtreePriority), SGComparePriorities);
+        
+        NSMutableArray* rankedAnnotations = [NSMutableArray arrayWithCapacity:pointCount];
+        SGQuadtreePoint* points = malloc(sizeof(SGQuadtreePoint) * MAX(pointCount, 1));
+        for(NSUInteger rank = 0; rank < pointCount; rank++) {
+            id<MKAnnotation> annotation = [recordAnnotations objectAtIndex:priorities[rank].index];
+            [rankedAnnotations addObject:annotation];
+            points[rank].point = MKMapPointForCoordinate(annotation.coordinate);
+            points[rank].rank = rank;
+        }
+        
+        free(priorities);
+        [recordAnnotations release];
+        recordAnnotations = [rankedAnnotations retain];
+        
+        nodes = NULL;
+        nodeCount = 0;
+        representatives = NULL;
+        representativesLength = 0;
+        if(pointCount)
+            [self buildNodeWithRect:MKMapRectWorld points:points count:pointCount depth:0];
+        
+        free(points);
+    }
+    
+    return self;
+}
+
+- (NSArray*) recordAnnotationsInMapRect:(MKMapRect)mapRect cellSize:(double)cellSize maxCount:(NSUInteger)maxCount
+{
+    if(!nodeCount || !maxCount)
+        return [NSArray array];
+    
+    int maxDepth = kSGRecordQuadtree_MaxDepth;
+    while(maxDepth > 0 && MKMapSizeWorld.width / (double)(1 << maxDepth) < cellSize)
+        maxDepth--;
+    
+    // A rect that crosses the antimeridian is split in two.
+    MKMapRect rects[2];
+    int rectCount = 1;
+    rects[0] = MKMapRectIntersection(mapRect, MKMapRectWorld);
+    if(MKMapRectGetMaxX(mapRect) > MKMapSizeWorld.width)
+        rects[rectCount++] = MKMapRectIntersection(MKMapRectOffset(mapRect, -MKMapSizeWorld.width, 0.0), MKMapRectWorld);
+    
+    NSUInteger* buffer = malloc(sizeof(NSUInteger) * (maxCount + representativeCount));
+    NSUInteger count = 0;
+    for(; maxDepth >= 0; maxDepth--) {
+        count = 0;
+        for(int i = 0; i < rectCount && count <= maxCount; i++)
+            if(!MKMapRectIsEmpty(rects[i]))
+                [self appendRanksOfNode:0 inMapRect:rects[i] depth:0 maxDepth:maxDepth toBuffer:buffer count:&count max:maxCount];
+        
+        if(count <= maxCount)
+            break;
+    }
+    
+    count = MIN(count, maxCount);
+    NSMutableArray* annotations = [NSMutableArray arrayWithCapacity:count];
+    for(NSUInteger i = 0; i < count; i++)
+        [annotations addObject:[recordAnnotations objectAtIndex:buffer[i]]];
+    
+    free(buffer);
+    
+    return annotations;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Utility methods 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (NSInteger) buildNodeWithRect:(MKMapRect)rect points:(SGQuadtreePoint*)nodePoints count:(NSUInteger)count depth:(int)depth
+{
+    NSInteger nodeIndex = nodeCount++;
+    nodes = realloc(nodes, sizeof(SGQuadtreeNode) * nodeCount);
+    nodes[nodeIndex].rect = rect;
+    for(int i = 0; i < 4; i++)
+        nodes[nodeIndex].children[i] = -1;
+    
+    NSUInteger candidateCount = 0;
+    NSUInteger* candidates = NULL;
+    if(count <= representativeCount || depth == kSGRecordQuadtree_MaxDepth) {
+        candidates = malloc(sizeof(NSUInteger) * count);
+        for(NSUInteger i = 0; i < count; i++)
+            candidates[candidateCount++] = nodePoints[i].rank;
+    } else {
+        // Partition the points into the quadrants in place, then take the
+        // candidates from the children's representatives only.
+        double midX = MKMapRectGetMidX(rect);
+        double midY = MKMapRectGetMidY(rect);
+        NSUInteger start = 0;
+        candidates = malloc(sizeof(NSUInteger) * representativeCount * 4);
+        for(int quadrant = 0; quadrant < 4; quadrant++) {
+            NSUInteger end = start;
+            for(NSUInteger i = start; i < count; i++) {
+                MKMapPoint point = nodePoints[i].point;
+                int pointQuadrant = (point.x >= midX ? 1 : 0) | (point.y >= midY ? 2 : 0);
+                if(pointQuadrant == quadrant) {
+                    SGQuadtreePoint swap = nodePoints[end];
+                    nodePoints[end++] = nodePoints[i];
+                    nodePoints[i] = swap;
+                }
+            }
+            
+            if(end > start) {
+                MKMapRect childRect = MKMapRectMake((quadrant & 1) ? midX : rect.origin.x,
+                                                    (quadrant & 2) ? midY : rect.origin.y,
+                                                    rect.size.width / 2.0, rect.size.height / 2.0);
+                NSInteger child = [self buildNodeWithRect:childRect points:&nodePoints[start] count:end - start depth:depth + 1];
+                nodes[nodeIndex].children[quadrant] = child;
+                
+                for(NSUInteger i = 0; i < nodes[child].representativeCount; i++)
+                    candidates[candidateCount++] = representatives[nodes[child].representativeStart + i];
+            }
+            
+            start = end;
+        }
+    }
+    
+    qsort(candidates, candidateCount, sizeof(NSUInteger), SGCompareRanks);
+    NSUInteger keep = MIN(candidateCount, representativeCount);
+    representatives = realloc(representatives, sizeof(NSUInteger) * (representativesLength + keep));
+    memcpy(&representatives[representativesLength], candidates, sizeof(NSUInteger) * keep);
+    nodes[nodeIndex].representativeStart = representativesLength;
+    nodes[nodeIndex].representativeCount = keep;
+    representativesLength += keep;
+    
+    free(candidates);
+    
+    return nodeIndex;
+}
+
+- (void) appendRanksOfNode:(NSInteger)nodeIndex inMapRect:(MKMapRect)mapRect depth:(int)depth maxDepth:(int)maxDepth
+                  toBuffer:(NSUInteger*)buffer count:(NSUInteger*)count max:(NSUInteger)max
+{
+    SGQuadtreeNode* node = &nodes[nodeIndex];
+    if(*count > max || !MKMapRectIntersectsRect(node->rect, mapRect))
+        return;
+    
+    BOOL leaf = YES;
+    if(depth < maxDepth)
+        for(int i = 0; i < 4; i++)
+            if(node->children[i] >= 0) {
+                leaf = NO;
+                [self appendRanksOfNode:node->children[i] inMapRect:mapRect depth:depth + 1 maxDepth:maxDepth
+                               toBuffer:buffer count:count max:max];
+            }
+    
+    if(leaf) {
+        // The buffer has room for one node past the maximum, which is enough
+        // to tell the caller the level does not fit.
+        for(NSUInteger i = 0; i < node->representativeCount && *count <= max; i++)
+            buffer[(*count)++] = representatives[node->representativeStart + i];
+    }
+}
+
+- (void) dealloc
+{
+    free(nodes);
+    free(representatives);
+    [recordAnnotations release];
+    
+    [super dealloc];
+}
+
+@end
+
+static int SGComparePriorities(const void* one, const void* two)
+{
+    const SGQuadtreePriority* priorityOne = one;
+    const SGQuadtreePriority* priorityTwo = two;
+    if(priorityOne->priority != priorityTwo->priority)
+        return priorityOne->priority > priorityTwo->priority ? -1 : 1;
+    
+    return priorityOne->index < priorityTwo->index ? -1 : (priorityOne->index > priorityTwo->index ? 1 : 0);
+}
+
+static int SGCompareRanks(const void* one, const void* two)
+{
+    NSUInteger rankOne = *(const NSUInteger*)one;
+    NSUInteger rankTwo = *(const NSUInteger*)two;
+    return rankOne < rankTwo ? -1 : (rankOne > rankTwo ? 1 : 0);
+}
@@ -0,0 +1,64 @@
+//
+//  SGSimplifiedPolylineView.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+
+#import <Foundation/Foundation.h>
+#import <MapKit/MapKit.h>
+
+#import "SGTimedRecordLine.h"
+
+/*!
+* @class SGSimplifiedPolylineView
+* @abstract Draws an @link //simplegeo/ooc/cl/SGTimedRecordLine SGTimedRecordLine @/link
+* with only as many points as its zoom scale can show.
+* @discussion Every tile is drawn from
+* @link //simplegeo/ooc/instm/SGTimedRecordLine/copyPointsForZoomScale:count: copyPointsForZoomScale:count: @/link,
+* so a long track costs about the same to draw zoomed out as a short one.
+* Segments that can not reach the tile are skipped. Other overlays are
+* drawn by @link //simplegeo/ooc/cl/SGDynamicPolylineView SGDynamicPolylineView @/link.
+*/
+@interface SGSimplifiedPolylineView : SGDynamicPolylineView {
+
+    CGFloat lineWidth;
+}
+
+/*!
+* @property
+* @abstract The width of the line in screen points. The default is 0, which
+* draws the line as wide as a road at the current zoom scale.
+*/
+@property (nonatomic, assign) CGFloat lineWidth;
+
+@end
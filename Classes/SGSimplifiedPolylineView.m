@@ -0,0 +1,103 @@
+//
+//  SGSimplifiedPolylineView.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+
+#import "SGSimplifiedPolylineView.h"
+
+@implementation SGSimplifiedPolylineView
+@synthesize lineWidth;
+
+- (id) initWithOverlay:(id<MKOverlay>)overlay
+{
+    if(self = [super initWithOverlay:overlay]) {
+        lineWidth = 0.0;
+    }
+    
+    return self;
+}
+
+- (void) drawMapRect:(MKMapRect)mapRect zoomScale:(MKZoomScale)zoomScale inContext:(CGContextRef)context
+{
+    if(![self.overlay isKindOfClass:[SGTimedRecordLine class]]) {
+        [super drawMapRect:mapRect zoomScale:zoomScale inContext:context];
+        return;
+    }
+    
+    NSUInteger count = 0;
+    MKMapPoint* points = [(SGTimedRecordLine*)self.overlay copyPointsForZoomScale:zoomScale count:&count];
+    if(count < 2) {
+        free(points);
+        return;
+    }
+    
+    // The context is in map points scaled to the tile, so a width in screen
+    // points is divided by the zoom scale.
+    CGFloat width = lineWidth > 0.0 ? lineWidth / zoomScale : MKRoadWidthAtZoomScale(zoomScale);
+    MKMapRect clipRect = MKMapRectInset(mapRect, -width, -width);
+    
+    CGMutablePathRef path = CGPathCreateMutable();
+    BOOL needsMove = YES;
+    for(NSUInteger i = 1; i < count; i++) {
+        MKMapRect segmentRect = MKMapRectMake(MIN(points[i - 1].x, points[i].x), MIN(points[i - 1].y, points[i].y),
+                                              fabs(points[i].x - points[i - 1].x), fabs(points[i].y - points[i - 1].y));
+        if(!MKMapRectIntersectsRect(segmentRect, clipRect)) {
+            needsMove = YES;
+            continue;
+        }
+        
+        if(needsMove) {
+            CGPoint start = [self pointForMapPoint:points[i - 1]];
+            CGPathMoveToPoint(path, NULL, start.x, start.y);
+            needsMove = NO;
+        }
+        
+        CGPoint end = [self pointForMapPoint:points[i]];
+        CGPathAddLineToPoint(path, NULL, end.x, end.y);
+    }
+    
+    free(points);
+    
+    if(self.strokeColor)
+        CGContextSetStrokeColorWithColor(context, self.strokeColor.CGColor);
+    
+    CGContextSetLineWidth(context, width);
+    CGContextSetLineCap(context, self.lineCap);
+    CGContextSetLineJoin(context, self.lineJoin);
+    CGContextAddPath(context, path);
+    CGContextStrokePath(context);
+    CGPathRelease(path);
+}
+
+@end
@@ -0,0 +1,109 @@
+//
+//  SGSyncLayer.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import <Foundation/Foundation.h>
+
+/*!
+* @class SGSyncLayer
+* @abstract A layer that only uploads the records that changed.
+* @discussion The layer remembers the last version of every record that
+* SimpleGeo acknowledged, either through an update sent by this layer or
+* through a retrieval. @link updateAllRecords updateAllRecords @/link compares
+* each registered record against that version and only sends the ones whose
+* coordinate, type, expiration or properties differ, in batches of
+* @link batchSize batchSize @/link. Records that were removed from the layer
+* without an update are deleted on the next call, as are records whose
+* delete request failed. A record stays dirty until the request that carried
+* it succeeds.
+*/
+@interface SGSyncLayer : SGLayer {
+
+    NSInteger batchSize;
+    BOOL sendsPropertyPatches;
+    
+    @private
+    NSMutableDictionary* acknowledgedSnapshots;
+    NSMutableDictionary* inFlightSnapshots;
+    NSMutableDictionary* markedRecordIds;
+    NSMutableDictionary* removedRecordAnnotations;
+    
+    NSMutableDictionary* updateBatches;
+    NSMutableDictionary* markedBatches;
+    NSMutableDictionary* deleteBatches;
+    NSMutableArray* retrieveResponseIds;
+}
+
+/*!
+* @property
+* @abstract The amount of records sent in each request. The default is 50.
+*/
+@property (nonatomic, assign) NSInteger batchSize;
+
+/*!
+* @property
+* @abstract If YES, records that SimpleGeo already acknowledged are sent one by
+* one with only their changed properties. See
+* @link //simplegeo/ooc/instm/SGLocationService/updateRecordAnnotation:baselineProperties: updateRecordAnnotation:baselineProperties: @/link.
+* The default is NO.
+*/
+@property (nonatomic, assign) BOOL sendsPropertyPatches;
+
+/*!
+* @method dirtyRecordAnnotations
+* @result The registered records that differ from their last acknowledged version.
+*/
+- (NSArray*) dirtyRecordAnnotations;
+
+/*!
+* @method hasChanges
+* @result YES if there are dirty or removed records that have not been sent.
+*/
+- (BOOL) hasChanges;
+
+/*!
+* @method markRecordAnnotationDirty:
+* @abstract Forces a record to be sent with the next @link updateAllRecords updateAllRecords @/link.
+*/
+- (void) markRecordAnnotationDirty:(id<SGRecordAnnotation>)recordAnnotation;
+
+/*!
+* @method updateAllRecords
+* @abstract Sends the dirty records and pending deletes.
+* @result The request identifier of the first request that was sent, or nil if
+* the layer had no changes.
+*/
+- (NSString*) updateAllRecords;
+
+@end
@@ -0,0 +1,541 @@
+//
+//  SGSyncLayer.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import "SGSyncLayer.h"
+#import "SGLocationService+Patch.h"
+
+@interface SGSyncLayer (Private)
+
+- (NSDictionary*) snapshotForRecordAnnotation:(id<SGRecordAnnotation>)recordAnnotation;
+- (void) collectDirtyRecordAnnotations:(NSMutableArray*)recordAnnotations snapshots:(NSMutableArray*)snapshots;
+- (void) forgetRecordAnnotation:(id<SGRecordAnnotation>)recordAnnotation deleted:(BOOL)deleted;
+- (NSString*) trackUpdateOfRecordAnnotations:(NSArray*)recordAnnotations requestId:(NSString*)requestId;
+- (NSString*) trackDeleteOfRecordAnnotations:(NSArray*)recordAnnotations requestId:(NSString*)requestId;
+- (NSString*) patchAcknowledgedRecordAnnotations:(NSMutableArray*)recordAnnotations snapshots:(NSMutableArray*)snapshots;
+- (void) moveMarkOfRecordId:(NSString*)recordId toRequestId:(NSString*)requestId;
+- (NSString*) trackRetrieval:(NSString*)requestId;
+- (void) acknowledgeRetrieval:(NSObject*)responseObject;
+
+@end
+
+@implementation SGSyncLayer
+@synthesize batchSize, sendsPropertyPatches;
+
+- (id) initWithLayerName:(NSString*)name
+{
+    if(self = [super initWithLayerName:name]) {
+        batchSize = 50;
+        sendsPropertyPatches = NO;
+        
+        acknowledgedSnapshots = [[NSMutableDictionary alloc] init];
+        inFlightSnapshots = [[NSMutableDictionary alloc] init];
+        markedRecordIds = [[NSMutableDictionary alloc] init];
+        removedRecordAnnotations = [[NSMutableDictionary alloc] init];
+        
+        updateBatches = [[NSMutableDictionary alloc] init];
+        markedBatches = [[NSMutableDictionary alloc] init];
+        deleteBatches = [[NSMutableDictionary alloc] init];
+        retrieveResponseIds = [[NSMutableArray alloc] init];
+    }
+    
+    return self;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Dirty state 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (NSArray*) dirtyRecordAnnotations
+{
+    NSMutableArray* recordAnnotations = [NSMutableArray array];
+    [self collectDirtyRecordAnnotations:recordAnnotations snapshots:nil];
+    return recordAnnotations;
+}
+
+- (BOOL) hasChanges
+{
+    BOOL removed = NO;
+    @synchronized(self) {
+        removed = [removedRecordAnnotations count] > 0;
+    }
+    
+    return removed || [[self dirtyRecordAnnotations] count] > 0;
+}
+
+- (void) markRecordAnnotationDirty:(id<SGRecordAnnotation>)recordAnnotation
+{
+    @synchronized(self) {
+        [markedRecordIds setObject:[NSNull null] forKey:[recordAnnotation recordId]];
+    }
+}
+
+- (void) collectDirtyRecordAnnotations:(NSMutableArray*)recordAnnotations snapshots:(NSMutableArray*)snapshots
+{
+    NSArray* registeredRecordAnnotations = [self recordAnnotations];
+    @synchronized(self) {
+        for(id<SGRecordAnnotation> recordAnnotation in registeredRecordAnnotations) {
+            NSString* recordId = [recordAnnotation recordId];
+            NSDictionary* snapshot = [self snapshotForRecordAnnotation:recordAnnotation];
+            
+            BOOL dirty = NO;
+            if([markedRecordIds objectForKey:recordId])
+                dirty = YES;
+            else if(![snapshot isEqualToDictionary:[inFlightSnapshots objectForKey:recordId]])
+                dirty = ![snapshot isEqualToDictionary:[acknowledgedSnapshots objectForKey:recordId]];
+            
+            if(dirty) {
+                [recordAnnotations addObject:recordAnnotation];
+                [snapshots addObject:snapshot];
+            }
+        }
+    }
+}
+
+- (NSDictionary*) snapshotForRecordAnnotation:(id<SGRecordAnnotation>)recordAnnotation
+{
+    NSMutableDictionary* snapshot = [NSMutableDictionary dictionaryWithCapacity:5];
+    
+    CLLocationCoordinate2D coordinate = recordAnnotation.coordinate;
+    [snapshot setObject:[NSNumber numberWithDouble:coordinate.latitude] forKey:@"latitude"];
+    [snapshot setObject:[NSNumber numberWithDouble:coordinate.longitude] forKey:@"longitude"];
+    
+    if([recordAnnotation respondsToSelector:@selector(type)] && [recordAnnotation type])
+        [snapshot setObject:[recordAnnotation type] forKey:@"type"];
+    
+    if([recordAnnotation respondsToSelector:@selector(expires)])
+        [snapshot setObject:[NSNumber numberWithDouble:[recordAnnotation expires]] forKey:@"expires"];
+    
+    // Property values are copied so that mutating a value in place still
+    // shows up as a change.
+    if([recordAnnotation respondsToSelector:@selector(properties)] && [recordAnnotation properties]) {
+        NSDictionary* properties = [[NSDictionary alloc] initWithDictionary:[recordAnnotation properties] copyItems:YES];
+        [snapshot setObject:properties forKey:@"properties"];
+        [properties release];
+    }
+    
+    return snapshot;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Register Record with Layer 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (NSString*) addRecordAnnotation:(id<SGRecordAnnotation>)recordAnnotation update:(BOOL)update
+{
+    @synchronized(self) {
+        [removedRecordAnnotations removeObjectForKey:[recordAnnotation recordId]];
+    }
+
+    NSString* requestId = [super addRecordAnnotation:recordAnnotation update:update];
+    if(update)
+        [self trackUpdateOfRecordAnnotations:[NSArray arrayWithObject:recordAnnotation] requestId:requestId];
+    
+    return requestId;
+}
+
+- (NSString*) addRecordAnnotations:(NSArray*)recordAnnotations update:(BOOL)update
+{
+    @synchronized(self) {
+        for(id<SGRecordAnnotation> recordAnnotation in recordAnnotations)
+            [removedRecordAnnotations removeObjectForKey:[recordAnnotation recordId]];
+    }
+    
+    NSString* requestId = [super addRecordAnnotations:recordAnnotations update:update];
+    if(update)
+        [self trackUpdateOfRecordAnnotations:recordAnnotations requestId:requestId];
+    
+    return requestId;
+}
+
+- (NSString*) removeRecordAnnotation:(id<SGRecordAnnotation>)recordAnnotation update:(BOOL)update
+{
+    [self forgetRecordAnnotation:recordAnnotation deleted:update];
+    NSString* requestId = [super removeRecordAnnotation:recordAnnotation update:update];
+    if(update)
+        [self trackDeleteOfRecordAnnotations:[NSArray arrayWithObject:recordAnnotation] requestId:requestId];
+    
+    return requestId;
+}
+
+- (NSString*) removeRecordAnnotations:(NSArray*)recordAnnotations update:(BOOL)update
+{
+    recordAnnotations = [[recordAnnotations copy] autorelease];
+    for(id<SGRecordAnnotation> recordAnnotation in recordAnnotations)
+        [self forgetRecordAnnotation:recordAnnotation deleted:update];
+    
+    NSString* requestId = [super removeRecordAnnotations:recordAnnotations update:update];
+    if(update)
+        [self trackDeleteOfRecordAnnotations:recordAnnotations requestId:requestId];
+    
+    return requestId;
+}
+
+- (NSString*) removeAllRecordAnnotations:(BOOL)update
+{
+    NSArray* recordAnnotations = [[[self recordAnnotations] copy] autorelease];
+    for(id<SGRecordAnnotation> recordAnnotation in recordAnnotations)
+        [self forgetRecordAnnotation:recordAnnotation deleted:update];
+    
+    NSString* requestId = [super removeAllRecordAnnotations:update];
+    if(update)
+        [self trackDeleteOfRecordAnnotations:recordAnnotations requestId:requestId];
+    
+    return requestId;
+}
+
+- (void) forgetRecordAnnotation:(id<SGRecordAnnotation>)recordAnnotation deleted:(BOOL)deleted
+{
+    NSString* recordId = [recordAnnotation recordId];
+    @synchronized(self) {
+        [markedRecordIds removeObjectForKey:recordId];
+        
+        // A record that SimpleGeo knows about but that was only removed
+        // locally is deleted on the next sync. One that is deleted now keeps
+        // its acknowledged version until the delete succeeds.
+        if(!deleted && [acknowledgedSnapshots objectForKey:recordId])
+            [removedRecordAnnotations setObject:recordAnnotation forKey:recordId];
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark SGLocationService methods 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (NSString*) updateAllRecords
+{
+    NSString* firstRequestId = nil;
+    
+    NSArray* removed = nil;
+    @synchronized(self) {
+        removed = [removedRecordAnnotations allValues];
+        [removedRecordAnnotations removeAllObjects];
+    }
+    
+    if([removed count]) {
+        NSString* requestId = [[SGLocationService sharedLocationService] deleteRecordAnnotations:removed];
+        if(requestId) {
+            @synchronized(self) {
+                [deleteBatches setObject:removed forKey:requestId];
+            }
+            
+            firstRequestId = requestId;
+        }
+    }
+    
+    NSMutableArray* recordAnnotations = [NSMutableArray array];
+    NSMutableArray* snapshots = [NSMutableArray array];
+    [self collectDirtyRecordAnnotations:recordAnnotations snapshots:snapshots];
+    
+    if(sendsPropertyPatches) {
+        NSString* requestId = [self patchAcknowledgedRecordAnnotations:recordAnnotations snapshots:snapshots];
+        if(!firstRequestId)
+            firstRequestId = requestId;
+    }
+    
+    NSInteger count = [recordAnnotations count];
+    NSInteger size = batchSize > 0 ? batchSize : count;
+    for(NSInteger start = 0; start < count; start += size) {
+        NSRange range = NSMakeRange(start, MIN(size, count - start));
+        NSArray* batch = [recordAnnotations subarrayWithRange:range];
+        NSArray* batchSnapshots = [snapshots subarrayWithRange:range];
+        
+        NSString* requestId = [super updateRecordAnnotations:batch];
+        if(!requestId)
+            continue;
+        
+        NSMutableDictionary* inFlight = [NSMutableDictionary dictionaryWithCapacity:range.length];
+        @synchronized(self) {
+            for(NSInteger i = 0; i < range.length; i++) {
+                NSString* recordId = [[batch objectAtIndex:i] recordId];
+                [inFlight setObject:[batchSnapshots objectAtIndex:i] forKey:recordId];
+                [inFlightSnapshots setObject:[batchSnapshots objectAtIndex:i] forKey:recordId];
+                [self moveMarkOfRecordId:recordId toRequestId:requestId];
+            }
+            
+            [updateBatches setObject:inFlight forKey:requestId];
+        }
+        
+        if(!firstRequestId)
+            firstRequestId = requestId;
+    }
+    
+    return firstRequestId;
+}
+
+- (NSString*) patchAcknowledgedRecordAnnotations:(NSMutableArray*)recordAnnotations snapshots:(NSMutableArray*)snapshots
+{
+    NSString* firstRequestId = nil;
+    SGLocationService* locationService = [SGLocationService sharedLocationService];
+    for(NSInteger i = (NSInteger)[recordAnnotations count] - 1; i >= 0; i--) {
+        id<SGRecordAnnotation> recordAnnotation = [recordAnnotations objectAtIndex:i];
+        NSString* recordId = [recordAnnotation recordId];
+        NSDictionary* acknowledgedSnapshot = nil;
+        @synchronized(self) {
+            acknowledgedSnapshot = [[[acknowledgedSnapshots objectForKey:recordId] retain] autorelease];
+        }
+        
+        if(!acknowledgedSnapshot)
+            continue;
+        
+        NSDictionary* baselineProperties = [acknowledgedSnapshot objectForKey:@"properties"];
+        NSString* requestId = [locationService updateRecordAnnotation:recordAnnotation
+                                                   baselineProperties:baselineProperties ? baselineProperties : [NSDictionary dictionary]];
+        if(requestId) {
+            NSDictionary* snapshot = [snapshots objectAtIndex:i];
+            @synchronized(self) {
+                [inFlightSnapshots setObject:snapshot forKey:recordId];
+                [self moveMarkOfRecordId:recordId toRequestId:requestId];
+                [updateBatches setObject:[NSDictionary dictionaryWithObject:snapshot forKey:recordId] forKey:requestId];
+            }
+            
+            if(!firstRequestId)
+                firstRequestId = requestId;
+        }
+        
+        [recordAnnotations removeObjectAtIndex:i];
+        [snapshots removeObjectAtIndex:i];
+    }
+    
+    return firstRequestId;
+}
+
+- (NSString*) updateRecordAnnotations:(NSArray*)recordAnnotations
+{
+    return [self trackUpdateOfRecordAnnotations:recordAnnotations requestId:[super updateRecordAnnotations:recordAnnotations]];
+}
+
+- (NSString*) retrieveAllRecords
+{
+    return [self trackRetrieval:[super retrieveAllRecords]];
+}
+
+- (NSString*) retrieveRecordAnnotations:(NSArray*)recordAnnotations
+{
+    return [self trackRetrieval:[super retrieveRecordAnnotations:recordAnnotations]];
+}
+
+- (NSString*) nearby:(SGNearbyQuery*)nearby
+{
+    return [self trackRetrieval:[super nearby:nearby]];
+}
+
+- (NSString*) nextNearby
+{
+    return [self trackRetrieval:[super nextNearby]];
+}
+
+- (NSString*) trackUpdateOfRecordAnnotations:(NSArray*)recordAnnotations requestId:(NSString*)requestId
+{
+    if(requestId) {
+        NSMutableDictionary* inFlight = [NSMutableDictionary dictionaryWithCapacity:[recordAnnotations count]];
+        for(id<SGRecordAnnotation> recordAnnotation in recordAnnotations)
+            [inFlight setObject:[self snapshotForRecordAnnotation:recordAnnotation] forKey:[recordAnnotation recordId]];
+        
+        @synchronized(self) {
+            [updateBatches setObject:inFlight forKey:requestId];
+        }
+    }
+    
+    return requestId;
+}
+
+- (NSString*) trackDeleteOfRecordAnnotations:(NSArray*)recordAnnotations requestId:(NSString*)requestId
+{
+    // A delete that could not be sent is tried again on the next sync, the
+    // same as one that failed.
+    @synchronized(self) {
+        if(requestId)
+            [deleteBatches setObject:recordAnnotations forKey:requestId];
+        else
+            for(id<SGRecordAnnotation> recordAnnotation in recordAnnotations)
+                if([acknowledgedSnapshots objectForKey:[recordAnnotation recordId]])
+                    [removedRecordAnnotations setObject:recordAnnotation forKey:[recordAnnotation recordId]];
+    }
+    
+    return requestId;
+}
+
+- (void) moveMarkOfRecordId:(NSString*)recordId toRequestId:(NSString*)requestId
+{
+    // The mark travels with the request so it can be put back if the
+    // request fails. Must be called while synchronized.
+    if([markedRecordIds objectForKey:recordId]) {
+        NSMutableArray* markedIds = [markedBatches objectForKey:requestId];
+        if(!markedIds) {
+            markedIds = [NSMutableArray array];
+            [markedBatches setObject:markedIds forKey:requestId];
+        }
+        
+        [markedIds addObject:recordId];
+        [markedRecordIds removeObjectForKey:recordId];
+    }
+}
+
+- (NSString*) trackRetrieval:(NSString*)requestId
+{
+    if(requestId)
+        @synchronized(self) {
+            [retrieveResponseIds addObject:requestId];
+        }
+    
+    return requestId;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark SGLocationService delegate methods 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (void) locationService:(SGLocationService*)service succeededForResponseId:(NSString*)requestId responseObject:(NSObject*)responseObject
+{
+    [super locationService:service succeededForResponseId:requestId responseObject:responseObject];
+    
+    BOOL retrieved = NO;
+    @synchronized(self) {
+        NSDictionary* inFlight = [updateBatches objectForKey:requestId];
+        if(inFlight) {
+            for(NSString* recordId in inFlight) {
+                NSDictionary* snapshot = [inFlight objectForKey:recordId];
+                [acknowledgedSnapshots setObject:snapshot forKey:recordId];
+                if([inFlightSnapshots objectForKey:recordId] == snapshot)
+                    [inFlightSnapshots removeObjectForKey:recordId];
+            }
+            
+            [updateBatches removeObjectForKey:requestId];
+            [markedBatches removeObjectForKey:requestId];
+        }
+        
+        NSArray* deleted = [deleteBatches objectForKey:requestId];
+        if(deleted) {
+            for(id<SGRecordAnnotation> recordAnnotation in deleted)
+                [acknowledgedSnapshots removeObjectForKey:[recordAnnotation recordId]];
+            
+            [deleteBatches removeObjectForKey:requestId];
+        }
+        
+        if([retrieveResponseIds containsObject:requestId]) {
+            [retrieveResponseIds removeObject:requestId];
+            retrieved = YES;
+        }
+    }
+    
+    if(retrieved)
+        [self acknowledgeRetrieval:responseObject];
+}
+
+- (void) locationService:(SGLocationService*)service failedForResponseId:(NSString*)requestId error:(NSError*)error
+{
+    [super locationService:service failedForResponseId:requestId error:error];
+    
+    @synchronized(self) {
+        NSDictionary* inFlight = [updateBatches objectForKey:requestId];
+        if(inFlight) {
+            for(NSString* recordId in inFlight)
+                if([inFlightSnapshots objectForKey:recordId] == [inFlight objectForKey:recordId])
+                    [inFlightSnapshots removeObjectForKey:recordId];
+            
+            // Records that were forced dirty stay dirty until they are sent
+            // successfully, even if they look the same as the acknowledged
+            // version.
+            for(NSString* recordId in [markedBatches objectForKey:requestId])
+                [markedRecordIds setObject:[NSNull null] forKey:recordId];
+            
+            [updateBatches removeObjectForKey:requestId];
+            [markedBatches removeObjectForKey:requestId];
+        }
+        
+        NSArray* deleted = [deleteBatches objectForKey:requestId];
+        if(deleted) {
+            for(id<SGRecordAnnotation> recordAnnotation in deleted)
+                if(![removedRecordAnnotations objectForKey:[recordAnnotation recordId]])
+                    [removedRecordAnnotations setObject:recordAnnotation forKey:[recordAnnotation recordId]];
+            
+            [deleteBatches removeObjectForKey:requestId];
+        }
+        
+        [retrieveResponseIds removeObject:requestId];
+    }
+}
+
+- (void) acknowledgeRetrieval:(NSObject*)responseObject
+{
+    NSArray* features = nil;
+    if([responseObject isKindOfClass:[NSArray class]])
+        features = (NSArray*)responseObject;
+    else if([responseObject isKindOfClass:[NSDictionary class]]) {
+        NSDictionary* geoJSONObject = (NSDictionary*)responseObject;
+        features = [geoJSONObject isFeatureCollection] ? [geoJSONObject features] : [NSArray arrayWithObject:geoJSONObject];
+    }
+    
+    if(![features count])
+        return;
+    
+    NSMutableDictionary* registeredRecordAnnotations = [NSMutableDictionary dictionary];
+    for(id<SGRecordAnnotation> recordAnnotation in [self recordAnnotations])
+        [registeredRecordAnnotations setObject:recordAnnotation forKey:[recordAnnotation recordId]];
+
+    // Whatever was just read from SimpleGeo is, by definition, what SimpleGeo has.
+    @synchronized(self) {
+        for(NSDictionary* feature in features) {
+            if(![feature isKindOfClass:[NSDictionary class]])
+                continue;
+            
+            NSString* recordId = [feature recordId];
+            id<SGRecordAnnotation> recordAnnotation = recordId ? [registeredRecordAnnotations objectForKey:recordId] : nil;
+            if(recordAnnotation && ![markedRecordIds objectForKey:recordId])
+                [acknowledgedSnapshots setObject:[self snapshotForRecordAnnotation:recordAnnotation] forKey:recordId];
+        }
+    }
+}
+
+- (void) dealloc
+{
+    [acknowledgedSnapshots release];
+    [inFlightSnapshots release];
+    [markedRecordIds release];
+    [removedRecordAnnotations release];
+    
+    [updateBatches release];
+    [markedBatches release];
+    [deleteBatches release];
+    [retrieveResponseIds release];
+    
+    [super dealloc];
+}
+
+@end
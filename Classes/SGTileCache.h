@@ -0,0 +1,101 @@
+//
+//  SGTileCache.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import <Foundation/Foundation.h>
+
+/*!
+* @class SGTileCache
+* @abstract Holds the records that were loaded for geohash tiles.
+* @discussion Records are stored per tile and per layer, together with the
+* time they were loaded so every tile can go stale on its own. When more than
+* @link capacity capacity @/link tiles are cached, the least recently used
+* ones are dropped. The cache can be used from several threads.
+*/
+@interface SGTileCache : NSObject {
+
+    NSTimeInterval timeToLive;
+    NSUInteger capacity;
+    
+    @private
+    NSMutableDictionary* tiles;
+    NSUInteger accessCount;
+}
+
+/*!
+* @property
+* @abstract The time (expressed in seconds) after which a tile is stale. A
+* value of 0 or less means tiles never go stale. The default is 0.
+*/
+@property (nonatomic, assign) NSTimeInterval timeToLive;
+
+/*!
+* @property
+* @abstract The amount of tiles to keep. The default is 256.
+*/
+@property (nonatomic, assign) NSUInteger capacity;
+
+/*!
+* @method recordAnnotationsForTile:layer:
+* @result The records loaded for the tile, or nil if the tile was never loaded.
+*/
+- (NSArray*) recordAnnotationsForTile:(NSString*)tile layer:(NSString*)layerId;
+
+/*!
+* @method setRecordAnnotations:forTile:layer:
+* @abstract Stores the records of a tile and marks it fresh.
+*/
+- (void) setRecordAnnotations:(NSArray*)recordAnnotations forTile:(NSString*)tile layer:(NSString*)layerId;
+
+/*!
+* @method isTileFresh:layer:
+* @result YES if the tile was loaded and has not gone stale.
+*/
+- (BOOL) isTileFresh:(NSString*)tile layer:(NSString*)layerId;
+
+/*!
+* @method invalidateTile:layer:
+* @abstract Marks a tile stale. Its records are kept until it is reloaded.
+*/
+- (void) invalidateTile:(NSString*)tile layer:(NSString*)layerId;
+
+/*!
+* @method removeLayer:
+* @abstract Drops the records of a layer from every tile.
+*/
+- (void) removeLayer:(NSString*)layerId;
+
+- (void) removeAllTiles;
+
+@end
@@ -0,0 +1,194 @@
+//
+//  SGTileCache.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import "SGTileCache.h"
+
+@interface SGTileCacheEntry : NSObject {
+
+    @public
+    NSMutableDictionary* recordAnnotations;
+    NSMutableDictionary* loadDates;
+    NSUInteger lastAccess;
+}
+
+@end
+
+@implementation SGTileCacheEntry
+
+- (id) init
+{
+    if(self = [super init]) {
+        recordAnnotations = [[NSMutableDictionary alloc] init];
+        loadDates = [[NSMutableDictionary alloc] init];
+    }
+    
+    return self;
+}
+
+- (void) dealloc
+{
+    [recordAnnotations release];
+    [loadDates release];
+    
+    [super dealloc];
+}
+
+@end
+
+@interface SGTileCache (Private)
+
+- (SGTileCacheEntry*) entryForTile:(NSString*)tile;
+- (void) evictTiles;
+
+@end
+
+@implementation SGTileCache
+@synthesize timeToLive, capacity;
+
+- (id) init
+{
+    if(self = [super init]) {
+        tiles = [[NSMutableDictionary alloc] init];
+        timeToLive = 0.0;
+        capacity = 256;
+        accessCount = 0;
+    }
+    
+    return self;
+}
+
+- (NSArray*) recordAnnotationsForTile:(NSString*)tile layer:(NSString*)layerId
+{
+    @synchronized(self) {
+        SGTileCacheEntry* entry = [self entryForTile:tile];
+        return entry ? [[[entry->recordAnnotations objectForKey:layerId] retain] autorelease] : nil;
+    }
+}
+
+- (void) setRecordAnnotations:(NSArray*)recordAnnotations forTile:(NSString*)tile layer:(NSString*)layerId
+{
+    @synchronized(self) {
+        SGTileCacheEntry* entry = [tiles objectForKey:tile];
+        BOOL inserted = !entry;
+        if(inserted) {
+            entry = [[SGTileCacheEntry alloc] init];
+            [tiles setObject:entry forKey:tile];
+            [entry release];
+        }
+        
+        // The entry is filled and marked as the most recent before evicting,
+        // so a new tile is never the one that gets evicted.
+        entry->lastAccess = ++accessCount;
+        [entry->recordAnnotations setObject:recordAnnotations forKey:layerId];
+        [entry->loadDates setObject:[NSDate date] forKey:layerId];
+        
+        if(inserted)
+            [self evictTiles];
+    }
+}
+
+- (BOOL) isTileFresh:(NSString*)tile layer:(NSString*)layerId
+{
+    @synchronized(self) {
+        SGTileCacheEntry* entry = [tiles objectForKey:tile];
+        NSDate* loadDate = entry ? [entry->loadDates objectForKey:layerId] : nil;
+        return loadDate != nil && (timeToLive <= 0.0 || -[loadDate timeIntervalSinceNow] < timeToLive);
+    }
+}
+
+- (void) invalidateTile:(NSString*)tile layer:(NSString*)layerId
+{
+    @synchronized(self) {
+        SGTileCacheEntry* entry = [tiles objectForKey:tile];
+        if(entry)
+            [entry->loadDates removeObjectForKey:layerId];
+    }
+}
+
+- (void) removeLayer:(NSString*)layerId
+{
+    @synchronized(self) {
+        for(SGTileCacheEntry* entry in [tiles allValues]) {
+            [entry->recordAnnotations removeObjectForKey:layerId];
+            [entry->loadDates removeObjectForKey:layerId];
+        }
+    }
+}
+
+- (void) removeAllTiles
+{
+    @synchronized(self) {
+        [tiles removeAllObjects];
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Utility methods 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (SGTileCacheEntry*) entryForTile:(NSString*)tile
+{
+    SGTileCacheEntry* entry = [tiles objectForKey:tile];
+    if(entry)
+        entry->lastAccess = ++accessCount;
+    
+    return entry;
+}
+
+- (void) evictTiles
+{
+    if([tiles count] <= capacity)
+        return;
+    
+    NSArray* sortedTiles = [tiles keysSortedByValueUsingComparator:^(id one, id two) {
+        NSUInteger accessOne = ((SGTileCacheEntry*)one)->lastAccess;
+        NSUInteger accessTwo = ((SGTileCacheEntry*)two)->lastAccess;
+        return accessOne < accessTwo ? NSOrderedAscending : (accessOne > accessTwo ? NSOrderedDescending : NSOrderedSame);
+    }];
+    
+    // Evict down to three quarters of the capacity so the sort is not
+    // repeated for every new tile.
+    NSUInteger evictCount = [tiles count] - (capacity * 3) / 4;
+    [tiles removeObjectsForKeys:[sortedTiles subarrayWithRange:NSMakeRange(0, evictCount)]];
+}
+
+- (void) dealloc
+{
+    [tiles release];
+    [super dealloc];
+}
+
+@end
@@ -0,0 +1,109 @@
+//
+//  SGTimeIndex.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import <Foundation/Foundation.h>
+
+/*!
+* @class SGTimeIndex
+* @abstract Orders records by the time they were created so a time window can
+* be cut out of them quickly.
+* @discussion The records are sorted once and grouped into buckets of
+* @link bucketInterval bucketInterval @/link seconds. The window is always a
+* contiguous range of @link recordAnnotations recordAnnotations @/link, and
+* finding one of its ends only looks at the records of a single bucket.
+* Moving the window only visits the records between its old and new ends.
+*
+* Records that do not respond to created are treated as created at 0. The
+* interval grows when needed so there are never more buckets than records.
+*/
+@interface SGTimeIndex : NSObject {
+
+    @private
+    NSArray* recordAnnotations;
+    NSTimeInterval* times;
+    NSTimeInterval bucketInterval;
+    
+    NSUInteger* bucketStarts;
+    long long firstBucket;
+    NSUInteger bucketCount;
+}
+
+/*!
+* @property
+* @abstract The records, oldest first.
+*/
+@property (nonatomic, readonly) NSArray* recordAnnotations;
+
+/*!
+* @property
+* @abstract The width (expressed in seconds) of a bucket.
+*/
+@property (nonatomic, readonly) NSTimeInterval bucketInterval;
+
+/*!
+* @method initWithRecordAnnotations:bucketInterval:
+* @param recordAnnotations The records to index.
+* @param bucketInterval The preferred width (expressed in seconds) of a bucket.
+*/
+- (id) initWithRecordAnnotations:(NSArray*)recordAnnotations bucketInterval:(NSTimeInterval)bucketInterval;
+
+/*!
+* @method rangeFromTime:toTime:
+* @abstract Finds the records created within a window. Both ends are inclusive.
+* @param startTime The beginning of the window, or 0 for no beginning.
+* @param endTime The end of the window, or 0 for no end.
+* @result The range of @link recordAnnotations recordAnnotations @/link
+* inside the window.
+*/
+- (NSRange) rangeFromTime:(NSTimeInterval)startTime toTime:(NSTimeInterval)endTime;
+
+/*!
+* @method recordAnnotationsFromTime:toTime:
+* @result The records created within the window.
+*/
+- (NSArray*) recordAnnotationsFromTime:(NSTimeInterval)startTime toTime:(NSTimeInterval)endTime;
+
+/*!
+* @method getInsertedRecordAnnotations:removedRecordAnnotations:fromRange:toRange:
+* @abstract Collects the records that enter and leave the window when it moves.
+* @param inserted Receives the records that are only in the new range.
+* @param removed Receives the records that are only in the old range.
+*/
+- (void) getInsertedRecordAnnotations:(NSMutableArray*)inserted
+             removedRecordAnnotations:(NSMutableArray*)removed
+                            fromRange:(NSRange)oldRange
+                              toRange:(NSRange)newRange;
+
+@end
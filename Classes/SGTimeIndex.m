@@ -0,0 +1,196 @@
+//
+//  SGTimeIndex.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import "SGTimeIndex.h"
+
+typedef struct {
+
+    NSTimeInterval time;
+    NSUInteger index;
+
+} SGTimeIndexEntry;
+
+static int SGTimeIndexEntryCompare(const void* first, const void* second);
+static void SGAddRecordAnnotationsInRange(NSArray* recordAnnotations, NSUInteger start, NSUInteger end, NSMutableArray* target);
+
+@interface SGTimeIndex (Private)
+
+- (NSUInteger) indexForTime:(NSTimeInterval)time inclusive:(BOOL)inclusive;
+
+@end
+
+@implementation SGTimeIndex
+@synthesize recordAnnotations, bucketInterval;
+
+- (id) initWithRecordAnnotations:(NSArray*)newRecordAnnotations bucketInterval:(NSTimeInterval)interval
+{
+    if(self = [super init]) {
+        NSUInteger count = [newRecordAnnotations count];
+        SGTimeIndexEntry* entries = malloc(sizeof(SGTimeIndexEntry) * MAX(count, 1));
+        for(NSUInteger i = 0; i < count; i++) {
+            id<SGRecordAnnotation> recordAnnotation = [newRecordAnnotations objectAtIndex:i];
+            entries[i].time = [recordAnnotation respondsToSelector:@selector(created)] ? [recordAnnotation created] : 0.0;
+            entries[i].index = i;
+        }
+        
+        // The index is part of the comparison, so records created at the same
+        // time keep their order.
+        qsort(entries, count, sizeof(SGTimeIndexEntry), SGTimeIndexEntryCompare);
+        
+        NSMutableArray* sortedAnnotations = [[NSMutableArray alloc] initWithCapacity:count];
+        times = malloc(sizeof(NSTimeInterval) * MAX(count, 1));
+        for(NSUInteger i = 0; i < count; i++) {
+            times[i] = entries[i].time;
+            [sortedAnnotations addObject:[newRecordAnnotations objectAtIndex:entries[i].index]];
+        }
+        
+        free(entries);
+        recordAnnotations = sortedAnnotations;
+        
+        bucketInterval = interval > 0.0 ? interval : 60.0;
+        if(count) {
+            NSTimeInterval span = times[count - 1] - times[0];
+            if(span / bucketInterval >= count)
+                bucketInterval = span / count + 1.0;
+            
+            firstBucket = (long long)floor(times[0] / bucketInterval);
+            bucketCount = (NSUInteger)((long long)floor(times[count - 1] / bucketInterval) - firstBucket + 1);
+        } else {
+            firstBucket = 0;
+            bucketCount = 0;
+        }
+        
+        // bucketStarts[b] is the first record of bucket b; the extra entry
+        // closes the last bucket.
+        bucketStarts = malloc(sizeof(NSUInteger) * (bucketCount + 1));
+        NSUInteger record = 0;
+        for(NSUInteger bucket = 0; bucket <= bucketCount; bucket++) {
+            while(record < count && (long long)floor(times[record] / bucketInterval) - firstBucket < (long long)bucket)
+                record++;
+            
+            bucketStarts[bucket] = record;
+        }
+    }
+    
+    return self;
+}
+
+- (NSRange) rangeFromTime:(NSTimeInterval)startTime toTime:(NSTimeInterval)endTime
+{
+    NSUInteger start = startTime > 0.0 ? [self indexForTime:startTime inclusive:NO] : 0;
+    NSUInteger end = endTime > 0.0 ? [self indexForTime:endTime inclusive:YES] : [recordAnnotations count];
+    return NSMakeRange(start, end > start ? end - start : 0);
+}
+
+- (NSArray*) recordAnnotationsFromTime:(NSTimeInterval)startTime toTime:(NSTimeInterval)endTime
+{
+    return [recordAnnotations subarrayWithRange:[self rangeFromTime:startTime toTime:endTime]];
+}
+
+- (void) getInsertedRecordAnnotations:(NSMutableArray*)inserted
+             removedRecordAnnotations:(NSMutableArray*)removed
+                            fromRange:(NSRange)oldRange
+                              toRange:(NSRange)newRange
+{
+    NSUInteger oldEnd = NSMaxRange(oldRange);
+    NSUInteger newEnd = NSMaxRange(newRange);
+    if(!oldRange.length || !newRange.length || oldEnd <= newRange.location || newEnd <= oldRange.location) {
+        SGAddRecordAnnotationsInRange(recordAnnotations, oldRange.location, oldEnd, removed);
+        SGAddRecordAnnotationsInRange(recordAnnotations, newRange.location, newEnd, inserted);
+        return;
+    }
+    
+    // The ranges overlap, so only their ends differ.
+    if(newRange.location < oldRange.location)
+        SGAddRecordAnnotationsInRange(recordAnnotations, newRange.location, oldRange.location, inserted);
+    else
+        SGAddRecordAnnotationsInRange(recordAnnotations, oldRange.location, newRange.location, removed);
+    
+    if(newEnd > oldEnd)
+        SGAddRecordAnnotationsInRange(recordAnnotations, oldEnd, newEnd, inserted);
+    else
+        SGAddRecordAnnotationsInRange(recordAnnotations, newEnd, oldEnd, removed);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Utility methods 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (NSUInteger) indexForTime:(NSTimeInterval)time inclusive:(BOOL)inclusive
+{
+    // The first record after the time, or at it when the time is not
+    // inclusive. Only the bucket of the time has to be scanned.
+    long long bucket = (long long)floor(time / bucketInterval) - firstBucket;
+    if(bucket < 0)
+        return 0;
+    
+    if(bucket >= (long long)bucketCount)
+        return [recordAnnotations count];
+    
+    NSUInteger index = bucketStarts[bucket];
+    NSUInteger end = bucketStarts[bucket + 1];
+    while(index < end && (inclusive ? times[index] <= time : times[index] < time))
+        index++;
+    
+    return index;
+}
+
+- (void) dealloc
+{
+    [recordAnnotations release];
+    free(times);
+    free(bucketStarts);
+    
+    [super dealloc];
+}
+
+@end
+
+static int SGTimeIndexEntryCompare(const void* first, const void* second)
+{
+    const SGTimeIndexEntry* firstEntry = first;
+    const SGTimeIndexEntry* secondEntry = second;
+    if(firstEntry->time != secondEntry->time)
+        return firstEntry->time < secondEntry->time ? -1 : 1;
+    
+    return firstEntry->index < secondEntry->index ? -1 : (firstEntry->index > secondEntry->index);
+}
+
+static void SGAddRecordAnnotationsInRange(NSArray* recordAnnotations, NSUInteger start, NSUInteger end, NSMutableArray* target)
+{
+    if(end > start)
+        [target addObjectsFromArray:[recordAnnotations subarrayWithRange:NSMakeRange(start, end - start)]];
+}
@@ -0,0 +1,177 @@
+//
+//  SGTimedRecordLine.h
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import <Foundation/Foundation.h>
+#import <MapKit/MapKit.h>
+#import <pthread.h>
+
+#import "SGCompactTrack.h"
+
+#define kSGTimedRecordLine_LevelCount           10
+#define kSGTimedRecordLine_LevelTolerance       2.0
+#define kSGTimedRecordLine_ScreenTolerance      0.5
+#define kSGTimedRecordLine_MaxResimplifiedCount 1024
+
+/*!
+* @class SGTimedRecordLine
+* @abstract An @link //simplegeo/ooc/cl/SGRecordLine SGRecordLine @/link that
+* remembers when every point was recorded and only shows the points within a
+* time window.
+* @discussion Points are expected newest first, in the order SimpleGeo returns
+* the history of a record. The points within the window are a contiguous part
+* of the line, so moving the window is a binary search and only the part of
+* the map between the old and new ends has to be redrawn.
+*
+* @link //simplegeo/ooc/instp/SGRecordLine/points points @/link and
+* @link //simplegeo/ooc/instp/SGRecordLine/pointCount pointCount @/link only
+* return the points within the window. The buffer returned by points is
+* freed when points are added or the window moves, so it can only be used
+* between @link //simplegeo/ooc/instm/SGRecordLine/lock lock @/link and
+* @link //simplegeo/ooc/instm/SGRecordLine/unlock unlock @/link.
+*
+* A record whose line is loaded a page at a time by an
+* @link //simplegeo/ooc/cl/SGHistoryLoader SGHistoryLoader @/link has no
+* history of its own, and neither does one whose history was released with
+* @link releasesHistory releasesHistory @/link, so reloading the annotation
+* only replaces the points when the record has a history.
+*
+* The line also keeps @link kSGTimedRecordLine_LevelCount kSGTimedRecordLine_LevelCount @/link
+* simplified versions of itself, as indexes of the points that are kept.
+* The first drops points within
+* @link kSGTimedRecordLine_LevelTolerance kSGTimedRecordLine_LevelTolerance @/link
+* map points of the line and every next one four times as far, two zoom
+* levels apart. Each level is simplified from the one before, so a level
+* is within a third more than its tolerance of the whole line. New points
+* are simplified as they are added, together with the span back to the
+* second to last kept point when it is no longer than
+* @link kSGTimedRecordLine_MaxResimplifiedCount kSGTimedRecordLine_MaxResimplifiedCount @/link
+* points, so a track loaded a page at a time ends up close to one
+* simplified all at once.
+*
+* The points are stored in a @link //simplegeo/ooc/cl/SGCompactTrack SGCompactTrack @/link,
+* which takes a handful of bytes per point and time instead of 24, and only
+* the points that are drawn are decoded.
+*/
+@interface SGTimedRecordLine : SGRecordLine {
+
+    @private
+    SGCompactTrack* track;
+    MKMapRect trackMapRect;
+    BOOL releasesHistory;
+    
+    NSRange windowRange;
+    NSTimeInterval windowStartTime;
+    NSTimeInterval windowEndTime;
+    
+    uint32_t* levelIndexes[kSGTimedRecordLine_LevelCount];
+    NSUInteger levelCounts[kSGTimedRecordLine_LevelCount];
+    NSUInteger levelSpaces[kSGTimedRecordLine_LevelCount];
+    
+    MKMapPoint* windowPoints;
+    
+    pthread_rwlock_t trackLock;
+    pthread_mutex_t windowPointsLock;
+}
+
+/*!
+* @property
+* @abstract The beginning of the window, or 0 for no beginning.
+*/
+@property (readonly) NSTimeInterval windowStartTime;
+
+/*!
+* @property
+* @abstract The end of the window, or 0 for no end.
+*/
+@property (readonly) NSTimeInterval windowEndTime;
+
+/*!
+* @property
+* @abstract Drops the history of the record once
+* @link //simplegeo/ooc/instm/SGRecordLine/reloadAnnotation reloadAnnotation @/link
+* has added its points, so the track is only kept in its compact form. The
+* default is NO.
+*/
+@property (assign) BOOL releasesHistory;
+
+/*!
+* @method addGeometries:
+* @abstract Adds the points of a history page. The time of a point is read
+* from the created value of its geometry.
+* @result The part of the map covered by the new points.
+*/
+- (MKMapRect) addGeometries:(NSArray*)geometries;
+
+/*!
+* @method addCoordinates:times:count:
+* @abstract Adds points and the times they were recorded at.
+* @param times The times of the points. If NULL, every point gets the time of
+* the last point of the line.
+* @result The part of the map covered by the new points.
+*/
+- (MKMapRect) addCoordinates:(CLLocationCoordinate2D*)coords times:(NSTimeInterval*)times count:(int)count;
+
+/*!
+* @method addMapPoints:times:count:
+* @abstract Adds points that are already projected.
+* @param times The times of the points. If NULL, every point gets the time of
+* the last point of the line.
+* @result The part of the map covered by the new points.
+*/
+- (MKMapRect) addMapPoints:(const MKMapPoint*)mapPoints times:(const NSTimeInterval*)times count:(NSUInteger)count;
+
+/*!
+* @method copyPointsForZoomScale:count:
+* @abstract Copies the points within the window from the simplified version
+* that fits a zoom scale.
+* @discussion The level with the largest tolerance that stays within
+* @link kSGTimedRecordLine_ScreenTolerance kSGTimedRecordLine_ScreenTolerance @/link
+* screen points is used. When zoomed in further than the first level
+* allows, every point is copied. The first and last points of the window
+* are always copied.
+* @param zoomScale The zoom scale the line is drawn at.
+* @param count Receives the amount of points.
+* @result A buffer that has to be freed, or NULL if there are no points.
+*/
+- (MKMapPoint*) copyPointsForZoomScale:(MKZoomScale)zoomScale count:(NSUInteger*)count;
+
+/*!
+* @method setWindowStartTime:endTime:
+* @abstract Moves the time window. Both ends are inclusive.
+* @result The part of the map that has to be redrawn.
+*/
+- (MKMapRect) setWindowStartTime:(NSTimeInterval)startTime endTime:(NSTimeInterval)endTime;
+
+@end
@@ -0,0 +1,426 @@
+//
+//  SGTimedRecordLine.m
+//  SGLayerUpdater
+//
+//  Copyright (c) 2009-2010, SimpleGeo
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without 
+//  modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice, 
+//  this list of conditions and the following disclaimer. Redistributions 
+//  in binary form must reproduce the above copyright notice, this list of
+//  conditions and the following disclaimer in the documentation and/or 
+//  other materials provided with the distribution.
+//  
+//  Neither the name of the SimpleGeo nor the names of its contributors may
+//  be used to endorse or promote products derived from this software 
+//  without specific prior written permission.
+//   
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+//  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS 
+//  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+//  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE 
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+//  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Created by Derek Smith.
+//
+
+
+#import "SGTimedRecordLine.h"
+#import "SGPolylineSimplification.h"
+
+static NSUInteger SGFirstIndexNotBefore(const uint32_t* indexes, NSUInteger count, NSUInteger index);
+
+@interface SGTimedRecordLine (Private)
+
+- (void) updateWindowRange;
+- (void) simplifyNewPoints;
+
+@end
+
+@implementation SGTimedRecordLine
+
+- (id) initWithRecordAnnoation:(id<SGHistoricRecordAnnoation>)annotation
+{
+    if(self = [super initWithRecordAnnoation:annotation]) {
+        track = [[SGCompactTrack alloc] init];
+        trackMapRect = MKMapRectNull;
+        releasesHistory = NO;
+        
+        windowRange = NSMakeRange(0, 0);
+        windowStartTime = 0.0;
+        windowEndTime = 0.0;
+        
+        for(int i = 0; i < kSGTimedRecordLine_LevelCount; i++) {
+            levelIndexes[i] = NULL;
+            levelCounts[i] = 0;
+            levelSpaces[i] = 0;
+        }
+        
+        windowPoints = NULL;
+        
+        pthread_rwlock_init(&trackLock, NULL);
+        pthread_mutex_init(&windowPointsLock, NULL);
+    }
+    
+    return self;
+}
+
+- (MKMapRect) addGeometries:(NSArray*)geometries
+{
+    NSUInteger count = 0;
+    CLLocationCoordinate2D* coordinates = malloc(sizeof(CLLocationCoordinate2D) * MAX([geometries count], 1));
+    NSTimeInterval* times = malloc(sizeof(NSTimeInterval) * MAX([geometries count], 1));
+    for(NSDictionary* geometry in geometries) {
+        if(![geometry isKindOfClass:[NSDictionary class]])
+            continue;
+        
+        NSArray* coordinate = [geometry coordinates];
+        if([coordinate isKindOfClass:[NSArray class]] && [coordinate count] >= 2) {
+            NSNumber* created = [geometry objectForKey:@"created"];
+            coordinates[count].latitude = [coordinate latitude];
+            coordinates[count].longitude = [coordinate longitude];
+            times[count] = [created isKindOfClass:[NSNumber class]] ? [created doubleValue] : (count ? times[count - 1] : 0.0);
+            count++;
+        }
+    }
+    
+    MKMapRect mapRect = count ? [self addCoordinates:coordinates times:times count:count] : MKMapRectNull;
+    free(coordinates);
+    free(times);
+    
+    return mapRect;
+}
+
+- (MKMapRect) addCoordinates:(CLLocationCoordinate2D*)coords times:(NSTimeInterval*)times count:(int)count
+{
+    if(count <= 0)
+        return MKMapRectNull;
+    
+    // The points are projected before the lock is taken.
+    MKMapPoint* mapPoints = malloc(sizeof(MKMapPoint) * count);
+    for(int i = 0; i < count; i++)
+        mapPoints[i] = MKMapPointForCoordinate(coords[i]);
+    
+    MKMapRect mapRect = [self addMapPoints:mapPoints times:times count:count];
+    free(mapPoints);
+    
+    return mapRect;
+}
+
+- (MKMapRect) addMapPoints:(const MKMapPoint*)mapPoints times:(const NSTimeInterval*)times count:(NSUInteger)count
+{
+    if(!count)
+        return MKMapRectNull;
+    
+    pthread_rwlock_wrlock(&trackLock);
+    
+    // The new points join the line at its last point.
+    NSUInteger start = [track count] ? [track count] - 1 : 0;
+    [track addMapPoints:mapPoints times:times count:count];
+    MKMapRect mapRect = [track mapRectForRange:NSMakeRange(start, [track count] - start)];
+    trackMapRect = MKMapRectUnion(trackMapRect, mapRect);
+    [self updateWindowRange];
+    [self simplifyNewPoints];
+    
+    pthread_rwlock_unlock(&trackLock);
+    
+    return mapRect;
+}
+
+- (MKMapRect) addCoordinates:(CLLocationCoordinate2D*)coords count:(int)count
+{
+    return [self addCoordinates:coords times:NULL count:count];
+}
+
+- (MKMapRect) addCoordinate:(CLLocationCoordinate2D)coord
+{
+    return [self addCoordinates:&coord times:NULL count:1];
+}
+
+- (void) reloadAnnotation
+{
+    // Lines built by an SGHistoryLoader get their points straight from the
+    // pages, and a released history has nothing to reload from, so a record
+    // without a history of its own keeps them.
+    NSDictionary* history = [recordAnnotation history];
+    if(![history isKindOfClass:[NSDictionary class]])
+        return;
+    
+    pthread_rwlock_wrlock(&trackLock);
+    [track removeAllPoints];
+    trackMapRect = MKMapRectNull;
+    windowRange = NSMakeRange(0, 0);
+    for(int i = 0; i < kSGTimedRecordLine_LevelCount; i++)
+        levelCounts[i] = 0;
+    
+    [self updateWindowRange];
+    pthread_rwlock_unlock(&trackLock);
+    
+    [self addGeometries:[history geometries]];
+    if(releasesHistory && [recordAnnotation respondsToSelector:@selector(setHistory:)])
+        [(id)recordAnnotation setHistory:nil];
+}
+
+- (MKMapPoint*) copyPointsForZoomScale:(MKZoomScale)zoomScale count:(NSUInteger*)count
+{
+    pthread_rwlock_rdlock(&trackLock);
+    
+    NSUInteger start = windowRange.location;
+    NSUInteger end = NSMaxRange(windowRange);
+    
+    int level = -1;
+    double tolerance = kSGTimedRecordLine_ScreenTolerance / zoomScale;
+    for(double levelTolerance = kSGTimedRecordLine_LevelTolerance;
+        level + 1 < kSGTimedRecordLine_LevelCount && levelTolerance <= tolerance; levelTolerance *= 4.0)
+        level++;
+    
+    MKMapPoint* points = NULL;
+    *count = 0;
+    if(windowRange.length && (level < 0 || windowRange.length <= 2)) {
+        points = malloc(sizeof(MKMapPoint) * windowRange.length);
+        [track getMapPoints:points times:NULL range:windowRange];
+        *count = windowRange.length;
+    } else if(windowRange.length) {
+        // The window can start or end between two kept points, so its own
+        // ends are added around the kept points inside it.
+        NSUInteger low = SGFirstIndexNotBefore(levelIndexes[level], levelCounts[level], start + 1);
+        NSUInteger high = SGFirstIndexNotBefore(levelIndexes[level], levelCounts[level], end - 1);
+        uint32_t* indexes = malloc(sizeof(uint32_t) * (high - low + 2));
+        indexes[(*count)++] = (uint32_t)start;
+        for(NSUInteger i = low; i < high; i++)
+            indexes[(*count)++] = levelIndexes[level][i];
+        
+        indexes[(*count)++] = (uint32_t)(end - 1);
+        points = malloc(sizeof(MKMapPoint) * *count);
+        [track getMapPoints:points atIndexes:indexes count:*count];
+        free(indexes);
+    }
+    
+    pthread_rwlock_unlock(&trackLock);
+    
+    return points;
+}
+
+- (MKMapRect) setWindowStartTime:(NSTimeInterval)startTime endTime:(NSTimeInterval)endTime
+{
+    pthread_rwlock_wrlock(&trackLock);
+    
+    NSRange oldRange = windowRange;
+    windowStartTime = startTime;
+    windowEndTime = endTime;
+    [self updateWindowRange];
+    
+    // Only the points between the old and the new ends of the window change,
+    // plus the segments that connect them to the rest of the line.
+    MKMapRect mapRect = MKMapRectNull;
+    if(!NSEqualRanges(oldRange, windowRange)) {
+        NSUInteger oldEnd = NSMaxRange(oldRange);
+        NSUInteger newEnd = NSMaxRange(windowRange);
+        NSUInteger low = MIN(oldRange.location, windowRange.location);
+        NSUInteger high = MAX(oldRange.location, windowRange.location);
+        NSUInteger start = low ? low - 1 : 0;
+        mapRect = [track mapRectForRange:NSMakeRange(start, MIN(high + 1, [track count]) - start)];
+        
+        low = MIN(oldEnd, newEnd);
+        high = MAX(oldEnd, newEnd);
+        start = low ? low - 1 : 0;
+        mapRect = MKMapRectUnion(mapRect, [track mapRectForRange:NSMakeRange(start, MIN(high + 1, [track count]) - start)]);
+    }
+    
+    pthread_rwlock_unlock(&trackLock);
+    
+    return mapRect;
+}
+
+- (NSTimeInterval) windowStartTime
+{
+    return windowStartTime;
+}
+
+- (NSTimeInterval) windowEndTime
+{
+    return windowEndTime;
+}
+
+- (BOOL) releasesHistory
+{
+    return releasesHistory;
+}
+
+- (void) setReleasesHistory:(BOOL)releases
+{
+    releasesHistory = releases;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark SGRecordLine overrides 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (MKMapPoint*) points
+{
+    // The points are only decoded for callers that ask for all of them, and
+    // kept until the line or its window changes. The buffer is freed under
+    // the write lock, so it is only good while the caller holds lock.
+    // Several readers can hold the lock, so they take turns filling it.
+    pthread_rwlock_rdlock(&trackLock);
+    pthread_mutex_lock(&windowPointsLock);
+    if(!windowPoints && windowRange.length) {
+        windowPoints = malloc(sizeof(MKMapPoint) * windowRange.length);
+        [track getMapPoints:windowPoints times:NULL range:windowRange];
+    }
+    
+    MKMapPoint* points = windowPoints;
+    pthread_mutex_unlock(&windowPointsLock);
+    pthread_rwlock_unlock(&trackLock);
+    
+    return points;
+}
+
+- (NSUInteger) pointCount
+{
+    pthread_rwlock_rdlock(&trackLock);
+    NSUInteger pointCount = windowRange.length;
+    pthread_rwlock_unlock(&trackLock);
+    
+    return pointCount;
+}
+
+- (MKMapRect) boundingMapRect
+{
+    return MKMapRectIsNull(trackMapRect) ? MKMapRectWorld : trackMapRect;
+}
+
+- (CLLocationCoordinate2D) coordinate
+{
+    MKMapRect mapRect = [self boundingMapRect];
+    return MKCoordinateForMapPoint(MKMapPointMake(MKMapRectGetMidX(mapRect), MKMapRectGetMidY(mapRect)));
+}
+
+- (BOOL) intersectsMapRect:(MKMapRect)mapRect
+{
+    return MKMapRectIntersectsRect([self boundingMapRect], mapRect);
+}
+
+- (void) lock
+{
+    pthread_rwlock_rdlock(&trackLock);
+}
+
+- (void) unlock
+{
+    pthread_rwlock_unlock(&trackLock);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+#pragma mark Utility methods 
+//////////////////////////////////////////////////////////////////////////////////////////////// 
+
+- (void) updateWindowRange
+{
+    // Times decrease along the line, so the window starts at the first point
+    // that is not newer than its end.
+    NSUInteger start = windowEndTime > 0.0 ? [track firstIndexBeforeTime:windowEndTime inclusive:YES] : 0;
+    NSUInteger end = windowStartTime > 0.0 ? [track firstIndexBeforeTime:windowStartTime inclusive:NO] : [track count];
+    windowRange = NSMakeRange(start, end > start ? end - start : 0);
+    
+    free(windowPoints);
+    windowPoints = NULL;
+}
+
+- (void) simplifyNewPoints
+{
+    // Every level is simplified from the level below, which it is a part of.
+    // The last kept point before the new ones was only kept because the old
+    // points ended there, so the span from the point before it is simplified
+    // again unless that span is long.
+    for(int level = 0; level < kSGTimedRecordLine_LevelCount; level++) {
+        const uint32_t* source = level ? levelIndexes[level - 1] : NULL;
+        NSUInteger sourceCount = level ? levelCounts[level - 1] : [track count];
+        NSUInteger keptCount = levelCounts[level];
+        NSUInteger first = 0;
+        if(keptCount) {
+            uint32_t joint = levelIndexes[level][keptCount - 1];
+            first = level ? SGFirstIndexNotBefore(source, sourceCount, joint) : joint;
+            keptCount--;
+            if(keptCount) {
+                uint32_t previous = levelIndexes[level][keptCount - 1];
+                NSUInteger previousFirst = level ? SGFirstIndexNotBefore(source, sourceCount, previous) : previous;
+                if(first - previousFirst <= kSGTimedRecordLine_MaxResimplifiedCount) {
+                    first = previousFirst;
+                    keptCount--;
+                }
+            }
+        }
+        
+        // The span is decoded and simplified by its position in the span,
+        // then those positions are turned back into indexes of the track.
+        NSUInteger count = sourceCount - first;
+        uint32_t* indexes = malloc(sizeof(uint32_t) * MAX(count, 1));
+        uint32_t* positions = malloc(sizeof(uint32_t) * MAX(count, 1));
+        MKMapPoint* spanPoints = malloc(sizeof(MKMapPoint) * MAX(count, 1));
+        for(NSUInteger i = 0; i < count; i++) {
+            indexes[i] = level ? source[first + i] : (uint32_t)(first + i);
+            positions[i] = (uint32_t)i;
+        }
+        
+        if(level)
+            [track getMapPoints:spanPoints atIndexes:indexes count:count];
+        else
+            [track getMapPoints:spanPoints times:NULL range:NSMakeRange(first, count)];
+        
+        count = SGSimplifyMapPoints(spanPoints, positions, count, kSGTimedRecordLine_LevelTolerance * pow(4.0, level), positions);
+        for(NSUInteger i = 0; i < count; i++)
+            indexes[i] = indexes[positions[i]];
+        
+        if(keptCount + count > levelSpaces[level]) {
+            levelSpaces[level] = MAX(levelSpaces[level] * 2, keptCount + count);
+            levelIndexes[level] = realloc(levelIndexes[level], sizeof(uint32_t) * levelSpaces[level]);
+        }
+        
+        memcpy(levelIndexes[level] + keptCount, indexes, sizeof(uint32_t) * count);
+        levelCounts[level] = keptCount + count;
+        free(indexes);
+        free(positions);
+        free(spanPoints);
+    }
+}
+
+- (void) dealloc
+{
+    [track release];
+    free(windowPoints);
+    for(int i = 0; i < kSGTimedRecordLine_LevelCount; i++)
+        free(levelIndexes[i]);
+    
+    pthread_rwlock_destroy(&trackLock);
+    pthread_mutex_destroy(&windowPointsLock);
+    
+    [super dealloc];
+}
+
+@end
+
+static NSUInteger SGFirstIndexNotBefore(const uint32_t* indexes, NSUInteger count, NSUInteger index)
+{
+    NSUInteger low = 0;
+    NSUInteger high = count;
+    while(low < high) {
+        NSUInteger middle = low + (high - low) / 2;
+        if(indexes[middle] < index)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    
+    return low;
+}